@@ -1,6 +1,250 @@
 #ifndef MCP_BASE_CALLBACK_HEADER
 #define MCP_BASE_CALLBACK_HEADER
 
-#include "callback_instances.hpp"
+#include <stddef.h>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "fixed_size_pool.hpp"
+
+namespace base {
+
+// A Callback is a call to an object's method with some of its leading
+// arguments already bound. The remaining arguments, 'Args', are
+// passed when the callback is issued.
+//
+// makeCallableOnce() and makeCallableMany() bind any number of leading
+// arguments of a method taking any number of them, and return an
+// owning pointer. A once-callback deletes itself after it runs; a
+// many-callback may run repeatedly and must be deleted by its owner.
+// Bound arguments are copied into the callback, even for reference
+// parameters.
+//
+// The binders the factories return come from FixedSizePool, so
+// making and disposing of a callback doesn't touch the heap once the
+// pool is warm. Code that can hold a callback by value should use
+// InlineCallback (below), which never allocates for common bindings.
+//
+// This header needs C++14; wscript builds the tree with -std=gnu++14.
+//
+// Usage:
+//   Callback<void, int>* cb = makeCallableOnce(&Foo::bar, &foo, 1);
+//   (*cb)(2);  // calls foo.bar(1, 2) and deletes cb
+//
+template<typename Res, typename... Args>
+class Callback {
+public:
+  virtual ~Callback() { }
+
+  virtual Res operator()(Args... args) = 0;
+  virtual bool once() const = 0;
+};
+
+namespace callback_internal {
+
+template<typename... Types>
+struct TypeList { };
+
+// Moves the first type of 'Rest' to the end of 'Front'.
+template<typename Front, typename Rest>
+struct Shift;
+
+template<typename... Front, typename Next, typename... Rest>
+struct Shift<TypeList<Front...>, TypeList<Next, Rest...> > {
+  typedef TypeList<Front..., Next> Bound;
+  typedef TypeList<Rest...>        Free;
+};
+
+// Splits 'Params' into its first 'N' types, Bound, and the others,
+// Free.
+template<size_t N, typename Params, typename Front = TypeList<> >
+struct SplitParams
+  : SplitParams<N - 1,
+                typename Shift<Front, Params>::Free,
+                typename Shift<Front, Params>::Bound> { };
+
+template<typename Params, typename Front>
+struct SplitParams<0, Params, Front> {
+  typedef Front  Bound;
+  typedef Params Free;
+};
+
+// Deletes 'cb', if any, on the way out of a call, once the call's
+// result is in place.
+template<typename CallbackType>
+class DeleteOnExit {
+public:
+  explicit DeleteOnExit(CallbackType* cb) : cb_(cb) { }
+  ~DeleteOnExit() { delete cb_; }
+
+private:
+  CallbackType* cb_;
+};
+
+} // namespace callback_internal
+
+// The binder behind makeCallableOnce() and makeCallableMany(): calls
+// 'Target's method with the stored 'Bound' arguments followed by the
+// issued 'Args'.
+template<bool Once, typename Target, typename Res,
+         typename Bound, typename Args>
+class Callable;
+
+template<bool Once, typename Target, typename Res,
+         typename... Bound, typename... Args>
+class Callable<Once, Target, Res,
+               callback_internal::TypeList<Bound...>,
+               callback_internal::TypeList<Args...> >
+  : public Callback<Res, Args...>,
+    public Pooled<Callable<Once, Target, Res,
+                           callback_internal::TypeList<Bound...>,
+                           callback_internal::TypeList<Args...> > > {
+public:
+  typedef Res (Target::*TargetFunc)(Bound..., Args...);
+
+  template<typename... BoundValues>
+  Callable(TargetFunc target_func, Target* obj, BoundValues&&... bound)
+    : target_func_(target_func),
+      obj_(obj),
+      bound_(std::forward<BoundValues>(bound)...) { }
+
+  virtual ~Callable() { }
+
+  virtual Res operator()(Args... args) {
+    callback_internal::DeleteOnExit<Callable> del(Once ? this : NULL);
+    return call(std::index_sequence_for<Bound...>(),
+                std::forward<Args>(args)...);
+  }
+
+  virtual bool once() const {
+    return Once;
+  }
+
+private:
+  TargetFunc target_func_; // not owned here
+  Target*    obj_;         // not owned here
+  std::tuple<typename std::decay<Bound>::type...> bound_;
+
+  template<size_t... I>
+  Res call(std::index_sequence<I...>, Args&&... args) {
+    return ((*obj_).*target_func_)(std::get<I>(bound_)...,
+                                   std::forward<Args>(args)...);
+  }
+};
+
+// The Callable binding 'NumBound' leading arguments of a 'Params'
+// method.
+template<bool Once, typename Target, typename Res, size_t NumBound,
+         typename... Params>
+struct CallableFor {
+  typedef callback_internal::SplitParams<
+    NumBound, callback_internal::TypeList<Params...> > Split;
+  typedef Callable<Once, Target, Res,
+                   typename Split::Bound, typename Split::Free> Type;
+};
+
+template<typename Target, typename Res, typename... Params,
+         typename... BoundValues>
+typename CallableFor<true, Target, Res, sizeof...(BoundValues),
+                     Params...>::Type*
+makeCallableOnce(Res (Target::*f)(Params...),
+                 Target* obj,
+                 BoundValues&&... bound) {
+  typedef typename CallableFor<true, Target, Res, sizeof...(BoundValues),
+                               Params...>::Type Binder;
+  return new Binder(f, obj, std::forward<BoundValues>(bound)...);
+}
+
+template<typename Target, typename Res, typename... Params,
+         typename... BoundValues>
+typename CallableFor<false, Target, Res, sizeof...(BoundValues),
+                     Params...>::Type*
+makeCallableMany(Res (Target::*f)(Params...),
+                 Target* obj,
+                 BoundValues&&... bound) {
+  typedef typename CallableFor<false, Target, Res, sizeof...(BoundValues),
+                               Params...>::Type Binder;
+  return new Binder(f, obj, std::forward<BoundValues>(bound)...);
+}
+
+// An InlineCallback holds a many-callback by value. Its binder lives
+// in a buffer inside the InlineCallback -- big enough for a method,
+// an object pointer and three pointer-sized bound arguments -- so
+// binding, issuing and resetting it never allocate. Bigger bindings
+// fall back to the heap.
+//
+// The callback runs any number of times, until the InlineCallback is
+// bound again, reset or destroyed. get() lends it out to code taking
+// a Callback pointer; that code must not delete it.
+//
+// Usage:
+//   InlineCallback<void, int> cb;
+//   cb.bind(&Foo::bar, &foo, 1);
+//   cb(2);  // calls foo.bar(1, 2)
+//
+template<typename Res, typename... Args>
+class InlineCallback {
+public:
+  // Room for the vtable pointer, a pointer to member function (two
+  // words), the object pointer and three bound arguments.
+  static const size_t kInlineSize = 7 * sizeof(void*);
+
+  InlineCallback() : cb_(NULL), inline_(false) { }
+  ~InlineCallback() { reset(); }
+
+  // Binds the first arguments of 'f' on 'obj' to 'bound', dropping
+  // any previous binding.
+  template<typename Target, typename... Params, typename... BoundValues>
+  void bind(Res (Target::*f)(Params...),
+            Target* obj,
+            BoundValues&&... bound) {
+    typedef typename CallableFor<false, Target, Res, sizeof...(BoundValues),
+                                 Params...>::Type Binder;
+    reset();
+    if (sizeof(Binder) <= kInlineSize &&
+        alignof(Binder) <= alignof(void*)) {
+      cb_ = ::new (buf_) Binder(f, obj, std::forward<BoundValues>(bound)...);
+      inline_ = true;
+    } else {
+      cb_ = new Binder(f, obj, std::forward<BoundValues>(bound)...);
+    }
+  }
+
+  void reset() {
+    if (inline_) {
+      cb_->~Callback<Res, Args...>();
+    } else {
+      delete cb_;
+    }
+    cb_ = NULL;
+    inline_ = false;
+  }
+
+  bool empty() const { return cb_ == NULL; }
+
+  // True if the binding fit in the inline buffer.
+  bool isInline() const { return inline_; }
+
+  Res operator()(Args... args) { return (*cb_)(std::forward<Args>(args)...); }
+
+  // Returns the callback, still owned here.
+  Callback<Res, Args...>* get() { return cb_; }
+
+private:
+  Callback<Res, Args...>* cb_;      // in buf_, or on the heap
+  bool                    inline_;  // cb_ is in buf_
+  union {
+    char  buf_[kInlineSize];
+    void* align_;
+  };
+
+  // Non-copyable, non-assignable.
+  InlineCallback(const InlineCallback&);
+  InlineCallback& operator=(const InlineCallback&);
+};
+
+} // namespace base
 
 #endif  // MCP_BASE_CALLBACK_HEADER
@@ -1,5 +1,5 @@
+#include <functional>
 #include <iostream>
-#include <tr1/functional>
 
 #include "callback.hpp"
 #include "test_util.hpp"
@@ -7,9 +7,10 @@
 
 namespace {
 
-using std::tr1::bind;
-using std::tr1::function;
+using std::bind;
+using std::function;
 using base::Callback;
+using base::InlineCallback;
 using base::makeCallableOnce;
 using base::makeCallableMany;
 using base::Timer;
@@ -18,7 +19,8 @@ using test::Counter;
 void SimpleCall() {
   const int REPEATS = 1000000;
 
-  // comparing base, tr1, makeCallableOnce, makeCallableMany variations
+  // comparing base, std::function, makeCallableOnce, makeCallableMany
+  // variations
   Timer timers[4];
   Counter counters[4];
 
@@ -30,9 +32,9 @@ void SimpleCall() {
   }
   timers[0].end();
 
-  // tr1 variation
-  typedef function<void()> Tr1Callback;
-  Tr1Callback* cb1 = new Tr1Callback(bind(&Counter::inc, &counters[1]));
+  // std::function variation
+  typedef function<void()> StdCallback;
+  StdCallback* cb1 = new StdCallback(bind(&Counter::inc, &counters[1]));
   timers[1].start();
   for (int i=0; i<REPEATS; i++) {
     (*cb1)();
@@ -60,7 +62,87 @@ void SimpleCall() {
   timers[3].end();
   delete cb3;
 
-  std::cout << "SimpleCall (base|tr1|once|many): "
+  std::cout << "SimpleCall (base|std|once|many): "
+            << timers[0].elapsed() << " | "
+            << timers[1].elapsed() << " | "
+            << timers[2].elapsed() << " | "
+            << timers[3].elapsed() << std::endl;
+}
+
+// A once-binder with one bound argument drawing from the heap, as
+// all binders did before they were pooled.
+class HeapCallable : public Callback<void> {
+public:
+  HeapCallable(void (Counter::*f)(int), Counter* obj, int i)
+    : f_(f), obj_(obj), i_(i) { }
+  virtual ~HeapCallable() { }
+
+  virtual void operator()() {
+    ((*obj_).*f_)(i_);
+    delete this;
+  }
+
+  virtual bool once() const { return true; }
+
+private:
+  void (Counter::*f_)(int);
+  Counter* obj_;
+  int i_;
+};
+
+// Issue callbacks out of line, so the compiler can't see through them
+// and elide the allocations being measured.
+typedef function<void()> StdCallback;
+
+__attribute__((noinline)) void issue(Callback<void>* cb) {
+  (*cb)();
+}
+
+__attribute__((noinline)) void issueStd(StdCallback* cb) {
+  (*cb)();
+}
+
+// Times making a callback with one bound argument and issuing it
+// right away, the pattern of a ready descriptor or a timer in the
+// IOManager. Here the binder's allocation is most of the cost. The
+// std::bind result is bigger than std::function's own buffer, so
+// std::function puts it on the heap.
+void MakeAndCall() {
+  const int REPEATS = 1000000;
+
+  // comparing heap binder, std::function, pooled makeCallableOnce, and
+  // InlineCallback
+  Timer timers[4];
+  Counter counters[4];
+
+  timers[0].start();
+  for (int i=0; i<REPEATS; i++) {
+    issue(new HeapCallable(&Counter::incBy, &counters[0], 1));
+  }
+  timers[0].end();
+
+  timers[1].start();
+  for (int i=0; i<REPEATS; i++) {
+    StdCallback cb(bind(&Counter::incBy, &counters[1], 1));
+    issueStd(&cb);
+  }
+  timers[1].end();
+
+  timers[2].start();
+  for (int i=0; i<REPEATS; i++) {
+    issue(makeCallableOnce(&Counter::incBy, &counters[2], 1));
+  }
+  timers[2].end();
+
+  timers[3].start();
+  for (int i=0; i<REPEATS; i++) {
+    InlineCallback<void> cb;
+    cb.bind(&Counter::incBy, &counters[3], 1);
+    issue(cb.get());
+  }
+  timers[3].end();
+
+  std::cout << "MakeAndCall (heap|std|pooled|inline): "
             << timers[0].elapsed() << " | "
             << timers[1].elapsed() << " | "
             << timers[2].elapsed() << " | "
@@ -71,4 +153,5 @@ void SimpleCall() {
 
 int main(int argc, char* argv[]) {
   SimpleCall();
+  MakeAndCall();
 }
@@ -1,3 +1,5 @@
+#include <string>
+
 #include "callback.hpp"
 #include "test_unit.hpp"
 #include "test_util.hpp"
@@ -5,10 +7,20 @@
 namespace {
 
 using base::Callback;
+using base::InlineCallback;
 using base::makeCallableOnce;
 using base::makeCallableMany;
+using std::string;
 using test::Counter;
 
+struct Joiner {
+  string joined;
+
+  void join4(string a, const string& b, int c, char d) {
+    joined = a + b + string(c, d);
+  }
+};
+
 TEST(Once, Simple) {
   Counter c;
   Callback<void>* cb = makeCallableOnce(&Counter::inc, &c);
@@ -56,6 +68,23 @@ TEST(Once, ReturnType) {
   EXPECT_TRUE((*cb3)());
 }
 
+TEST(Once, FourArguments) {
+  // Any number of arguments may be bound; reference parameters bind
+  // a copy.
+  Joiner j;
+  string b = "b";
+  Callback<void, int, char>* cb1 =
+    makeCallableOnce(&Joiner::join4, &j, string("a"), b);
+  b = "x";
+  (*cb1)(2, 'c');
+  EXPECT_EQ(j.joined, "abcc");
+
+  Callback<void>* cb2 =
+    makeCallableOnce(&Joiner::join4, &j, string("d"), b, 1, 'e');
+  (*cb2)();
+  EXPECT_EQ(j.joined, "dxe");
+}
+
 TEST(Many, Simple) {
   Counter c;
   Callback<void>* cb = makeCallableMany(&Counter::inc, &c);
@@ -66,6 +95,56 @@ TEST(Many, Simple) {
   delete cb;
 }
 
+TEST(Many, ReturnType) {
+  Counter c;
+  c.set(7);
+  Callback<bool, int>* cb = makeCallableMany(&Counter::between, &c, 5);
+  EXPECT_FALSE(cb->once());
+  EXPECT_TRUE((*cb)(10));
+  EXPECT_FALSE((*cb)(6));
+  delete cb;
+}
+
+TEST(Inline, Simple) {
+  Counter c;
+  InlineCallback<void> cb;
+  EXPECT_TRUE(cb.empty());
+  cb.bind(&Counter::incBy, &c, 2);
+  EXPECT_TRUE(cb.isInline());
+  cb();
+  cb();
+  EXPECT_EQ(c.count(), 4);
+
+  // Lent out, it behaves as a many-callback.
+  Callback<void>* lent = cb.get();
+  EXPECT_FALSE(lent->once());
+  (*lent)();
+  EXPECT_EQ(c.count(), 6);
+
+  cb.reset();
+  EXPECT_TRUE(cb.empty());
+}
+
+TEST(Inline, Rebinding) {
+  Counter c;
+  c.set(7);
+  InlineCallback<bool, int> cb;
+  cb.bind(&Counter::between, &c, 5);
+  EXPECT_TRUE(cb(10));
+  cb.bind(&Counter::between, &c, 8);
+  EXPECT_FALSE(cb(10));
+}
+
+TEST(Inline, TooBigForTheBuffer) {
+  // Two strings don't fit; the binder goes to the heap.
+  Joiner j;
+  InlineCallback<void, int, char> cb;
+  cb.bind(&Joiner::join4, &j, string("a"), string("b"));
+  EXPECT_FALSE(cb.isInline());
+  cb(1, 'c');
+  EXPECT_EQ(j.joined, "abc");
+}
+
 } // unnamed namespace
 
 int main(int argc, char *argv[]) {
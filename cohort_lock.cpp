@@ -0,0 +1,66 @@
+#include <map>
+#include <sched.h>
+#include <unistd.h>
+
+#include "cohort_lock.hpp"
+#include "cpu_placement.hpp"
+
+namespace base {
+
+using std::map;
+
+CohortLock::CohortLock() : holder_(0) {
+  // Number the sockets densely, in the order of their CPUs.
+  map<int, int> cohort_of_socket;
+  const int num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+  for (int cpu = 0; cpu < num_cpus; cpu++) {
+    const int socket = CpuPlacement::socketOf(cpu);
+    if (cohort_of_socket.find(socket) == cohort_of_socket.end()) {
+      const int next = cohort_of_socket.size();
+      cohort_of_socket[socket] = next;
+    }
+    cohort_of_cpu_.push_back(cohort_of_socket[socket]);
+  }
+
+  num_cohorts_ = cohort_of_socket.empty() ? 1 : cohort_of_socket.size();
+  cohorts_ = new Cohort[num_cohorts_];
+}
+
+CohortLock::~CohortLock() {
+  delete [] cohorts_;
+}
+
+void CohortLock::lock() {
+  const int c = currentCohort();
+  Cohort& cohort = cohorts_[c];
+  cohort.local.lock();
+  if (! cohort.owns_global) {
+    global_.lock();
+  }
+  holder_ = c;
+}
+
+void CohortLock::unlock() {
+  // The holder may have migrated since lock(); release the cohort it
+  // locked.
+  Cohort& cohort = cohorts_[holder_];
+  if (cohort.local.hasWaiters() && cohort.passes < kMaxPasses) {
+    cohort.owns_global = true;
+    cohort.passes++;
+  } else {
+    cohort.owns_global = false;
+    cohort.passes = 0;
+    global_.unlock();
+  }
+  cohort.local.unlock();
+}
+
+int CohortLock::currentCohort() const {
+  const int cpu = sched_getcpu();
+  if (cpu < 0 || cpu >= static_cast<int>(cohort_of_cpu_.size())) {
+    return 0;
+  }
+  return cohort_of_cpu_[cpu];
+}
+
+}  // namespace base
@@ -0,0 +1,70 @@
+#ifndef MCP_BASE_COHORT_LOCK_HEADER
+#define MCP_BASE_COHORT_LOCK_HEADER
+
+#include <vector>
+
+#include "spinlock_ticket.hpp"
+
+namespace base {
+
+using std::vector;
+
+// A lock cohort (Dice, Marathe and Shavit) for multi-socket machines.
+// Each socket has a local ticket lock, and there is one global ticket
+// lock. A thread takes its socket's local lock, then the global one.
+// On release, if another thread of the same socket is waiting for the
+// local lock, the global lock is handed to it along with the local
+// one, so the lock and the data it protects stay within the socket's
+// caches. After kMaxPasses hand-offs in a row, the global lock is
+// released anyway so that other sockets aren't starved.
+//
+// On a single socket this is a ticket lock with an extra, always
+// uncontended, acquisition.
+//
+// Usage:
+//   CohortLock l;
+//   l.lock();
+//   ... critical section ...
+//   l.unlock();
+//
+class CohortLock {
+public:
+  static const int kMaxPasses = 64;
+
+  CohortLock();
+  ~CohortLock();
+
+  void lock();
+  void unlock();
+
+  // accessors
+
+  int numCohorts() const { return num_cohorts_; }
+
+private:
+  struct Cohort {
+    Cohort() : owns_global(false), passes(0) { }
+
+    SpinlockTicket local;
+    bool           owns_global;  // handed over by the previous holder
+    int            passes;       // hand-offs in a row
+    char           pad[64];      // keep cohorts on lines of their own
+  };
+
+  SpinlockTicket global_;
+  Cohort*        cohorts_;        // one per socket
+  int            num_cohorts_;
+  vector<int>    cohort_of_cpu_;
+  int            holder_;         // the holder's cohort
+
+  // Returns the cohort of the CPU the caller runs on.
+  int currentCohort() const;
+
+  // Non-copyable, non-assignable
+  CohortLock(CohortLock&);
+  CohortLock& operator=(CohortLock&);
+};
+
+}  // namespace base
+
+#endif  // MCP_BASE_COHORT_LOCK_HEADER
@@ -0,0 +1,225 @@
+#include <pthread.h>
+#include <sched.h>     // sched_getaffinity, sched_getcpu
+#include <stdlib.h>    // atoi
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "cpu_placement.hpp"
+#include "logging.hpp"
+
+namespace base {
+
+using std::ifstream;
+using std::istringstream;
+using std::ostringstream;
+using std::sort;
+
+namespace {
+
+struct Cpu {
+  int cpu;
+  int socket;
+  int core;
+  int thread;   // hyperthread index within the core
+};
+
+bool bySocketCoreThread(const Cpu& a, const Cpu& b) {
+  if (a.socket != b.socket) return a.socket < b.socket;
+  if (a.core != b.core) return a.core < b.core;
+  return a.thread < b.thread;
+}
+
+bool bySocketThreadCore(const Cpu& a, const Cpu& b) {
+  if (a.socket != b.socket) return a.socket < b.socket;
+  if (a.thread != b.thread) return a.thread < b.thread;
+  return a.core < b.core;
+}
+
+// Returns the integer in the sysfs topology file 'name' of 'cpu', or
+// 0 if there is none.
+int readTopology(int cpu, const char* name) {
+  ostringstream path;
+  path << "/sys/devices/system/cpu/cpu" << cpu << "/topology/" << name;
+  ifstream in(path.str().c_str());
+  int res = 0;
+  if (! (in >> res)) {
+    return 0;
+  }
+  return res;
+}
+
+// Returns the CPUs the process may run on, with their topology.
+vector<Cpu> allowedCpus() {
+  vector<Cpu> res;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return res;
+  }
+  for (int i = 0; i < CPU_SETSIZE; i++) {
+    if (CPU_ISSET(i, &set)) {
+      Cpu cpu = { i, readTopology(i, "physical_package_id"),
+                  readTopology(i, "core_id"), 0 };
+      res.push_back(cpu);
+    }
+  }
+
+  // Number the hyperthreads of each core. CPUs are in increasing
+  // order, so the first one seen on a core is thread 0.
+  for (size_t i = 0; i < res.size(); i++) {
+    for (size_t j = 0; j < i; j++) {
+      if (res[j].socket == res[i].socket && res[j].core == res[i].core) {
+        res[i].thread++;
+      }
+    }
+  }
+  return res;
+}
+
+} // unnamed namespace
+
+CpuPlacement::CpuPlacement() : policy_(NONE) {
+}
+
+CpuPlacement::CpuPlacement(Policy policy) : policy_(policy) {
+}
+
+CpuPlacement CpuPlacement::compact() {
+  CpuPlacement res(COMPACT);
+  vector<Cpu> cpus = allowedCpus();
+  sort(cpus.begin(), cpus.end(), bySocketCoreThread);
+  for (size_t i = 0; i < cpus.size(); i++) {
+    res.cpus_.push_back(cpus[i].cpu);
+  }
+  return res;
+}
+
+CpuPlacement CpuPlacement::scatter() {
+  CpuPlacement res(SCATTER);
+  vector<Cpu> cpus = allowedCpus();
+
+  // Within a socket, one thread of every core before the siblings.
+  // Then deal the sockets' CPUs round-robin.
+  sort(cpus.begin(), cpus.end(), bySocketThreadCore);
+  vector<vector<int> > sockets;
+  int last_socket = -1;
+  for (size_t i = 0; i < cpus.size(); i++) {
+    if (sockets.empty() || cpus[i].socket != last_socket) {
+      sockets.push_back(vector<int>());
+      last_socket = cpus[i].socket;
+    }
+    sockets.back().push_back(cpus[i].cpu);
+  }
+  for (size_t round = 0; res.cpus_.size() < cpus.size(); round++) {
+    for (size_t s = 0; s < sockets.size(); s++) {
+      if (round < sockets[s].size()) {
+        res.cpus_.push_back(sockets[s][round]);
+      }
+    }
+  }
+  return res;
+}
+
+CpuPlacement CpuPlacement::list(const vector<int>& cpus) {
+  CpuPlacement res(LIST);
+  res.cpus_ = cpus;
+  return res;
+}
+
+CpuPlacement CpuPlacement::sameSocket(int socket) {
+  CpuPlacement res(SAME_SOCKET);
+  vector<Cpu> cpus = allowedCpus();
+  if (socket < 0) {
+    int current = sched_getcpu();
+    socket = (current < 0) ? 0 : readTopology(current, "physical_package_id");
+  }
+
+  sort(cpus.begin(), cpus.end(), bySocketCoreThread);
+  for (size_t i = 0; i < cpus.size(); i++) {
+    if (cpus[i].socket == socket) {
+      res.cpus_.push_back(cpus[i].cpu);
+    }
+  }
+  if (res.cpus_.empty()) {
+    LOG(LogMessage::WARNING) << "no usable cpu in socket " << socket;
+  }
+  return res;
+}
+
+bool CpuPlacement::parse(const string& spec, CpuPlacement* placement) {
+  if (spec == "none") {
+    *placement = CpuPlacement();
+  } else if (spec == "compact") {
+    *placement = compact();
+  } else if (spec == "scatter") {
+    *placement = scatter();
+  } else if (spec == "socket") {
+    *placement = sameSocket();
+  } else if (spec.compare(0, 7, "socket:") == 0) {
+    istringstream is(spec.substr(7));
+    int socket;
+    if (! (is >> socket) || ! is.eof() || socket < 0) {
+      return false;
+    }
+    *placement = sameSocket(socket);
+  } else {
+    vector<int> cpus;
+    istringstream is(spec);
+    int cpu;
+    char comma;
+    while (is >> cpu) {
+      if (cpu < 0) {
+        return false;
+      }
+      cpus.push_back(cpu);
+      if (! (is >> comma)) {
+        break;
+      }
+      if (comma != ',') {
+        return false;
+      }
+    }
+    if (cpus.empty() || ! is.eof()) {
+      return false;
+    }
+    *placement = list(cpus);
+  }
+  return true;
+}
+
+int CpuPlacement::cpuFor(int i) const {
+  if (cpus_.empty()) {
+    return -1;
+  }
+  return cpus_[i % cpus_.size()];
+}
+
+CpuPlacement CpuPlacement::rotated() const {
+  CpuPlacement res(*this);
+  if (! res.cpus_.empty()) {
+    std::rotate(res.cpus_.begin(), res.cpus_.begin() + 1, res.cpus_.end());
+  }
+  return res;
+}
+
+bool CpuPlacement::pinCurrentThread(int cpu) {
+  if (cpu < 0) {
+    return true;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    LOG(LogMessage::WARNING) << "can't pin thread to cpu " << cpu;
+    return false;
+  }
+  return true;
+}
+
+int CpuPlacement::socketOf(int cpu) {
+  return readTopology(cpu, "physical_package_id");
+}
+
+} // namespace base
@@ -0,0 +1,92 @@
+#ifndef MCP_BASE_CPU_PLACEMENT_HEADER
+#define MCP_BASE_CPU_PLACEMENT_HEADER
+
+#include <string>
+#include <vector>
+
+namespace base {
+
+using std::string;
+using std::vector;
+
+// A CpuPlacement decides which CPU each thread of a group (a thread
+// pool, or an IOManager's poll thread plus its workers) is pinned to.
+// Policies:
+//
+//   + NONE: don't pin; the scheduler places threads (the default)
+//   + COMPACT: fill one socket, core by core, before the next one.
+//     Threads share caches
+//   + SCATTER: spread threads across sockets, then across cores of a
+//     socket. Threads get as much cache and memory bandwidth as
+//     possible
+//   + LIST: an explicit list of CPUs
+//   + SAME_SOCKET: only the CPUs of one socket, so the poll thread
+//     and the workers handing data to each other share the last
+//     level cache
+//
+// Only CPUs the process is allowed to run on are used. Thread 'i' of
+// the group goes to the i-th CPU of the policy's order, wrapping
+// around if there are more threads than CPUs.
+//
+// Usage:
+//   CpuPlacement placement = CpuPlacement::compact();
+//   ThreadPoolFast pool(8, placement);
+//
+//   CpuPlacement from_flag;
+//   if (! CpuPlacement::parse("0,2,4,6", &from_flag)) ...
+//
+class CpuPlacement {
+public:
+  enum Policy { NONE, COMPACT, SCATTER, LIST, SAME_SOCKET };
+
+  // Builds a NONE placement.
+  CpuPlacement();
+  ~CpuPlacement() { }
+
+  static CpuPlacement compact();
+  static CpuPlacement scatter();
+  static CpuPlacement list(const vector<int>& cpus);
+
+  // Uses the CPUs of 'socket', or of the socket the caller is running
+  // on if 'socket' is -1.
+  static CpuPlacement sameSocket(int socket = -1);
+
+  // Parses "none", "compact", "scatter", "socket", "socket:<n>" or a
+  // comma separated CPU list ("0,2,4") into 'placement'. Returns false
+  // if 'spec' is not valid.
+  static bool parse(const string& spec, CpuPlacement* placement);
+
+  // Returns the CPU thread 'i' should be pinned to, or -1 for no
+  // pinning.
+  int cpuFor(int i) const;
+
+  // Returns the same placement with the first CPU moved to the end of
+  // the order. IOManager pins its poll thread to cpuFor(0) and hands
+  // rotated() to the workers, so they start on the next CPU.
+  CpuPlacement rotated() const;
+
+  // Pins the calling thread to 'cpu'. Returns false if that failed. A
+  // 'cpu' of -1 is a no-op.
+  static bool pinCurrentThread(int cpu);
+
+  // Returns the socket (physical package) of 'cpu', or 0 if the
+  // topology is unknown.
+  static int socketOf(int cpu);
+
+  // accessors
+
+  Policy policy() const { return policy_; }
+  const vector<int>& cpus() const { return cpus_; }
+
+private:
+  Policy      policy_;
+  vector<int> cpus_;     // CPU order; empty for NONE
+
+  explicit CpuPlacement(Policy policy);
+
+  // Copyable and assignable.
+};
+
+} // namespace base
+
+#endif // MCP_BASE_CPU_PLACEMENT_HEADER
@@ -0,0 +1,103 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "callback.hpp"
+#include "cpu_placement.hpp"
+#include "test_unit.hpp"
+#include "thread.hpp"
+
+namespace {
+
+using base::CpuPlacement;
+using base::makeCallableOnce;
+using base::makeThread;
+using std::vector;
+
+struct WhereAmI {
+  WhereAmI() : cpu(-2) { }
+  void run() { cpu = sched_getcpu(); }
+
+  int cpu;
+};
+
+vector<int> sorted(vector<int> cpus) {
+  std::sort(cpus.begin(), cpus.end());
+  return cpus;
+}
+
+//
+// Test Cases
+//
+
+TEST(Policies, None) {
+  CpuPlacement placement;
+  EXPECT_EQ(placement.policy(), CpuPlacement::NONE);
+  EXPECT_EQ(placement.cpuFor(0), -1);
+  EXPECT_EQ(placement.rotated().cpuFor(3), -1);
+}
+
+TEST(Policies, CompactAndScatterUseAllCpus) {
+  CpuPlacement compact = CpuPlacement::compact();
+  CpuPlacement scatter = CpuPlacement::scatter();
+  EXPECT_GT(compact.cpus().size(), 0u);
+  EXPECT_TRUE(sorted(compact.cpus()) == sorted(scatter.cpus()));
+
+  // One socket's CPUs are a subset of all of them.
+  CpuPlacement socket = CpuPlacement::sameSocket();
+  EXPECT_GT(socket.cpus().size(), 0u);
+  EXPECT_GT(compact.cpus().size() + 1, socket.cpus().size());
+}
+
+TEST(Policies, ListWrapsAndRotates) {
+  vector<int> cpus;
+  cpus.push_back(3);
+  cpus.push_back(1);
+  cpus.push_back(2);
+  CpuPlacement placement = CpuPlacement::list(cpus);
+  EXPECT_EQ(placement.cpuFor(0), 3);
+  EXPECT_EQ(placement.cpuFor(2), 2);
+  EXPECT_EQ(placement.cpuFor(4), 1);
+
+  CpuPlacement rotated = placement.rotated();
+  EXPECT_EQ(rotated.cpuFor(0), 1);
+  EXPECT_EQ(rotated.cpuFor(2), 3);
+}
+
+TEST(Parse, Specs) {
+  CpuPlacement placement;
+  EXPECT_TRUE(CpuPlacement::parse("compact", &placement));
+  EXPECT_EQ(placement.policy(), CpuPlacement::COMPACT);
+  EXPECT_TRUE(CpuPlacement::parse("scatter", &placement));
+  EXPECT_EQ(placement.policy(), CpuPlacement::SCATTER);
+  EXPECT_TRUE(CpuPlacement::parse("socket:0", &placement));
+  EXPECT_EQ(placement.policy(), CpuPlacement::SAME_SOCKET);
+  EXPECT_TRUE(CpuPlacement::parse("none", &placement));
+  EXPECT_EQ(placement.policy(), CpuPlacement::NONE);
+
+  EXPECT_TRUE(CpuPlacement::parse("0,2,4", &placement));
+  EXPECT_EQ(placement.policy(), CpuPlacement::LIST);
+  EXPECT_EQ(placement.cpus().size(), 3u);
+  EXPECT_EQ(placement.cpuFor(1), 2);
+
+  EXPECT_FALSE(CpuPlacement::parse("", &placement));
+  EXPECT_FALSE(CpuPlacement::parse("fast", &placement));
+  EXPECT_FALSE(CpuPlacement::parse("0;2", &placement));
+  EXPECT_FALSE(CpuPlacement::parse("socket:x", &placement));
+}
+
+TEST(Pinning, MakeThread) {
+  int cpu = CpuPlacement::compact().cpuFor(0);
+  WhereAmI where;
+  pthread_t tid = makeThread(makeCallableOnce(&WhereAmI::run, &where), cpu);
+  pthread_join(tid, NULL);
+  EXPECT_EQ(where.cpu, cpu);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  return RUN_TESTS(argc, argv);
+}
@@ -0,0 +1,112 @@
+#ifndef MCP_BASE_EVENT_COUNT_HEADER
+#define MCP_BASE_EVENT_COUNT_HEADER
+
+#include "lock.hpp"
+
+namespace base {
+
+// An EventCount lets threads wait for a condition on a lock-free data
+// structure (e.g. "the queue is not empty") without the signaling side
+// paying for a lock or a syscall when nobody is waiting.
+//
+// A waiter announces itself with prepareWait(), re-checks the
+// condition, and then either gives up with cancelWait() or blocks with
+// wait(). A notifier changes the data structure and then calls
+// notify(). The full barriers in prepareWait() and notify() guarantee
+// that either the waiter sees the change or the notifier sees the
+// waiter, so no wake-up is lost.
+//
+// Thread safety:
+//   + all methods are thread-safe
+//
+// Usage:
+//   // consumer
+//   while (! queue.tryPop(&item)) {
+//     EventCount::Key key = ec.prepareWait();
+//     if (queue.tryPop(&item)) {
+//       ec.cancelWait();
+//       break;
+//     }
+//     ec.wait(key);
+//   }
+//
+//   // producer
+//   queue.tryPush(item);
+//   ec.notify();
+//
+class EventCount {
+public:
+  typedef long Key;
+
+  EventCount() : epoch_(0), waiters_(0) { }
+  ~EventCount() { }
+
+  // Registers the caller as a waiter and returns the key to wait()
+  // on. The caller must follow up with either cancelWait() or wait().
+  Key prepareWait() {
+    __sync_fetch_and_add(&waiters_, 1);
+    return epoch_;
+  }
+
+  // Unregisters a waiter that found its condition after all.
+  void cancelWait() {
+    __sync_fetch_and_sub(&waiters_, 1);
+  }
+
+  // Blocks until a notify() happened after the prepareWait() that
+  // returned 'key'.
+  void wait(Key key) {
+    m_.lock();
+    while (epoch_ == key) {
+      cv_.wait(&m_);
+    }
+    m_.unlock();
+    __sync_fetch_and_sub(&waiters_, 1);
+  }
+
+  // Wakes up one waiter, if there is any.
+  void notify() {
+    __sync_synchronize();
+    if (waiters_ > 0) {
+      ScopedLock l(&m_);
+      epoch_++;
+      cv_.signal();
+    }
+  }
+
+  // Wakes up as many as 'n' waiters.
+  void notifyMany(int n) {
+    __sync_synchronize();
+    if (waiters_ > 0) {
+      ScopedLock l(&m_);
+      epoch_++;
+      for (int i = 0; i < n && i < waiters_; i++) {
+        cv_.signal();
+      }
+    }
+  }
+
+  // Wakes up all waiters.
+  void notifyAll() {
+    __sync_synchronize();
+    if (waiters_ > 0) {
+      ScopedLock l(&m_);
+      epoch_++;
+      cv_.signalAll();
+    }
+  }
+
+private:
+  Mutex         m_;        // protects changes to 'epoch_'
+  ConditionVar  cv_;
+  volatile Key  epoch_;    // bumped by every effective notify
+  volatile int  waiters_;  // prepared or waiting threads
+
+  // Non-copyable, non-assignable
+  EventCount(const EventCount&);
+  EventCount& operator=(const EventCount&);
+};
+
+} // namespace base
+
+#endif // MCP_BASE_EVENT_COUNT_HEADER
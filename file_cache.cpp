@@ -7,12 +7,40 @@
 
 #include "file_cache.hpp"
 #include "logging.hpp"
+#include "memory_pressure.hpp"
+#include "parallel.hpp"
 
 namespace base {
 
 using std::make_pair;
 using std::list;
 
+namespace {
+
+// The pieces of FileCache::warmUp's reduction: 'load' pins and unpins
+// a range of files, counting the ones that made it in.
+struct WarmUp {
+  FileCache*            cache;
+  const vector<string>* files;
+
+  int load(size_t begin, size_t end) {
+    int loaded = 0;
+    for (size_t i = begin; i < end; i++) {
+      Buffer* buf;
+      FileCache::CacheHandle h = cache->pin((*files)[i], &buf, NULL);
+      if (h != 0) {
+        cache->unpin(h);
+        loaded++;
+      }
+    }
+    return loaded;
+  }
+
+  int add(int a, int b) { return a + b; }
+};
+
+} // unnamed namespace
+
 FileCache::FileCache(int max_size)
   : max_size_(max_size),
     head_(&tail_),
@@ -20,12 +48,18 @@ FileCache::FileCache(int max_size)
     bytes_used_(0),
     pin_total_(0),
     hit_total_(0),
-    failed_total_(0) {
+    failed_total_(0),
+    pressure_cb_(makeCallableMany(&FileCache::relievePressure, this)) {
+  MemoryPressure::instance()->registerPressureHandler(pressure_cb_);
 }
 
 // REQUIRES: No ongoing pin. This code assumes no one is using the
 // cache anymore
 FileCache::~FileCache() {
+  // After this, no pressure relief is running against this cache.
+  MemoryPressure::instance()->unregisterPressureHandler(pressure_cb_);
+  delete pressure_cb_;
+
   rw_m_.wLock();
 
   Node* curr = tail_.next;
@@ -185,8 +219,15 @@ FileCache::CacheHandle FileCache::load(const string& file_name,
   return h;
 }
 
-bool FileCache::evict(size_t bytes_to_evict) {
+void FileCache::relievePressure(size_t bytes) {
+  this->evict(bytes);
+}
+
+bool FileCache::evict(size_t bytes) {
   list<Node*> to_delete;
+  // Signed, so that evicting a node bigger than what is left to evict
+  // ends the loop.
+  long bytes_to_evict = bytes;
 
   rw_m_.wLock();
 
@@ -251,6 +292,19 @@ void FileCache::unpin(CacheHandle h) {
   rw_m_.unlock();
 }
 
+int FileCache::warmUp(ThreadPool* pool, const vector<string>& files) {
+  WarmUp warm_up = { this, &files };
+  Callback<int, size_t, size_t>* load =
+    makeCallableMany(&WarmUp::load, &warm_up);
+  Callback<int, int, int>* add = makeCallableMany(&WarmUp::add, &warm_up);
+
+  int loaded = parallelReduce(pool, 0, files.size(), 1, 0, load, add);
+
+  delete load;
+  delete add;
+  return loaded;
+}
+
 void FileCache::nodeInsert(Node* node) {
   head_->next = node;
   head_ = node;
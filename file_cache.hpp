@@ -3,15 +3,20 @@
 
 #include <string>
 #include <tr1/unordered_map>
+#include <vector>
 
 #include "buffer.hpp"
+#include "callback.hpp"
 #include "lock.hpp"
+#include "scalable_rw_mutex.hpp"
+#include "thread_pool.hpp"
 
 namespace base {
 
 using std::string;
 using std::tr1::hash;
 using std::tr1::unordered_map;
+using std::vector;
 
 // The FileCache maintains a map from file names to their contents,
 // stored as 'Buffer's. The sum of all Buffer's stored in the map
@@ -34,6 +39,10 @@ using std::tr1::unordered_map;
 // If not enough unpinned space is found to fit a new request, then
 // the pin request may fail.
 //
+// The cache registers itself with the MemoryPressure singleton. When
+// the process nears its memory budget, relievePressure() evicts
+// unpinned buffers just as a cache miss would.
+//
 // Thread safety:
 //   + pin() and unpin() can be done from different threads
 //   + ~FileCache is NOT thread-safe. The caller has to be sure there
@@ -63,6 +72,14 @@ public:
   CacheHandle pin(const string& file_name, Buffer** buf, int* error);
   void unpin(CacheHandle h);
 
+  // Loads 'files' into the cache, spreading the reads over 'pool' and
+  // the calling thread. Returns how many files ended up cached.
+  int warmUp(ThreadPool* pool, const vector<string>& files);
+
+  // Evicts at least 'bytes' worth of unpinned buffers, if there are
+  // that many. Called on memory pressure.
+  void relievePressure(size_t bytes);
+
   // accessors
 
   int maxSize() const   { return max_size_; }
@@ -105,7 +122,7 @@ private:
   Node*         head_;
   Node          tail_;           // use a sentinel
 
-  RWMutex       rw_m_;           // protects cache_map_
+  ScalableRWMutex rw_m_;         // protects cache_map_
   CacheMap      cache_map_;      // look-up for file names
 
   // atomic counters
@@ -114,9 +131,11 @@ private:
   int           hit_total_;      // # of requests to pin that were hits
   int           failed_total_;   // # of requests to pint that failed
 
+  Callback<void, size_t>* pressure_cb_;  // owned here
+
   // Helper for the actual file load
   CacheHandle load(const string& file_name, Buffer** buf, int* error);
-  bool evict(size_t bytes_to_evict);
+  bool evict(size_t bytes);
 
   // list manipulation
   void nodeInsert(Node* node);
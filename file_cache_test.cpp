@@ -14,7 +14,9 @@
 #include "callback.hpp"
 #include "file_cache.hpp"
 #include "logging.hpp"
+#include "memory_pressure.hpp"
 #include "thread.hpp"
+#include "thread_pool_fast.hpp"
 #include "test_unit.hpp"
 
 namespace {
@@ -28,6 +30,8 @@ using base::FileCache;
 using base::LogMessage;
 using base::makeCallableOnce;
 using base::makeThread;
+using base::MemoryPressure;
+using base::ThreadPoolFast;
 
 // ************************************************************
 // Support for creating test files
@@ -268,6 +272,43 @@ TEST(Failure, NegativeReferenceCount) {
   EXPECT_FATAL(cache.unpin(h));
 }
 
+TEST(Pressure, EvictsUnpinned) {
+  FileCache cache(6000);
+
+  Buffer* buf;
+  FileCache::CacheHandle h_a = cache.pin("a.html", &buf, NULL);
+  FileCache::CacheHandle h_b = cache.pin("b.html", &buf, NULL);
+  cache.unpin(h_a);
+  EXPECT_EQ(cache.bytesUsed(), 5000);
+
+  // Only 'a' is unpinned; asking for more than that leaves 'b' alone.
+  MemoryPressure::instance()->relieve(4000);
+  EXPECT_EQ(cache.bytesUsed(), 2500);
+
+  h_b = cache.pin("b.html", &buf, NULL);
+  EXPECT_EQ(cache.hits(), 1);
+  cache.unpin(h_b);
+}
+
+TEST(WarmUp, LoadsWhatFits) {
+  FileCache cache(6000);
+  ThreadPoolFast pool(2);
+
+  vector<string> files;
+  files.push_back("a.html");
+  files.push_back("b.html");
+  files.push_back("not_there.html");
+  EXPECT_EQ(cache.warmUp(&pool, files), 2);
+  EXPECT_EQ(cache.bytesUsed(), 5000);
+
+  Buffer* buf;
+  FileCache::CacheHandle h = cache.pin("b.html", &buf, NULL);
+  EXPECT_EQ(cache.hits(), 1);
+  cache.unpin(h);
+
+  pool.stop();
+}
+
 TEST(Concurrency, Mayhem) {
   const int num_files = 5;
   FileCache cache(2048 * (num_files - 2)); // not enough space for all files
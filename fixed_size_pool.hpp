@@ -0,0 +1,208 @@
+#ifndef MCP_BASE_FIXED_SIZE_POOL_HEADER
+#define MCP_BASE_FIXED_SIZE_POOL_HEADER
+
+#include <new>
+#include <pthread.h>
+#include <stddef.h>
+
+namespace base {
+
+// A FixedSizePool recycles blocks of 'Size' bytes. Each thread keeps
+// its own free list, so allocating and releasing are a few plain
+// loads and stores -- no lock, no atomic. A block released by a
+// thread other than the one that allocated it simply joins the
+// releasing thread's list.
+//
+// A thread caches up to kMaxCached blocks. Beyond that, it moves a
+// batch of kBatch blocks to a depot shared by all threads, and a
+// thread that runs out takes a batch back from there before turning
+// to the heap. So blocks allocated by one thread and released by
+// another -- a poll thread handing callbacks to workers, say -- keep
+// being recycled, at the cost of one lock per batch. The depot holds
+// up to kMaxDepot blocks; released blocks go back to the heap past
+// that. A thread's cached blocks are freed when it exits.
+//
+// Usage:
+//   void* p = FixedSizePool<sizeof(Node)>::allocate();
+//   ...
+//   FixedSizePool<sizeof(Node)>::release(p);
+//
+// Or, to pool all instances of a class, derive it from Pooled<> (see
+// below).
+//
+template<size_t Size>
+class FixedSizePool {
+public:
+  static const size_t kMaxCached = 256;
+  static const size_t kBatch = kMaxCached / 2;
+  static const size_t kMaxDepot = 64 * kBatch;
+
+  static void* allocate() {
+    FreeList* list = freeList();
+    if (list->head == NULL) {
+      refill(list);
+    }
+    if (list->head != NULL) {
+      Block* block = list->head;
+      list->head = block->next;
+      list->count--;
+      return block;
+    }
+    return ::operator new(kBlockSize);
+  }
+
+  static void release(void* p) {
+    FreeList* list = freeList();
+    if (list->count >= kMaxCached && ! spill(list)) {
+      ::operator delete(p);
+      return;
+    }
+    Block* block = static_cast<Block*>(p);
+    block->next = list->head;
+    list->head = block;
+    list->count++;
+  }
+
+private:
+  struct Block {
+    Block* next;
+  };
+
+  struct FreeList {
+    Block* head;
+    size_t count;
+  };
+
+  static const size_t kBlockSize =
+    Size < sizeof(Block) ? sizeof(Block) : Size;
+
+  // Moves up to kBatch blocks from the depot to 'list'.
+  static void refill(FreeList* list) {
+    pthread_mutex_lock(&depot_lock_);
+    Block* head = depot_.head;
+    size_t n = 0;
+    Block* tail = NULL;
+    for (Block* b = head; b != NULL && n < kBatch; b = b->next) {
+      tail = b;
+      n++;
+    }
+    if (tail != NULL) {
+      depot_.head = tail->next;
+      depot_.count -= n;
+      tail->next = NULL;
+    }
+    pthread_mutex_unlock(&depot_lock_);
+
+    list->head = head;
+    list->count = n;
+  }
+
+  // Moves kBatch blocks from 'list' to the depot. Returns false, and
+  // moves nothing, if the depot is full.
+  static bool spill(FreeList* list) {
+    Block* head = list->head;
+    Block* tail = head;
+    for (size_t n = 1; n < kBatch; n++) {
+      tail = tail->next;
+    }
+
+    pthread_mutex_lock(&depot_lock_);
+    if (depot_.count + kBatch > kMaxDepot) {
+      pthread_mutex_unlock(&depot_lock_);
+      return false;
+    }
+    list->head = tail->next;
+    tail->next = depot_.head;
+    depot_.head = head;
+    depot_.count += kBatch;
+    pthread_mutex_unlock(&depot_lock_);
+
+    list->count -= kBatch;
+    return true;
+  }
+
+  // Returns the caller thread's free list, arranging for it to be
+  // emptied when the thread exits.
+  static FreeList* freeList() {
+    static __thread FreeList list = { NULL, 0 };
+    static __thread bool registered = false;
+    if (! registered) {
+      registered = true;
+      pthread_once(&once_, createKey);
+      pthread_setspecific(key_, &list);
+    }
+    return &list;
+  }
+
+  static void createKey() {
+    pthread_key_create(&key_, destroyList);
+  }
+
+  static void destroyList(void* arg) {
+    FreeList* list = static_cast<FreeList*>(arg);
+    while (list->head != NULL) {
+      Block* block = list->head;
+      list->head = block->next;
+      ::operator delete(block);
+    }
+    list->count = 0;
+  }
+
+  static pthread_once_t  once_;
+  static pthread_key_t   key_;
+  static pthread_mutex_t depot_lock_;
+  static FreeList        depot_;
+
+  // Not instantiable.
+  FixedSizePool();
+};
+
+template<size_t Size>
+pthread_once_t FixedSizePool<Size>::once_ = PTHREAD_ONCE_INIT;
+
+template<size_t Size>
+pthread_key_t FixedSizePool<Size>::key_;
+
+template<size_t Size>
+pthread_mutex_t FixedSizePool<Size>::depot_lock_ = PTHREAD_MUTEX_INITIALIZER;
+
+template<size_t Size>
+typename FixedSizePool<Size>::FreeList FixedSizePool<Size>::depot_ =
+  { NULL, 0 };
+
+// Deriving a class T from Pooled<T> makes 'new T' and 'delete' draw
+// on FixedSizePool<sizeof(T)>. Classes derived from T are bigger and
+// go to the heap as usual.
+//
+// Usage:
+//   class Node : public Pooled<Node> { ... };
+//
+template<typename T>
+class Pooled {
+public:
+  static void* operator new(size_t size) {
+    if (size != sizeof(T)) {
+      return ::operator new(size);
+    }
+    return FixedSizePool<sizeof(T)>::allocate();
+  }
+
+  static void operator delete(void* p, size_t size) {
+    if (p == NULL) {
+      return;
+    }
+    if (size != sizeof(T)) {
+      ::operator delete(p);
+      return;
+    }
+    FixedSizePool<sizeof(T)>::release(p);
+  }
+
+protected:
+  Pooled() { }
+  ~Pooled() { }
+};
+
+} // namespace base
+
+#endif // MCP_BASE_FIXED_SIZE_POOL_HEADER
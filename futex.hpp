@@ -0,0 +1,64 @@
+#ifndef MCP_BASE_FUTEX_HEADER
+#define MCP_BASE_FUTEX_HEADER
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace base {
+
+// Thin wrappers around the futex(2) system call, for threads of one
+// process (FUTEX_PRIVATE). A futex is just an int; the kernel only
+// gets involved when a thread actually has to sleep or be woken up.
+//
+// Usage:
+//   // waiter: sleep while 'state' is SLEEPING
+//   while (state == SLEEPING) {
+//     futexWait(&state, SLEEPING);
+//   }
+//
+//   // waker
+//   if (__sync_lock_test_and_set(&state, READY) == SLEEPING) {
+//     futexWake(&state, 1);
+//   }
+
+// Sleeps if '*addr' still holds 'val', for at most 'timeout' (relative;
+// NULL for no limit). May return spuriously, so the caller must
+// re-check its condition. Returns -1 with errno set to ETIMEDOUT if the
+// timeout expired.
+inline int futexWait(volatile int* addr,
+                     int val,
+                     const struct timespec* timeout = NULL) {
+  return syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, timeout, NULL, 0);
+}
+
+// Like futexWait(), but until the absolute CLOCK_REALTIME time
+// 'abstime' -- the clock and the format pthread_cond_timedwait() use.
+inline int futexWaitUntil(volatile int* addr,
+                          int val,
+                          const struct timespec* abstime) {
+  return syscall(SYS_futex, addr,
+                 FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME,
+                 val, abstime, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+// Wakes up as many as 'n' threads sleeping on 'addr'. Returns the
+// number of threads woken up.
+inline int futexWake(volatile int* addr, int n) {
+  return syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+// Tells the CPU we're in a spin-wait loop. On x86 this is 'pause',
+// which saves power and frees resources for the sibling hyperthread.
+inline void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__ ("pause" ::: "memory");
+#else
+  __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+} // namespace base
+
+#endif // MCP_BASE_FUTEX_HEADER
@@ -0,0 +1,256 @@
+#ifndef MCP_BASE_FUTEX_MUTEX_HEADER
+#define MCP_BASE_FUTEX_MUTEX_HEADER
+
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "futex.hpp"
+
+namespace base {
+
+// A mutex and a condition variable built directly on futexes. When
+// lock.hpp is compiled with MCP_FUTEX_MUTEX defined (waf configure
+// --futex-mutex), they are base::Mutex and base::ConditionVar.
+//
+// FutexMutex is Drepper's three-state mutex ("Futexes Are Tricky"):
+// 0 is free, 1 is locked, 2 is locked with possible sleepers. Locking
+// and unlocking an uncontended mutex is one atomic instruction each,
+// and unlock() only enters the kernel if someone may be asleep.
+//
+// A contended lock() first spins, as long as the owner is running:
+// critical sections are usually much shorter than a sleep and a
+// wake-up. Owners publish their FutexThreadState, and a spinner gives
+// up as soon as the owner is itself asleep on a futex. The spin limit
+// adapts to how long past acquisitions took to succeed, as glibc's
+// adaptive mutex does, and there's no spinning on a single CPU.
+//
+// FutexConditionVar is a sequence number waiters sleep on; signal()
+// bumps it and wakes a waiter. Signaling with no waiter is a couple
+// of loads.
+//
+// Thread safety:
+//   + as pthread_mutex_t and pthread_cond_t. Like them, neither is
+//     recursive, and a condition variable is used with one mutex
+//
+
+// Whether a thread is asleep on a FutexMutex. Internal to this file.
+struct FutexThreadState {
+  volatile int      sleeping;
+  FutexThreadState* next_free;
+};
+
+// Hands out a FutexThreadState per thread. States of exited threads
+// are recycled, never freed, so a spinner reading a stale owner reads
+// valid memory. Internal to this file.
+template<int Dummy>
+class FutexThreadStates {
+public:
+  static FutexThreadState* current() {
+    static __thread FutexThreadState* state = NULL;
+    if (state == NULL) {
+      state = acquire();
+      pthread_once(&once_, createKey);
+      pthread_setspecific(key_, state);
+    }
+    return state;
+  }
+
+  static int numCpus() {
+    if (num_cpus_ == 0) {
+      num_cpus_ = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    return num_cpus_;
+  }
+
+private:
+  static pthread_once_t    once_;
+  static pthread_key_t     key_;
+  static pthread_mutex_t   free_lock_;
+  static FutexThreadState* free_;
+  static int               num_cpus_;
+
+  static FutexThreadState* acquire() {
+    pthread_mutex_lock(&free_lock_);
+    FutexThreadState* state = free_;
+    if (state != NULL) {
+      free_ = state->next_free;
+    }
+    pthread_mutex_unlock(&free_lock_);
+
+    if (state == NULL) {
+      state = new FutexThreadState;
+    }
+    state->sleeping = 0;
+    state->next_free = NULL;
+    return state;
+  }
+
+  static void release(void* arg) {
+    FutexThreadState* state = static_cast<FutexThreadState*>(arg);
+    pthread_mutex_lock(&free_lock_);
+    state->next_free = free_;
+    free_ = state;
+    pthread_mutex_unlock(&free_lock_);
+  }
+
+  static void createKey() {
+    pthread_key_create(&key_, release);
+  }
+};
+
+template<int Dummy>
+pthread_once_t FutexThreadStates<Dummy>::once_ = PTHREAD_ONCE_INIT;
+
+template<int Dummy>
+pthread_key_t FutexThreadStates<Dummy>::key_;
+
+template<int Dummy>
+pthread_mutex_t FutexThreadStates<Dummy>::free_lock_ =
+  PTHREAD_MUTEX_INITIALIZER;
+
+template<int Dummy>
+FutexThreadState* FutexThreadStates<Dummy>::free_ = NULL;
+
+template<int Dummy>
+int FutexThreadStates<Dummy>::num_cpus_ = 0;
+
+class FutexMutex {
+public:
+  // Bounds on the adaptive spin.
+  static const int kMinSpins = 10;
+  static const int kMaxSpins = 1000;
+
+  FutexMutex() : state_(0), owner_(NULL), spins_(kMinSpins) { }
+  ~FutexMutex() { }
+
+  void lock() {
+    if (__sync_val_compare_and_swap(&state_, 0, 1) != 0) {
+      lockSlow();
+    }
+    owner_ = FutexThreadStates<0>::current();
+  }
+
+  void unlock() {
+    owner_ = NULL;
+    if (__sync_fetch_and_sub(&state_, 1) != 1) {
+      // There may be sleepers.
+      __sync_lock_release(&state_);
+      futexWake(&state_, 1);
+    }
+  }
+
+private:
+  volatile int               state_;   // 0 free, 1 locked, 2 contended
+  FutexThreadState* volatile owner_;   // NULL while being handed over
+  int                        spins_;   // running average; racy on purpose
+
+  void lockSlow() {
+    if (spin()) {
+      return;
+    }
+
+    FutexThreadState* me = FutexThreadStates<0>::current();
+    int c = __sync_lock_test_and_set(&state_, 2);
+    while (c != 0) {
+      me->sleeping = 1;
+      futexWait(&state_, 2);
+      me->sleeping = 0;
+      c = __sync_lock_test_and_set(&state_, 2);
+    }
+  }
+
+  // Spins while the owner runs, up to the adaptive limit. Returns
+  // true if the mutex was acquired.
+  bool spin() {
+    if (FutexThreadStates<0>::numCpus() == 1) {
+      return false;
+    }
+
+    int limit = 2 * spins_ + kMinSpins;
+    if (limit > kMaxSpins) {
+      limit = kMaxSpins;
+    }
+
+    bool acquired = false;
+    int n = 0;
+    for (; n < limit; n++) {
+      if (state_ == 0 && __sync_val_compare_and_swap(&state_, 0, 1) == 0) {
+        acquired = true;
+        break;
+      }
+      FutexThreadState* owner = owner_;
+      if (owner != NULL && owner->sleeping) {
+        break;
+      }
+      cpuRelax();
+    }
+
+    spins_ += (n - spins_) / 8;
+    return acquired;
+  }
+
+  // Non-copyable, non-assignable
+  FutexMutex(FutexMutex&);
+  FutexMutex& operator=(FutexMutex&);
+};
+
+class FutexConditionVar {
+public:
+  FutexConditionVar() : seq_(0), waiters_(0) { }
+  ~FutexConditionVar() { }
+
+  void wait(FutexMutex* mutex) {
+    timedWait(mutex, NULL);
+  }
+
+  // Waits until signaled or until the absolute CLOCK_REALTIME time
+  // 'abstime', as pthread_cond_timedwait(). A NULL 'abstime' waits
+  // for a signal only.
+  void timedWait(FutexMutex* mutex, const struct timespec* abstime) {
+    // 'waiters_' is changed under 'mutex', so a signaler that changed
+    // the condition under it too sees this waiter.
+    waiters_++;
+    const int seq = seq_;
+    mutex->unlock();
+
+    if (abstime == NULL) {
+      futexWait(&seq_, seq);
+    } else {
+      futexWaitUntil(&seq_, seq, abstime);
+    }
+
+    mutex->lock();
+    waiters_--;
+  }
+
+  void signal() {
+    if (waiters_ == 0) {
+      return;
+    }
+    __sync_fetch_and_add(&seq_, 1);
+    futexWake(&seq_, 1);
+  }
+
+  void signalAll() {
+    if (waiters_ == 0) {
+      return;
+    }
+    __sync_fetch_and_add(&seq_, 1);
+    futexWake(&seq_, INT_MAX);
+  }
+
+private:
+  volatile int seq_;
+  volatile int waiters_;
+
+  // Non-copyable, non-assignable
+  FutexConditionVar(FutexConditionVar&);
+  FutexConditionVar& operator=(FutexConditionVar&);
+};
+
+} // namespace base
+
+#endif // MCP_BASE_FUTEX_MUTEX_HEADER
@@ -0,0 +1,195 @@
+#include <sys/time.h>
+#include <time.h>
+
+#include "callback.hpp"
+#include "futex_mutex.hpp"
+#include "thread.hpp"
+#include "test_unit.hpp"
+
+namespace {
+
+using base::Callback;
+using base::FutexConditionVar;
+using base::FutexMutex;
+using base::makeCallableOnce;
+using base::makeThread;
+
+// Has threads increment a counter under the mutex.
+class Incrementer {
+public:
+  Incrementer() : counter_(0) { }
+
+  int run(int num_threads, int incs) {
+    pthread_t tids[16];
+    for (int i = 0; i < num_threads; i++) {
+      tids[i] = makeThread(makeCallableOnce(&Incrementer::loop, this, incs));
+    }
+    for (int i = 0; i < num_threads; i++) {
+      pthread_join(tids[i], NULL);
+    }
+    return counter_;
+  }
+
+private:
+  FutexMutex m_;
+  int        counter_;
+
+  void loop(int incs) {
+    for (int i = 0; i < incs; i++) {
+      m_.lock();
+      counter_++;
+      m_.unlock();
+    }
+  }
+};
+
+// Threads wait until 'open_' is set, then check out.
+class Gate {
+public:
+  Gate() : open_(false), waiting_(0), passed_(0) { }
+
+  void pass() {
+    m_.lock();
+    waiting_++;
+    while (! open_) {
+      cv_.wait(&m_);
+    }
+    passed_++;
+    m_.unlock();
+  }
+
+  void waitForWaiters(int n) {
+    m_.lock();
+    while (waiting_ < n) {
+      m_.unlock();
+      sched_yield();
+      m_.lock();
+    }
+    m_.unlock();
+  }
+
+  void open(bool all) {
+    m_.lock();
+    open_ = true;
+    if (all) {
+      cv_.signalAll();
+    } else {
+      cv_.signal();
+    }
+    m_.unlock();
+  }
+
+  // Lets one more waiter through.
+  void signal() {
+    m_.lock();
+    cv_.signal();
+    m_.unlock();
+  }
+
+  int passed() {
+    m_.lock();
+    int res = passed_;
+    m_.unlock();
+    return res;
+  }
+
+private:
+  FutexMutex        m_;
+  FutexConditionVar cv_;
+  bool              open_;
+  int               waiting_;
+  int               passed_;
+};
+
+pthread_t startPassing(Gate* gate) {
+  return makeThread(makeCallableOnce(&Gate::pass, gate));
+}
+
+//
+// Test Cases
+//
+
+TEST(Mutex, Exclusion) {
+  Incrementer inc;
+  EXPECT_EQ(inc.run(4, 20000), 80000);
+}
+
+TEST(Mutex, Uncontended) {
+  FutexMutex m;
+  for (int i = 0; i < 1000; i++) {
+    m.lock();
+    m.unlock();
+  }
+  Incrementer inc;
+  EXPECT_EQ(inc.run(1, 1000), 1000);
+}
+
+TEST(ConditionVar, Signal) {
+  Gate gate;
+  pthread_t tids[2];
+  tids[0] = startPassing(&gate);
+  tids[1] = startPassing(&gate);
+  gate.waitForWaiters(2);
+
+  // One signal, one waiter through; the other one waits for another.
+  gate.open(false);
+  while (gate.passed() < 1) {
+    sched_yield();
+  }
+  gate.signal();
+  pthread_join(tids[0], NULL);
+  pthread_join(tids[1], NULL);
+  EXPECT_EQ(gate.passed(), 2);
+}
+
+TEST(ConditionVar, SignalAll) {
+  Gate gate;
+  pthread_t tids[4];
+  for (int i = 0; i < 4; i++) {
+    tids[i] = startPassing(&gate);
+  }
+  gate.waitForWaiters(4);
+
+  gate.open(true);
+  for (int i = 0; i < 4; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  EXPECT_EQ(gate.passed(), 4);
+}
+
+TEST(ConditionVar, TimedWait) {
+  FutexMutex m;
+  FutexConditionVar cv;
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  struct timespec deadline;
+  deadline.tv_sec = now.tv_sec;
+  deadline.tv_nsec = now.tv_usec * 1000 + 50 * 1000 * 1000;
+  if (deadline.tv_nsec >= 1000 * 1000 * 1000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000 * 1000 * 1000;
+  }
+
+  m.lock();
+  cv.timedWait(&m, &deadline);
+  m.unlock();
+
+  // Nobody signals: the wait ends at the deadline, not before.
+  struct timeval after;
+  gettimeofday(&after, NULL);
+  const long waited_us = (after.tv_sec - now.tv_sec) * 1000000L +
+                         (after.tv_usec - now.tv_usec);
+  EXPECT_GT(waited_us, 40000);
+
+  // A deadline in the past doesn't wait at all.
+  m.lock();
+  cv.timedWait(&m, &deadline);
+  m.unlock();
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  return RUN_TESTS(argc, argv);
+}
@@ -0,0 +1,406 @@
+#ifndef MCP_BASE_FUTURE_HEADER
+#define MCP_BASE_FUTURE_HEADER
+
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+#include "callback.hpp"
+#include "fixed_size_pool.hpp"
+#include "lock.hpp"
+#include "logging.hpp"
+#include "thread_pool.hpp"
+
+namespace base {
+
+using std::make_pair;
+using std::pair;
+using std::vector;
+
+// A Promise<T> is the producing end of a value that will be available
+// later; the Future<T>s it hands out are the consuming end. Instead of
+// blocking on the value, a consumer can chain a continuation with
+// then(), which runs on a given ThreadPool when the value is set, and
+// yields a Future of its own result. whenAll() and whenAny() combine
+// many futures into one.
+//
+// Nothing blocks unless get() or wait() is called: fanning out to
+// many backends and joining the answers with whenAll() ties up no
+// thread. The state shared by a promise and its futures, and the
+// continuation glue, come from FixedSizePool, so a hop allocates
+// nothing from the heap once the pools are warm.
+//
+// Restrictions:
+//   + a promise is set() exactly once
+//   + a future takes at most one continuation: then(), or being an
+//     input to whenAll() or whenAny(). A second one is a fatal error.
+//     get() and wait() can be used on top of that
+//   + there is no error channel; a failure must be part of T
+//   + T (and the result of a continuation) can't be void
+//
+// Thread safety:
+//   + Promise and Future are handles to a reference-counted state.
+//     Different handles can be used from different threads; a
+//     single handle shouldn't be shared unsynchronized
+//
+// Usage:
+//   Promise<int> promise;
+//   Future<string> f =
+//     promise.future().then(pool, makeCallableOnce(&Obj::format, &obj));
+//   ...
+//   promise.set(42);   // Obj::format(int) runs on 'pool'
+//   f.get();           // blocks until it did
+//
+//   // The setter of a promise is a ready-made callback:
+//   Promise<Response*> response;
+//   conn->asyncSend(request, makeCallableOnce(&Promise<Response*>::set,
+//                                             &response));
+//
+
+template<typename T> class Future;
+template<typename T> class Promise;
+
+// The state a promise and its futures share. Internal to this file.
+template<typename T>
+class FutureState : public Pooled<FutureState<T> > {
+public:
+  FutureState()
+    : refs_(1), ready_(false), continued_(false), cont_(NULL), pool_(NULL) { }
+  ~FutureState() { }
+
+  void ref() { __sync_fetch_and_add(&refs_, 1); }
+
+  void unref() {
+    if (__sync_sub_and_fetch(&refs_, 1) == 0) {
+      delete this;
+    }
+  }
+
+  // Stores 'value' and issues the continuation, if there's one.
+  void set(const T& value) {
+    m_.lock();
+    value_ = value;
+    ready_ = true;
+    Callback<void>* cont = cont_;
+    ThreadPool* pool = pool_;
+    cont_ = NULL;
+    cv_.signalAll();
+    m_.unlock();
+
+    if (cont != NULL) {
+      run(pool, cont);
+    }
+  }
+
+  // Issues 'cont' on 'pool' (inline if NULL) once the value is set.
+  void onReady(ThreadPool* pool, Callback<void>* cont) {
+    m_.lock();
+    if (continued_) {
+      LOG(LogMessage::FATAL) << "Future already has a continuation";
+      m_.unlock();
+      return;
+    }
+    continued_ = true;
+    if (! ready_) {
+      cont_ = cont;
+      pool_ = pool;
+      m_.unlock();
+      return;
+    }
+    m_.unlock();
+    run(pool, cont);
+  }
+
+  void wait() {
+    ScopedLock l(&m_);
+    while (! ready_) {
+      cv_.wait(&m_);
+    }
+  }
+
+  bool ready() {
+    ScopedLock l(&m_);
+    return ready_;
+  }
+
+  // REQUIRES: the value was set.
+  const T& value() const { return value_; }
+
+private:
+  int             refs_;
+  Mutex           m_;
+  ConditionVar    cv_;
+  bool            ready_;
+  bool            continued_;  // onReady() was called
+  T               value_;
+  Callback<void>* cont_;   // owned here until issued
+  ThreadPool*     pool_;   // not owned here
+
+  static void run(ThreadPool* pool, Callback<void>* cont) {
+    if (pool != NULL) {
+      pool->addTask(cont);
+    } else {
+      (*cont)();
+    }
+  }
+
+  // Non-copyable, non-assignable.
+  FutureState(const FutureState&);
+  FutureState& operator=(const FutureState&);
+};
+
+template<typename T>
+class Future {
+public:
+  // Builds an invalid future, to be assigned to.
+  Future() : state_(NULL) { }
+
+  Future(const Future& other) : state_(other.state_) {
+    if (state_ != NULL) state_->ref();
+  }
+
+  Future& operator=(const Future& other) {
+    if (other.state_ != NULL) other.state_->ref();
+    if (state_ != NULL) state_->unref();
+    state_ = other.state_;
+    return *this;
+  }
+
+  ~Future() {
+    if (state_ != NULL) state_->unref();
+  }
+
+  // Blocks until the value is set and returns it.
+  const T& get() const {
+    state_->wait();
+    return state_->value();
+  }
+
+  // Blocks until the value is set.
+  void wait() const { state_->wait(); }
+
+  // Returns true if the value was set.
+  bool ready() const { return state_->ready(); }
+
+  // Returns false for a default-built future.
+  bool valid() const { return state_ != NULL; }
+
+  // Returns a future for 'fn(value)', with 'fn' issued on 'pool' once
+  // this future's value is set. A NULL 'pool' issues 'fn' right in
+  // the thread setting the value. A once-callback 'fn' disposes of
+  // itself; otherwise the caller keeps ownership.
+  template<typename R>
+  Future<R> then(ThreadPool* pool, Callback<R, T>* fn);
+
+private:
+  template<typename U> friend class Future;
+  template<typename U> friend class Promise;
+  template<typename U>
+  friend Future<vector<U> > whenAll(const vector<Future<U> >& futures);
+  template<typename U>
+  friend Future<pair<size_t, U> > whenAny(const vector<Future<U> >& futures);
+
+  FutureState<T>* state_;
+
+  // Adopts one reference to 'state'.
+  explicit Future(FutureState<T>* state) : state_(state) { }
+};
+
+template<typename T>
+class Promise {
+public:
+  Promise() : state_(new FutureState<T>) { }
+  ~Promise() { state_->unref(); }
+
+  // Returns a future for the value this promise is set to.
+  Future<T> future() const {
+    state_->ref();
+    return Future<T>(state_);
+  }
+
+  // Sets the value and issues the continuation, if any. The promise
+  // may be destroyed as soon as a waiter sees the value, so the
+  // state is kept alive until set() is done with it.
+  void set(T value) {
+    FutureState<T>* state = state_;
+    state->ref();
+    state->set(value);
+    state->unref();
+  }
+
+private:
+  FutureState<T>* state_;
+
+  // Non-copyable, non-assignable.
+  Promise(const Promise&);
+  Promise& operator=(const Promise&);
+};
+
+//
+// Continuation glue. Internal to this file.
+//
+
+// Runs 'fn' on the value of 'src' and sets 'dst' with the result.
+template<typename T, typename R>
+class ThenTask : public Callback<void>, public Pooled<ThenTask<T, R> > {
+public:
+  ThenTask(FutureState<T>* src, FutureState<R>* dst, Callback<R, T>* fn)
+    : src_(src), dst_(dst), fn_(fn) { }
+  virtual ~ThenTask() { }
+
+  virtual void operator()() {
+    dst_->set((*fn_)(src_->value()));
+    src_->unref();
+    dst_->unref();
+    delete this;
+  }
+
+  virtual bool once() const { return true; }
+
+private:
+  FutureState<T>* src_;   // one reference owned here
+  FutureState<R>* dst_;   // ditto
+  Callback<R, T>* fn_;
+};
+
+// Collects the values of whenAll()'s inputs; the last one in sets the
+// result.
+template<typename T>
+class WhenAllState : public Pooled<WhenAllState<T> > {
+public:
+  WhenAllState(size_t n, FutureState<vector<T> >* dst)
+    : values_(n), remaining_(n), dst_(dst) { }
+  ~WhenAllState() { }
+
+  void arrive(size_t i, const T& value) {
+    values_[i] = value;
+    if (__sync_sub_and_fetch(&remaining_, 1) == 0) {
+      dst_->set(values_);
+      dst_->unref();
+      delete this;
+    }
+  }
+
+private:
+  vector<T>                 values_;
+  size_t                    remaining_;
+  FutureState<vector<T> >*  dst_;   // one reference owned here
+};
+
+template<typename T>
+class WhenAllPart : public Callback<void>, public Pooled<WhenAllPart<T> > {
+public:
+  WhenAllPart(FutureState<T>* src, WhenAllState<T>* all, size_t i)
+    : src_(src), all_(all), i_(i) { }
+  virtual ~WhenAllPart() { }
+
+  virtual void operator()() {
+    all_->arrive(i_, src_->value());
+    src_->unref();
+    delete this;
+  }
+
+  virtual bool once() const { return true; }
+
+private:
+  FutureState<T>*  src_;   // one reference owned here
+  WhenAllState<T>* all_;
+  size_t           i_;
+};
+
+// The first of whenAny()'s inputs in sets the result; the last one
+// disposes of this.
+template<typename T>
+class WhenAnyState : public Pooled<WhenAnyState<T> > {
+public:
+  WhenAnyState(size_t n, FutureState<pair<size_t, T> >* dst)
+    : done_(0), remaining_(n), dst_(dst) { }
+  ~WhenAnyState() { }
+
+  void arrive(size_t i, const T& value) {
+    if (__sync_bool_compare_and_swap(&done_, 0, 1)) {
+      dst_->set(make_pair(i, value));
+      dst_->unref();
+    }
+    if (__sync_sub_and_fetch(&remaining_, 1) == 0) {
+      delete this;
+    }
+  }
+
+private:
+  int                             done_;
+  size_t                          remaining_;
+  FutureState<pair<size_t, T> >*  dst_;   // one reference owned here
+};
+
+template<typename T>
+class WhenAnyPart : public Callback<void>, public Pooled<WhenAnyPart<T> > {
+public:
+  WhenAnyPart(FutureState<T>* src, WhenAnyState<T>* any, size_t i)
+    : src_(src), any_(any), i_(i) { }
+  virtual ~WhenAnyPart() { }
+
+  virtual void operator()() {
+    any_->arrive(i_, src_->value());
+    src_->unref();
+    delete this;
+  }
+
+  virtual bool once() const { return true; }
+
+private:
+  FutureState<T>*  src_;   // one reference owned here
+  WhenAnyState<T>* any_;
+  size_t           i_;
+};
+
+template<typename T>
+template<typename R>
+Future<R> Future<T>::then(ThreadPool* pool, Callback<R, T>* fn) {
+  FutureState<R>* dst = new FutureState<R>;   // task's reference
+  dst->ref();                                  // returned future's
+  state_->ref();
+  state_->onReady(pool, new ThenTask<T, R>(state_, dst, fn));
+  return Future<R>(dst);
+}
+
+// Returns a future for the values of all of 'futures', in the same
+// order, set once the last of them is.
+template<typename T>
+Future<vector<T> > whenAll(const vector<Future<T> >& futures) {
+  FutureState<vector<T> >* dst = new FutureState<vector<T> >;
+  if (futures.empty()) {
+    dst->set(vector<T>());
+    return Future<vector<T> >(dst);
+  }
+
+  dst->ref();
+  WhenAllState<T>* all = new WhenAllState<T>(futures.size(), dst);
+  for (size_t i = 0; i < futures.size(); i++) {
+    FutureState<T>* src = futures[i].state_;
+    src->ref();
+    src->onReady(NULL, new WhenAllPart<T>(src, all, i));
+  }
+  return Future<vector<T> >(dst);
+}
+
+// Returns a future for the index and value of the first of 'futures'
+// to be set. The glue is released only once all of them are set.
+//
+// REQUIRES: 'futures' is not empty.
+template<typename T>
+Future<pair<size_t, T> > whenAny(const vector<Future<T> >& futures) {
+  FutureState<pair<size_t, T> >* dst = new FutureState<pair<size_t, T> >;
+  dst->ref();
+  WhenAnyState<T>* any = new WhenAnyState<T>(futures.size(), dst);
+  for (size_t i = 0; i < futures.size(); i++) {
+    FutureState<T>* src = futures[i].state_;
+    src->ref();
+    src->onReady(NULL, new WhenAnyPart<T>(src, any, i));
+  }
+  return Future<pair<size_t, T> >(dst);
+}
+
+} // namespace base
+
+#endif // MCP_BASE_FUTURE_HEADER
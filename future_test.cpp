@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "callback.hpp"
+#include "fixed_size_pool.hpp"
+#include "future.hpp"
+#include "thread.hpp"
+#include "thread_pool_fast.hpp"
+#include "test_unit.hpp"
+
+namespace {
+
+using base::Callback;
+using base::FixedSizePool;
+using base::Future;
+using base::makeCallableMany;
+using base::makeCallableOnce;
+using base::makeThread;
+using base::Promise;
+using base::ThreadPool;
+using base::ThreadPoolFast;
+using base::whenAll;
+using base::whenAny;
+using std::find;
+using std::pair;
+using std::string;
+using std::vector;
+
+struct Ops {
+  int twice(int i) { return 2 * i; }
+  string show(int i) { return string(i, '*'); }
+  int sum(vector<int> v) {
+    int res = 0;
+    for (size_t i = 0; i < v.size(); i++) res += v[i];
+    return res;
+  }
+  void setLater(Promise<int>* p, int i) { p->set(i); }
+};
+
+typedef FixedSizePool<40> DepotPool;
+
+struct Releaser {
+  void releaseAll(vector<void*>* blocks) {
+    for (size_t i = 0; i < blocks->size(); i++) {
+      DepotPool::release((*blocks)[i]);
+    }
+  }
+};
+
+//
+// Test Cases
+//
+
+TEST(Pool, RecyclesBlocks) {
+  typedef FixedSizePool<48> Pool;
+  void* a = Pool::allocate();
+  Pool::release(a);
+  void* b = Pool::allocate();
+  EXPECT_EQ(a, b);
+  Pool::release(b);
+}
+
+TEST(Pool, RecyclesAcrossThreads) {
+  // Blocks released by a thread other than the allocating one spill
+  // over to the depot and come back from there.
+  vector<void*> blocks;
+  for (size_t i = 0; i < 2 * DepotPool::kMaxCached; i++) {
+    blocks.push_back(DepotPool::allocate());
+  }
+  Releaser releaser;
+  pthread_t tid = makeThread(makeCallableOnce(&Releaser::releaseAll,
+                                              &releaser,
+                                              &blocks));
+  pthread_join(tid, NULL);
+
+  void* p = DepotPool::allocate();
+  EXPECT_TRUE(find(blocks.begin(), blocks.end(), p) != blocks.end());
+  DepotPool::release(p);
+}
+
+TEST(Basics, SetThenGet) {
+  Promise<int> p;
+  Future<int> f = p.future();
+  EXPECT_TRUE(f.valid());
+  EXPECT_FALSE(f.ready());
+  p.set(7);
+  EXPECT_TRUE(f.ready());
+  EXPECT_EQ(f.get(), 7);
+  EXPECT_FALSE(Future<int>().valid());
+}
+
+TEST(Basics, SetFromPool) {
+  Ops ops;
+  ThreadPool* pool = new ThreadPoolFast(2);
+  Promise<int> p;
+  Future<int> f = p.future();
+  pool->addTask(makeCallableOnce(&Ops::setLater, &ops, &p, 5));
+  EXPECT_EQ(f.get(), 5);
+  pool->stop();
+  delete pool;
+}
+
+TEST(Then, Chain) {
+  Ops ops;
+  ThreadPool* pool = new ThreadPoolFast(2);
+  Promise<int> p;
+  Future<string> f = p.future()
+    .then(pool, makeCallableOnce(&Ops::twice, &ops))
+    .then(pool, makeCallableOnce(&Ops::show, &ops));
+  p.set(2);
+  EXPECT_EQ(f.get(), "****");
+  pool->stop();
+  delete pool;
+}
+
+TEST(Then, AlreadySet) {
+  Ops ops;
+  Promise<int> p;
+  p.set(3);
+  Callback<int, int>* fn = makeCallableMany(&Ops::twice, &ops);
+  Future<int> f = p.future().then(NULL, fn);
+  EXPECT_TRUE(f.ready());
+  EXPECT_EQ(f.get(), 6);
+  delete fn;
+}
+
+TEST(Then, SecondContinuation) {
+  // The first continuation stands; the second one is refused, whether
+  // the value is there yet or not.
+  Ops ops;
+  Callback<int, int>* fn = makeCallableMany(&Ops::twice, &ops);
+  Promise<int> p1;
+  Future<int> f1 = p1.future();
+  Future<int> first = f1.then(NULL, fn);
+  EXPECT_FATAL(f1.then(NULL, fn));
+  p1.set(4);
+  EXPECT_EQ(first.get(), 8);
+
+  Promise<int> p2;
+  p2.set(5);
+  Future<int> f2 = p2.future();
+  EXPECT_EQ(f2.then(NULL, fn).get(), 10);
+  vector<Future<int> > inputs(1, f2);
+  EXPECT_FATAL(whenAll(inputs));
+  delete fn;
+}
+
+TEST(WhenAll, FanOut) {
+  Ops ops;
+  ThreadPool* pool = new ThreadPoolFast(4);
+  const int n = 100;
+  vector<Promise<int>*> promises;
+  vector<Future<int> > futures;
+  for (int i = 0; i < n; i++) {
+    promises.push_back(new Promise<int>);
+    futures.push_back(promises.back()->future());
+  }
+  Future<int> total =
+    whenAll(futures).then(pool, makeCallableOnce(&Ops::sum, &ops));
+  for (int i = 0; i < n; i++) {
+    pool->addTask(makeCallableOnce(&Ops::setLater, &ops, promises[i], i));
+  }
+  EXPECT_EQ(total.get(), n * (n - 1) / 2);
+
+  pool->stop();
+  for (int i = 0; i < n; i++) {
+    delete promises[i];
+  }
+  delete pool;
+}
+
+TEST(WhenAll, Empty) {
+  Future<vector<int> > f = whenAll(vector<Future<int> >());
+  EXPECT_TRUE(f.ready());
+  EXPECT_EQ(f.get().size(), 0U);
+}
+
+TEST(WhenAny, FirstWins) {
+  Promise<int> a;
+  Promise<int> b;
+  vector<Future<int> > futures;
+  futures.push_back(a.future());
+  futures.push_back(b.future());
+  Future<pair<size_t, int> > f = whenAny(futures);
+  EXPECT_FALSE(f.ready());
+  b.set(20);
+  EXPECT_TRUE(f.ready());
+  a.set(10);
+  EXPECT_EQ(f.get().first, 1U);
+  EXPECT_EQ(f.get().second, 20);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  return RUN_TESTS(argc, argv);
+}
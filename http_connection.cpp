@@ -4,24 +4,60 @@
 #include <sstream>
 #include <sys/stat.h> // fstat
 #include <unistd.h>   // read, write, close
+#include <vector>
 
 #include "buffer.hpp"
+#include "future.hpp"
 #include "http_connection.hpp"
 #include "http_parser.hpp"
 #include "http_response.hpp"
 #include "http_service.hpp"
+#include "io_manager.hpp"
 #include "logging.hpp"
 #include "request_stats.hpp"
-#include "thread_pool_fast.hpp"
 #include "ticks_clock.hpp"
 
 namespace http {
 
 using std::ostringstream;
+using std::vector;
 using base::Buffer;
+using base::LogHistogram;
+using base::Promise;
 using base::RequestStats;
-using base::ThreadPoolFast;
 using base::TicksClock;
+using base::WorkerStats;
+
+namespace {
+
+// Writes the 50th and 99th percentiles of 'hist', in microseconds.
+void writePercentiles(const LogHistogram& hist, ostringstream* os) {
+  const double us_per_tick = 1e6 / TicksClock::ticksPerSecond();
+  *os << " p50 " << uint64_t(hist.percentile(0.50) * us_per_tick) << "us"
+      << " p99 " << uint64_t(hist.percentile(0.99) * us_per_tick) << "us";
+}
+
+// Returns one line per worker with its utilization, queue delays and
+// run times.
+string workerStatsString(IOService* io_service) {
+  vector<WorkerStats> stats;
+  io_service->io_manager()->getWorkerStats(&stats);
+
+  ostringstream os;
+  for (size_t i = 0; i < stats.size(); i++) {
+    os << "worker " << i
+       << " tasks " << stats[i].run_time.count()
+       << " util " << stats[i].utilization()
+       << " queue";
+    writePercentiles(stats[i].queue_delay, &os);
+    os << " run";
+    writePercentiles(stats[i].run_time, &os);
+    os << "\n";
+  }
+  return os.str();
+}
+
+} // unnamed namespace
 
 HTTPServerConnection::HTTPServerConnection(IOService* service, int client_fd)
   : Connection(service, client_fd) {
@@ -60,13 +96,20 @@ bool HTTPServerConnection::handleRequest(Request* request) {
     return false;
   }
 
+  // 'stats' returns the requests served in the last second;
+  // 'workerstats', where the workers' time goes.
   RequestStats* stats = io_service()->stats();
-  if (request_.address == "stats") {
-    uint32_t reqsLastSec;
-    stats->getStats(TicksClock::getTicks(), &reqsLastSec);
-    ostringstream stats_stream;
-    stats_stream << reqsLastSec;
-    string stats_string = stats_stream.str();
+  if (request_.address == "stats" || request_.address == "workerstats") {
+    string stats_string;
+    if (request_.address == "stats") {
+      uint32_t reqsLastSec;
+      stats->getStats(TicksClock::getTicks(), &reqsLastSec);
+      ostringstream stats_stream;
+      stats_stream << reqsLastSec;
+      stats_string = stats_stream.str();
+    } else {
+      stats_string = workerStatsString(io_service());
+    }
 
     m_write_.lock();
 
@@ -165,7 +208,8 @@ bool HTTPServerConnection::handleRequest(Request* request) {
 
   }
 
-  stats->finishedRequest(ThreadPoolFast::ME(), TicksClock::getTicks());
+  stats->finishedRequest(io_service()->io_manager()->workerNum(),
+                         TicksClock::getTicks());
 
   startWrite();
   return true;
@@ -253,21 +297,10 @@ void HTTPClientConnection::asyncSend(Request* request, ResponseCallback* cb) {
 }
 
 void HTTPClientConnection::send(Request* request, Response** response) {
-  Notification* n = new Notification;
-  ResponseCallback* cb = makeCallableOnce(&HTTPClientConnection::receiveInternal,
-                                          this,
-                                          n,
-                                          response);
+  Promise<Response*> promise;
+  ResponseCallback* cb = makeCallableOnce(&Promise<Response*>::set, &promise);
   asyncSend(request, cb);
-  n->wait();
-  delete n;
-}
-
-void HTTPClientConnection::receiveInternal(Notification* n,
-                                           Response** user_response,
-                                           Response* new_response) {
-  *user_response = new_response;
-  n->notify();
+  *response = promise.future().get();
 }
 
 }  // namespace http
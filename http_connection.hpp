@@ -16,7 +16,6 @@ using std::queue;
 using std::string;
 using base::IOService;
 using base::Mutex;
-using base::Notification;
 
 class Response;
 
@@ -128,11 +127,6 @@ private:
   virtual bool readDone();
   bool handleResponse(Response* response);
 
-  // Completion call used in sync receive().
-  void receiveInternal(Notification* n,
-                       Response** user_response,
-                       Response* new_response);
-
   // Non-copyable, non-assignable
   HTTPClientConnection(HTTPClientConnection&);
   HTTPClientConnection& operator=(HTTPClientConnection&);
@@ -2,6 +2,7 @@
 #include <string.h>  // strerror
 
 #include "callback.hpp"
+#include "future.hpp"
 #include "http_service.hpp"
 #include "http_connection.hpp"
 #include "logging.hpp"
@@ -11,6 +12,7 @@ namespace http {
 using base::Callback;
 using base::makeCallableMany;
 using base::makeCallableOnce;
+using base::Promise;
 
 HTTPService::HTTPService(int port, IOService* io_service)
   : io_service_(io_service) {
@@ -52,20 +54,11 @@ void HTTPService::asyncConnect(const string& host,
 void HTTPService::connect(const string& host,
                           int port,
                           HTTPClientConnection** conn) {
-  Notification n;
-  ConnectCallback* cb = makeCallableOnce(&HTTPService::connectInternal,
-                                         this,
-                                         &n,
-                                         conn);
+  Promise<HTTPClientConnection*> promise;
+  ConnectCallback* cb =
+    makeCallableOnce(&Promise<HTTPClientConnection*>::set, &promise);
   asyncConnect(host, port, cb);
-  n.wait();
-}
-
-void HTTPService::connectInternal(Notification* n,
-                                  HTTPClientConnection** user_conn,
-                                  HTTPClientConnection* new_conn) {
-  *user_conn = new_conn;
-  n->notify();
+  *conn = promise.future().get();
 }
 
 } // namespace http
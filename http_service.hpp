@@ -50,11 +50,6 @@ private:
   // Starts the server-side of a new HTTP connection established on
   // socket 'client_fd'.
   void acceptConnection(int client_fd);
-
-  // Completion call used in synchronous connection.
-  void connectInternal(Notification* n,
-                       HTTPClientConnection** user_conn,
-                       HTTPClientConnection* new_conn);
 };
 
 }  // namespace http
@@ -9,15 +9,37 @@
 #include "logging.hpp"
 #include "thread.hpp"
 #include "thread_pool_fast.hpp"
+#include "thread_pool_stealing.hpp"
 
 namespace base {
 
 using std::make_pair;
 using base::makeCallableMany;
 
-IOManager::IOManager(int num_workers)
+IOManager::IOManager(int num_workers,
+                     PoolType pool_type,
+                     const CpuPlacement& placement)
   : poller_(new DescriptorPoller),
-    worker_pool_(new ThreadPoolFast(num_workers)),
+    pool_type_(pool_type),
+    poll_cpu_(placement.cpuFor(0)),
+    worker_pool_(NULL),
+    deleted_desc_(NULL),
+    stopped_(false),
+    polling_(false) {
+  if (pool_type_ == STEALING_POOL) {
+    worker_pool_ = new ThreadPoolStealing(num_workers, placement.rotated());
+  } else {
+    worker_pool_ = new ThreadPoolFast(num_workers, placement.rotated());
+  }
+  poller_->create();
+}
+
+IOManager::IOManager(const ThreadPoolFast::Elastic& elastic,
+                     const CpuPlacement& placement)
+  : poller_(new DescriptorPoller),
+    pool_type_(FAST_POOL),
+    poll_cpu_(placement.cpuFor(0)),
+    worker_pool_(new ThreadPoolFast(elastic, placement.rotated())),
     deleted_desc_(NULL),
     stopped_(false),
     polling_(false) {
@@ -65,6 +87,8 @@ bool IOManager::stopped() const {
 }
 
 void IOManager::poll() {
+  CpuPlacement::pinCurrentThread(poll_cpu_);
+
   m_stop_.lock();
   polling_ = true;
   m_stop_.unlock();
@@ -90,17 +114,37 @@ void IOManager::delDescriptor(Descriptor* desc) {
   deleted_desc_ = desc;
 }
 
-void IOManager::addTimer(double delay, Callback<void>* task) {
+void IOManager::addTimer(double delay,
+                         Callback<void>* task,
+                         ThreadPool::Priority priority) {
   TicksClock::Ticks ts =
     TicksClock::getTicks() + delay * TicksClock::ticksPerSecond();
+  Timer timer = { task, priority };
 
   m_timer_queue_.lock();
-  timer_queue_.insert(make_pair(ts, task));
+  timer_queue_.insert(make_pair(ts, timer));
   m_timer_queue_.unlock();
 }
 
-void IOManager::addTask(Callback<void>* task) {
-  worker_pool_->addTask(task);
+void IOManager::addTask(Callback<void>* task,
+                        ThreadPool::Priority priority,
+                        TicksClock::Ticks deadline) {
+  worker_pool_->addPriorityTask(task, priority, deadline);
+}
+
+void IOManager::addTasks(Callback<void>** tasks, int n) {
+  worker_pool_->addTasks(tasks, n);
+}
+
+int IOManager::workerNum() const {
+  if (pool_type_ == STEALING_POOL) {
+    return ThreadPoolStealing::ME();
+  }
+  return ThreadPoolFast::ME();
+}
+
+void IOManager::getWorkerStats(vector<WorkerStats>* stats) const {
+  worker_pool_->getWorkerStats(stats);
 }
 
 void IOManager::pollBody() {
@@ -113,8 +157,10 @@ void IOManager::pollBody() {
       }
     }
 
-    // Issue the alarm callbacks that are due. We'll clean up the
+    // Collect the alarm callbacks that are due. We'll clean up the
     // queue shortly.
+    ready_.clear();
+    ready_timers_.clear();
     m_timer_queue_.lock();
     TicksClock::Ticks now = TicksClock::getTicks();
     TimerQueue::iterator to_execute = timer_queue_.begin();
@@ -122,23 +168,43 @@ void IOManager::pollBody() {
       if (to_execute->first > now) {
         break;
       }
-      worker_pool_->addTask(to_execute->second);
+      const Timer& timer = to_execute->second;
+      if (timer.priority == ThreadPool::PRIORITY_NORMAL) {
+        ready_.push_back(timer.task);
+      } else {
+        ready_timers_.push_back(timer);
+      }
       timer_queue_.erase(to_execute++);
     }
     m_timer_queue_.unlock();
 
     int e;
     Descriptor* desc;
+    Callback<void>* cb;
     for (int i = 0; i < res; i++) {
       poller_->getEvents(i, &e, &desc);
       if (e & (DescriptorPoller::DP_ERROR | DescriptorPoller::DP_READ_READY)) {
-        desc->readIfWaiting();
+        if ((cb = desc->readIfWaiting()) != NULL) {
+          ready_.push_back(cb);
+        }
       }
       if (e & (DescriptorPoller::DP_ERROR | DescriptorPoller::DP_WRITE_READY)) {
-        desc->writeIfWaiting();
+        if ((cb = desc->writeIfWaiting()) != NULL) {
+          ready_.push_back(cb);
+        }
       }
     }
 
+    // One submission for all the NORMAL upcalls of this iteration.
+    // The other timers go one by one; the pool sorts them into lanes.
+    for (size_t i = 0; i < ready_timers_.size(); i++) {
+      worker_pool_->addPriorityTask(ready_timers_[i].task,
+                                    ready_timers_[i].priority);
+    }
+    if (! ready_.empty()) {
+      worker_pool_->addTasks(&ready_[0], ready_.size());
+    }
+
     Descriptor* to_delete = NULL;
     m_deleted_desc_.lock();
     to_delete = deleted_desc_;
@@ -232,7 +298,7 @@ void Descriptor::writeWhenReady() {
   }
 }
 
-void Descriptor::readIfWaiting() {
+Callback<void>* Descriptor::readIfWaiting() {
   bool schedule_now = false;
 
   m_.lock();
@@ -244,12 +310,10 @@ void Descriptor::readIfWaiting() {
   }
   m_.unlock();
 
-  if (read_cb_ && schedule_now) {
-    workerPool()->addTask(read_cb_);
-  }
+  return schedule_now ? read_cb_ : NULL;
 }
 
-void Descriptor::writeIfWaiting() {
+Callback<void>* Descriptor::writeIfWaiting() {
   bool schedule_now = false;
 
   m_.lock();
@@ -261,9 +325,7 @@ void Descriptor::writeIfWaiting() {
   }
   m_.unlock();
 
-  if (write_cb_ && schedule_now) {
-    workerPool()->addTask(write_cb_);
-  }
+  return schedule_now ? write_cb_ : NULL;
 }
 
 } // namespace base
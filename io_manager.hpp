@@ -7,7 +7,9 @@
 #include <vector>
 
 #include "callback.hpp"
+#include "cpu_placement.hpp"
 #include "lock.hpp"
+#include "thread_pool.hpp"
 #include "thread_pool_fast.hpp"
 #include "ticks_clock.hpp"
 
@@ -52,10 +54,25 @@ class DescriptorPoller;
 
 class IOManager {
 public:
+  // Kinds of worker pool the upcalls can run on. See
+  // ThreadPoolFast and ThreadPoolStealing.
+  enum PoolType { FAST_POOL, STEALING_POOL };
+
   // Builds an IOManager instance backed by a thread pool with
-  // 'num_workers' threads. The threads are dedicated for running the
-  // upcall registered (see newDescriptor below).
-  explicit IOManager(int num_workers);
+  // 'num_workers' threads, of type 'pool_type'. The threads are
+  // dedicated for running the upcall registered (see newDescriptor
+  // below).
+  //
+  // The thread calling poll() is pinned to 'placement.cpuFor(0)' and
+  // the workers to the CPUs that follow it in 'placement'.
+  IOManager(int num_workers,
+            PoolType pool_type = FAST_POOL,
+            const CpuPlacement& placement = CpuPlacement());
+
+  // Builds an IOManager backed by an elastic ThreadPoolFast, bounded
+  // by 'elastic'. Pinning works as above.
+  explicit IOManager(const ThreadPoolFast::Elastic& elastic,
+                     const CpuPlacement& placement = CpuPlacement());
 
   // The destructor requires stop() to complete before it can be
   // issued.
@@ -90,19 +107,39 @@ public:
   // Timed execution support
 
   // Schedules 'task' to be executed at least 'delay' seconds
-  // (possibly fractional) from now.
-  void addTimer(double delay, Callback<void>* task);
+  // (possibly fractional) from now, in the 'priority' class once due.
+  void addTimer(double delay,
+                Callback<void>* task,
+                ThreadPool::Priority priority = ThreadPool::PRIORITY_NORMAL);
 
   // Schedules 'task' to be executed as soon as possible by one of the
-  // io_manager's workers.
-  void addTask(Callback<void>* task);
+  // io_manager's workers, in the 'priority' class. If 'deadline' (in
+  // TicksClock ticks; 0 for none) passes before a worker picks the
+  // task up, the pool may demote or shed it. See
+  // ThreadPool::addPriorityTask().
+  void addTask(Callback<void>* task,
+               ThreadPool::Priority priority = ThreadPool::PRIORITY_NORMAL,
+               TicksClock::Ticks deadline = 0);
+
+  // Schedules the 'n' callbacks in 'tasks' at once. See addTask().
+  void addTasks(Callback<void>** tasks, int n);
+
+  // Returns the number of the worker the call is being issued from.
+  // The call must be issued from a worker thread.
+  int workerNum() const;
+
+  // Copies the queue delay, run time and utilization stats of each
+  // worker into 'stats'. See ThreadPool::getWorkerStats().
+  void getWorkerStats(vector<WorkerStats>* stats) const;
 
 private:
   friend class Descriptor;
 
   DescriptorPoller* poller_;       // polling descriptor service
   pthread_t         poll_thread_;  // thread running epoll
-  ThreadPoolFast*   worker_pool_;  // threads running upcalls, owned here
+  PoolType          pool_type_;
+  int               poll_cpu_;     // -1 if the poll thread isn't pinned
+  ThreadPool*       worker_pool_;  // threads running upcalls, owned here
 
   // A descriptor that got closed will add itself to this
   // list. pollBody() periodically disposes of them. All GC activity
@@ -116,13 +153,25 @@ private:
   bool              polling_;      // is polling still ongoing?
   ConditionVar      cv_polling_;   // signal polling stopped
 
+  struct Timer {
+    Callback<void>*      task;
+    ThreadPool::Priority priority;
+  };
+
   // Keeps the timestamps for the next alarms and their respective
   // callbacks. All access to the queue is protected by
   // m_timer_queue_.
   Mutex             m_timer_queue_;
-  typedef multimap<TicksClock::Ticks, Callback<void>* > TimerQueue;
+  typedef multimap<TicksClock::Ticks, Timer> TimerQueue;
   TimerQueue        timer_queue_;
 
+  // Callbacks found ready in one polling iteration. The NORMAL ones
+  // are handed to the worker pool in one batch; due timers of other
+  // priorities are kept apart in ready_timers_. Only used by the
+  // polling thread.
+  vector<Callback<void>*> ready_;
+  vector<Timer>           ready_timers_;
+
   // Loops through registered descriptors and issues the related
   // callback when ready. In between iterations, garbage collect
   // descriptors that are no longer in use.
@@ -197,17 +246,18 @@ private:
              Callback<void>* write_cb);
   ~Descriptor();
 
-  // If the socket is on a 'wants to be read' mode, issues the read
-  // callback on the io_manager's threadpool and return. Otherwise,
-  // mark the socket as ready to read and return.
-  void readIfWaiting();
+  // If the socket is on a 'wants to be read' mode, returns the read
+  // callback, for the caller to issue on the io_manager's
+  // threadpool. Otherwise, marks the socket as ready to read and
+  // returns NULL.
+  Callback<void>* readIfWaiting();
 
   // Similar to readIfWaiting() but for writes.
-  void writeIfWaiting();
+  Callback<void>* writeIfWaiting();
 
   // accessors
 
-  ThreadPoolFast* workerPool() { return io_manager_->worker_pool_; }
+  ThreadPool* workerPool() { return io_manager_->worker_pool_; }
 };
 
 } // namespace base
@@ -4,13 +4,21 @@
 
 namespace base {
 
-IOService::IOService(int num_workers)
-  : io_manager_(new IOManager(num_workers)),
+IOService::IOService(int num_workers, const CpuPlacement& placement)
+  : io_manager_(new IOManager(num_workers, IOManager::FAST_POOL, placement)),
     stats_(num_workers),
     stop_requested_(false),
     stopped_(false) {
  }
 
+IOService::IOService(const ThreadPoolFast::Elastic& elastic,
+                     const CpuPlacement& placement)
+  : io_manager_(new IOManager(elastic, placement)),
+    stats_(elastic.max_workers),
+    stop_requested_(false),
+    stopped_(false) {
+}
+
 IOService::~IOService() {
   // It would be problematic if start() was still running after the
   // call to stop().  But that can't happen, for the following.  If
@@ -4,8 +4,10 @@
 #include <vector>
 
 #include "callback.hpp"
+#include "cpu_placement.hpp"
 #include "request_stats.hpp"
 #include "lock.hpp"
+#include "thread_pool_fast.hpp"
 
 namespace base {
 
@@ -37,7 +39,15 @@ typedef Callback<void, int> AcceptCallback;
 //
 class IOService {
 public:
-  explicit IOService(int num_workers = 1);
+  // The polling thread (the one calling start()) and the workers are
+  // pinned according to 'placement'. See IOManager.
+  explicit IOService(int num_workers = 1,
+                     const CpuPlacement& placement = CpuPlacement());
+
+  // Runs the upcalls on an elastic worker pool bounded by 'elastic'.
+  // The stats keep one slot per possible worker.
+  explicit IOService(const ThreadPoolFast::Elastic& elastic,
+                     const CpuPlacement& placement = CpuPlacement());
 
   // Destroys an IOService that was start()-ed or not.
   //
@@ -1,31 +1,470 @@
+#include <limits.h>
+
 #include "list_set.hpp"
 
 namespace base {
 
-ListBasedSet::ListBasedSet() {
+//
+// ListSetCoarse
+//
+
+ListSetCoarse::ListSetCoarse() {
+  tail_ = new Node;
+  tail_->value = INT_MAX;
+  tail_->next = NULL;
+  head_ = new Node;
+  head_->value = INT_MIN;
+  head_->next = tail_;
 }
 
-ListBasedSet::~ListBasedSet() {
+ListSetCoarse::~ListSetCoarse() {
+  clear();
+  delete head_;
+  delete tail_;
 }
 
-bool ListBasedSet::insert(int value) {
+ListSetCoarse::Node* ListSetCoarse::findPred(int value) const {
+  Node* pred = head_;
+  while (pred->next->value < value) {
+    pred = pred->next;
+  }
+  return pred;
+}
+
+bool ListSetCoarse::insert(int value) {
+  ScopedLock l(&m_);
+  Node* pred = findPred(value);
+  if (pred->next->value == value) {
+    return false;
+  }
+  Node* node = new Node;
+  node->value = value;
+  node->next = pred->next;
+  pred->next = node;
   return true;
 }
 
-bool ListBasedSet::remove(int value) {
+bool ListSetCoarse::remove(int value) {
+  ScopedLock l(&m_);
+  Node* pred = findPred(value);
+  Node* curr = pred->next;
+  if (curr->value != value) {
+    return false;
+  }
+  pred->next = curr->next;
+  delete curr;
   return true;
 }
 
-bool ListBasedSet::lookup(int value) const {
+bool ListSetCoarse::lookup(int value) const {
+  ScopedLock l(&m_);
+  return findPred(value)->next->value == value;
+}
+
+void ListSetCoarse::clear() {
+  Node* curr = head_->next;
+  while (curr != tail_) {
+    Node* to_delete = curr;
+    curr = curr->next;
+    delete to_delete;
+  }
+  head_->next = tail_;
+}
+
+bool ListSetCoarse::checkIntegrity() const {
+  ScopedLock l(&m_);
+  for (Node* curr = head_; curr != tail_; curr = curr->next) {
+    if (curr->value >= curr->next->value) {
+      return false;
+    }
+  }
   return true;
 }
 
-void ListBasedSet::clear() {
+//
+// ListSetHandOverHand
+//
+
+ListSetHandOverHand::ListSetHandOverHand() {
+  tail_ = new Node;
+  tail_->value = INT_MAX;
+  tail_->next = NULL;
+  head_ = new Node;
+  head_->value = INT_MIN;
+  head_->next = tail_;
+}
+
+ListSetHandOverHand::~ListSetHandOverHand() {
+  clear();
+  delete head_;
+  delete tail_;
+}
+
+void ListSetHandOverHand::findLocked(int value,
+                                     Node** pred,
+                                     Node** curr) const {
+  Node* p = head_;
+  p->m.lock();
+  Node* c = p->next;
+  c->m.lock();
+  while (c->value < value) {
+    p->m.unlock();
+    p = c;
+    c = c->next;
+    c->m.lock();
+  }
+  *pred = p;
+  *curr = c;
+}
+
+bool ListSetHandOverHand::insert(int value) {
+  Node* pred;
+  Node* curr;
+  findLocked(value, &pred, &curr);
+
+  bool inserted = false;
+  if (curr->value != value) {
+    Node* node = new Node;
+    node->value = value;
+    node->next = curr;
+    pred->next = node;
+    inserted = true;
+  }
+  curr->m.unlock();
+  pred->m.unlock();
+  return inserted;
 }
 
-bool ListBasedSet::checkIntegrity() const {
+bool ListSetHandOverHand::remove(int value) {
+  Node* pred;
+  Node* curr;
+  findLocked(value, &pred, &curr);
+
+  if (curr->value != value) {
+    curr->m.unlock();
+    pred->m.unlock();
+    return false;
+  }
+
+  // Nobody else can be waiting on 'curr': they'd need to hold 'pred'
+  // first.
+  pred->next = curr->next;
+  curr->m.unlock();
+  pred->m.unlock();
+  delete curr;
   return true;
 }
 
+bool ListSetHandOverHand::lookup(int value) const {
+  Node* pred;
+  Node* curr;
+  findLocked(value, &pred, &curr);
+  const bool found = curr->value == value;
+  curr->m.unlock();
+  pred->m.unlock();
+  return found;
+}
+
+void ListSetHandOverHand::clear() {
+  Node* curr = head_->next;
+  while (curr != tail_) {
+    Node* to_delete = curr;
+    curr = curr->next;
+    delete to_delete;
+  }
+  head_->next = tail_;
+}
+
+bool ListSetHandOverHand::checkIntegrity() const {
+  for (Node* curr = head_; curr != tail_; curr = curr->next) {
+    if (curr->value >= curr->next->value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// ListSetLazy
+//
+
+ListSetLazy::ListSetLazy() : retired_(NULL) {
+  tail_ = new Node;
+  tail_->value = INT_MAX;
+  tail_->next = NULL;
+  tail_->marked = false;
+  head_ = new Node;
+  head_->value = INT_MIN;
+  head_->next = tail_;
+  head_->marked = false;
+}
+
+ListSetLazy::~ListSetLazy() {
+  clear();
+  delete head_;
+  delete tail_;
+}
+
+void ListSetLazy::find(int value, Node** pred, Node** curr) const {
+  Node* p = head_;
+  Node* c = p->next;
+  while (c->value < value) {
+    p = c;
+    c = c->next;
+  }
+  *pred = p;
+  *curr = c;
+}
+
+bool ListSetLazy::validate(Node* pred, Node* curr) const {
+  return ! pred->marked && ! curr->marked && pred->next == curr;
+}
+
+void ListSetLazy::retire(Node* node) {
+  Node* old;
+  do {
+    old = retired_;
+    node->retired_next = old;
+  } while (! __sync_bool_compare_and_swap(&retired_, old, node));
+}
+
+bool ListSetLazy::insert(int value) {
+  Node* node = NULL;
+  while (true) {
+    Node* pred;
+    Node* curr;
+    find(value, &pred, &curr);
+
+    pred->m.lock();
+    curr->m.lock();
+    if (! validate(pred, curr)) {
+      curr->m.unlock();
+      pred->m.unlock();
+      continue;
+    }
+
+    bool inserted = false;
+    if (curr->value != value) {
+      node = new Node;
+      node->value = value;
+      node->next = curr;
+      node->marked = false;
+
+      // Lock-free traversals must see the node complete before they
+      // can reach it.
+      __sync_synchronize();
+      pred->next = node;
+      inserted = true;
+    }
+    curr->m.unlock();
+    pred->m.unlock();
+    return inserted;
+  }
+}
+
+bool ListSetLazy::remove(int value) {
+  while (true) {
+    Node* pred;
+    Node* curr;
+    find(value, &pred, &curr);
+
+    pred->m.lock();
+    curr->m.lock();
+    if (! validate(pred, curr)) {
+      curr->m.unlock();
+      pred->m.unlock();
+      continue;
+    }
+
+    bool removed = false;
+    if (curr->value == value) {
+      // Marking first is what makes lookup() right: a traversal that
+      // reaches 'curr' after it's unlinked still sees it's gone.
+      curr->marked = true;
+      pred->next = curr->next;
+      removed = true;
+    }
+    curr->m.unlock();
+    pred->m.unlock();
+    if (removed) {
+      retire(curr);
+    }
+    return removed;
+  }
+}
+
+bool ListSetLazy::lookup(int value) const {
+  Node* curr = head_;
+  while (curr->value < value) {
+    curr = curr->next;
+  }
+  return curr->value == value && ! curr->marked;
+}
+
+void ListSetLazy::clear() {
+  Node* curr = head_->next;
+  while (curr != tail_) {
+    Node* to_delete = curr;
+    curr = curr->next;
+    delete to_delete;
+  }
+  head_->next = tail_;
+
+  while (retired_ != NULL) {
+    Node* to_delete = retired_;
+    retired_ = to_delete->retired_next;
+    delete to_delete;
+  }
+}
+
+bool ListSetLazy::checkIntegrity() const {
+  for (Node* curr = head_; curr != tail_; curr = curr->next) {
+    if (curr->marked || curr->value >= curr->next->value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// ListSetLockFree
+//
+
+ListSetLockFree::ListSetLockFree() : retired_(NULL) {
+  tail_ = new Node;
+  tail_->value = INT_MAX;
+  tail_->next = 0;
+  head_ = new Node;
+  head_->value = INT_MIN;
+  head_->next = word(tail_);
+}
+
+ListSetLockFree::~ListSetLockFree() {
+  clear();
+  delete head_;
+  delete tail_;
+}
+
+void ListSetLockFree::retire(Node* node) {
+  Node* old;
+  do {
+    old = retired_;
+    node->retired_next = old;
+  } while (! __sync_bool_compare_and_swap(&retired_, old, node));
+}
+
+void ListSetLockFree::find(int value, Node** pred, Node** curr) {
+retry:
+  Node* p = head_;
+  Node* c = address(p->next);
+  while (true) {
+    uintptr_t succ = c->next;
+    while (isMarked(succ)) {
+      // 'c' is removed; unlink it. If 'p' changed meanwhile, start
+      // over.
+      if (! __sync_bool_compare_and_swap(&p->next, word(c), succ & ~1)) {
+        goto retry;
+      }
+      retire(c);
+      c = address(succ);
+      succ = c->next;
+    }
+    if (c->value >= value) {
+      *pred = p;
+      *curr = c;
+      return;
+    }
+    p = c;
+    c = address(succ);
+  }
+}
+
+bool ListSetLockFree::insert(int value) {
+  Node* node = NULL;
+  while (true) {
+    Node* pred;
+    Node* curr;
+    find(value, &pred, &curr);
+    if (curr->value == value) {
+      delete node;
+      return false;
+    }
+
+    if (node == NULL) {
+      node = new Node;
+      node->value = value;
+    }
+    node->next = word(curr);
+
+    // The CAS is a full barrier: the node is complete before it's
+    // reachable.
+    if (__sync_bool_compare_and_swap(&pred->next, word(curr), word(node))) {
+      return true;
+    }
+  }
+}
+
+bool ListSetLockFree::remove(int value) {
+  while (true) {
+    Node* pred;
+    Node* curr;
+    find(value, &pred, &curr);
+    if (curr->value != value) {
+      return false;
+    }
+
+    // Marking 'curr->next' removes 'curr' and keeps anyone from
+    // linking a node after it.
+    const uintptr_t succ = curr->next;
+    if (isMarked(succ)) {
+      continue;
+    }
+    if (! __sync_bool_compare_and_swap(&curr->next, succ, succ | 1)) {
+      continue;
+    }
+
+    // Try unlinking it; if that fails, a find() will.
+    if (__sync_bool_compare_and_swap(&pred->next, word(curr), succ)) {
+      retire(curr);
+    } else {
+      find(value, &pred, &curr);
+    }
+    return true;
+  }
+}
+
+bool ListSetLockFree::lookup(int value) const {
+  Node* curr = head_;
+  while (curr->value < value) {
+    curr = address(curr->next);
+  }
+  return curr->value == value && ! isMarked(curr->next);
+}
+
+void ListSetLockFree::clear() {
+  Node* curr = address(head_->next);
+  while (curr != tail_) {
+    Node* to_delete = curr;
+    curr = address(curr->next);
+    delete to_delete;
+  }
+  head_->next = word(tail_);
+
+  while (retired_ != NULL) {
+    Node* to_delete = retired_;
+    retired_ = to_delete->retired_next;
+    delete to_delete;
+  }
+}
+
+bool ListSetLockFree::checkIntegrity() const {
+  for (Node* curr = head_; curr != tail_; curr = address(curr->next)) {
+    if (isMarked(curr->next) ||
+        curr->value >= address(curr->next)->value) {
+      return false;
+    }
+  }
+  return true;
+}
 
 } // namespace base
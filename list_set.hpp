@@ -1,56 +1,200 @@
 #ifndef MCP_LIST_SET_HEADER
 #define MCP_LIST_SET_HEADER
 
+#include <stdint.h>
+
 #include "lock.hpp"
 
 namespace base {
 
 using base::Mutex;
 
-// This is a list-based set.
+// This is a list-based set: a sorted, singly-linked list of ints.
 //
 // The class is thread-safe for all item manipulation but not for bulk
 // clearing or destruction. We expect no concurrent access when the
 // latter are performed.
 //
+// There are four implementations, from the coarsest to the finest
+// synchronization:
+//   + ListSetCoarse: one mutex around the whole list
+//   + ListSetHandOverHand: a mutex per node; a traversal holds at most
+//     two, locking the next before releasing the previous ("lock
+//     coupling"), so operations on different parts of the list
+//     overlap
+//   + ListSetLazy: traversals take no lock; insert() and remove() lock
+//     the two nodes they change and validate them. A removal marks
+//     the node before unlinking it, so lookup() is wait-free
+//   + ListSetLockFree: Harris-Michael. A removal marks the node's next
+//     pointer, then unlinks it with a CAS; traversals unlink the marked
+//     nodes they come across. Nothing ever blocks
+//
+// The last two let traversals run over nodes that are being removed,
+// so they can't free a node when it's unlinked. They keep unlinked
+// nodes aside, and free them in clear() and at destruction.
+//
+// REQUIRES: values are strictly between INT_MIN and INT_MAX, which
+// the implementations use as sentinels.
+//
 class ListBasedSet {
 public:
-
-  // Creates a list.
-  ListBasedSet();
-
   // The destructor is not thread-safe.
-  ~ListBasedSet();
+  virtual ~ListBasedSet() { }
 
   // Returns true if 'value' does not yet exist on the set and inserts
   // it. Otherwise returns false.
-  bool insert(int value);
+  virtual bool insert(int value) = 0;
 
   // Returns true if 'value' exists on the set and remove it. Otherwise
   // returns false.
-  bool remove(int value);
+  virtual bool remove(int value) = 0;
 
   // Returns true if 'value' exists on the set.
-  bool lookup(int value) const;
+  virtual bool lookup(int value) const = 0;
 
   // Removes all the elements from the list. This is not a thread-safe
   // operation.
-  void clear();
+  virtual void clear() = 0;
 
   // Returns true after traversing the list, making sure the ordering
   // of elements is preserved. Otherwise returns false.
-  bool checkIntegrity() const;
+  virtual bool checkIntegrity() const = 0;
 
-private:
-  //
-  // ADD PRIVATE STATE HERE
-  //
+protected:
+  ListBasedSet() { }
 
+private:
   // Non-copyable, non-assignable.
   ListBasedSet(ListBasedSet&);
   ListBasedSet& operator=(const ListBasedSet&);
 };
 
+class ListSetCoarse : public ListBasedSet {
+public:
+  ListSetCoarse();
+  virtual ~ListSetCoarse();
+
+  virtual bool insert(int value);
+  virtual bool remove(int value);
+  virtual bool lookup(int value) const;
+  virtual void clear();
+  virtual bool checkIntegrity() const;
+
+private:
+  struct Node {
+    int   value;
+    Node* next;
+  };
+
+  mutable Mutex m_;      // protects the whole list
+  Node*         head_;   // INT_MIN sentinel
+  Node*         tail_;   // INT_MAX sentinel
+
+  // Returns the last node with a value smaller than 'value'.
+  // REQUIRES: m_ held.
+  Node* findPred(int value) const;
+};
+
+class ListSetHandOverHand : public ListBasedSet {
+public:
+  ListSetHandOverHand();
+  virtual ~ListSetHandOverHand();
+
+  virtual bool insert(int value);
+  virtual bool remove(int value);
+  virtual bool lookup(int value) const;
+  virtual void clear();
+  virtual bool checkIntegrity() const;
+
+private:
+  struct Node {
+    int   value;
+    Node* next;    // protected by m
+    Mutex m;
+  };
+
+  Node* head_;   // INT_MIN sentinel
+  Node* tail_;   // INT_MAX sentinel
+
+  // Sets '*pred' to the last node with a value smaller than 'value'
+  // and '*curr' to the one after it, both locked.
+  void findLocked(int value, Node** pred, Node** curr) const;
+};
+
+class ListSetLazy : public ListBasedSet {
+public:
+  ListSetLazy();
+  virtual ~ListSetLazy();
+
+  virtual bool insert(int value);
+  virtual bool remove(int value);
+  virtual bool lookup(int value) const;
+  virtual void clear();
+  virtual bool checkIntegrity() const;
+
+private:
+  struct Node {
+    int            value;
+    Node* volatile next;      // changed under m
+    volatile bool  marked;    // removed; changed under m
+    Mutex          m;
+    Node*          retired_next;
+  };
+
+  Node*          head_;      // INT_MIN sentinel
+  Node*          tail_;      // INT_MAX sentinel
+  Node* volatile retired_;   // unlinked, to be freed in clear()
+
+  // Sets '*pred' and '*curr' to the nodes around 'value', unlocked.
+  void find(int value, Node** pred, Node** curr) const;
+
+  // Returns true if 'pred' and 'curr' are still in the list and
+  // adjacent. REQUIRES: both locked.
+  bool validate(Node* pred, Node* curr) const;
+
+  void retire(Node* node);
+};
+
+class ListSetLockFree : public ListBasedSet {
+public:
+  ListSetLockFree();
+  virtual ~ListSetLockFree();
+
+  virtual bool insert(int value);
+  virtual bool remove(int value);
+  virtual bool lookup(int value) const;
+  virtual void clear();
+  virtual bool checkIntegrity() const;
+
+private:
+  // 'next' holds the successor's address, with the lowest bit set
+  // once the node is removed.
+  struct Node {
+    int               value;
+    volatile uintptr_t next;
+    Node*             retired_next;
+  };
+
+  Node*          head_;      // INT_MIN sentinel
+  Node*          tail_;      // INT_MAX sentinel
+  Node* volatile retired_;   // unlinked, to be freed in clear()
+
+  // Sets '*pred' to the last node with a value smaller than 'value'
+  // and '*curr' to the one after it, both unmarked when seen. Unlinks
+  // the marked nodes in between.
+  void find(int value, Node** pred, Node** curr);
+
+  void retire(Node* node);
+
+  static bool isMarked(uintptr_t next)   { return next & 1; }
+  static Node* address(uintptr_t next) {
+    return reinterpret_cast<Node*>(next & ~uintptr_t(1));
+  }
+  static uintptr_t word(Node* node)      {
+    return reinterpret_cast<uintptr_t>(node);
+  }
+};
+
 } // namespace base
 
 #endif  // MCP_LIST_SET_HEADER
@@ -0,0 +1,266 @@
+#include <inttypes.h>
+#include <iomanip>
+#include <iostream>
+#include <sched.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "callback.hpp"
+#include "list_set.hpp"
+#include "param_map.hpp"
+#include "thread.hpp"
+#include "ticks_clock.hpp"
+
+// Contrasts the ListBasedSet implementations. The set starts with
+// half of the keys in [0, 'range'). Each of 'threads' threads then
+// loops over a random operation on a random key in that range: a
+// lookup with probability 'lookups' percent, otherwise an insert or a
+// remove, evenly, so the set stays about half full.
+//
+// For every combination of the sweep parameters, it reports the
+// operations per second across all threads.
+//
+// Usage:
+//   list_set_benchmark --sets=coarse,hoh,lazy,lockfree --threads=1,4
+//                      --lookups=0,50,90,100 --ranges=64,1024
+//                      --duration=0.5
+//
+
+namespace {
+
+using std::cout;
+using std::endl;
+using std::istringstream;
+using std::setw;
+using std::string;
+using std::vector;
+
+using base::Callback;
+using base::ListBasedSet;
+using base::ListSetCoarse;
+using base::ListSetHandOverHand;
+using base::ListSetLazy;
+using base::ListSetLockFree;
+using base::makeCallableOnce;
+using base::makeThread;
+using base::ParamMap;
+using base::TicksClock;
+
+struct Config {
+  int    threads;
+  int    lookups;    // percent of operations that are lookups
+  int    range;      // keys are in [0, range)
+  double duration;   // in seconds
+};
+
+// Per-thread counters, each on cache lines of its own.
+struct ThreadStats {
+  uint64_t ops;
+  char     pad[64];
+};
+
+class Runner {
+public:
+  Runner(ListBasedSet* set, const Config& config)
+    : set_(set), config_(config), ready_(0), go_(0), stop_(0) { }
+
+  // Returns the operations per second.
+  double run() {
+    for (int k = 0; k < config_.range; k += 2) {
+      set_->insert(k);
+    }
+
+    vector<ThreadStats*> stats;
+    vector<pthread_t> tids;
+    for (int i = 0; i < config_.threads; i++) {
+      stats.push_back(new ThreadStats);
+      stats.back()->ops = 0;
+      const unsigned seed = i + 1;
+      Callback<void>* body =
+        makeCallableOnce(&Runner::loop, this, stats.back(), seed);
+      tids.push_back(makeThread(body));
+    }
+
+    while (ready_ < config_.threads) {
+      sched_yield();
+    }
+    const TicksClock::Ticks start = TicksClock::getTicks();
+    go_ = 1;
+
+    struct timespec t;
+    t.tv_sec = static_cast<time_t>(config_.duration);
+    t.tv_nsec = static_cast<long>((config_.duration - t.tv_sec) * 1e9);
+    nanosleep(&t, NULL);
+    stop_ = 1;
+
+    uint64_t total = 0;
+    for (int i = 0; i < config_.threads; i++) {
+      pthread_join(tids[i], NULL);
+      total += stats[i]->ops;
+      delete stats[i];
+    }
+    const TicksClock::Ticks end = TicksClock::getTicks();
+
+    if (! set_->checkIntegrity()) {
+      std::cerr << "set is corrupt" << endl;
+      exit(1);
+    }
+    return total * TicksClock::ticksPerSecond() / (end - start);
+  }
+
+private:
+  ListBasedSet*  set_;   // not owned here
+  const Config   config_;
+  int            ready_;
+  volatile int   go_;
+  volatile int   stop_;
+
+  void loop(ThreadStats* stats, unsigned seed) {
+    __sync_fetch_and_add(&ready_, 1);
+    while (! go_) {
+      sched_yield();
+    }
+
+    while (! stop_) {
+      const int op = rand_r(&seed) % 100;
+      const int key = rand_r(&seed) % config_.range;
+      if (op < config_.lookups) {
+        set_->lookup(key);
+      } else if ((op - config_.lookups) % 2 == 0) {
+        set_->insert(key);
+      } else {
+        set_->remove(key);
+      }
+      stats->ops++;
+    }
+  }
+};
+
+template<typename SetType>
+ListBasedSet* makeSet() {
+  return new SetType;
+}
+
+// The sets the benchmark knows about. Add new ones here.
+struct SetEntry {
+  const char* name;
+  ListBasedSet* (*make)();
+};
+
+const SetEntry sets[] = {
+  { "coarse",   &makeSet<ListSetCoarse> },
+  { "hoh",      &makeSet<ListSetHandOverHand> },
+  { "lazy",     &makeSet<ListSetLazy> },
+  { "lockfree", &makeSet<ListSetLockFree> },
+};
+
+const int num_sets = sizeof(sets) / sizeof(sets[0]);
+
+vector<string> split(const string& list) {
+  vector<string> res;
+  istringstream is(list);
+  string item;
+  while (getline(is, item, ',')) {
+    if (! item.empty()) {
+      res.push_back(item);
+    }
+  }
+  return res;
+}
+
+vector<int> splitInts(const string& list) {
+  vector<string> items = split(list);
+  vector<int> res;
+  for (size_t i = 0; i < items.size(); i++) {
+    res.push_back(atoi(items[i].c_str()));
+  }
+  return res;
+}
+
+string defaultThreads() {
+  const int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  std::ostringstream os;
+  os << 1;
+  for (int i = 2; i <= 2 * cpus; i *= 2) {
+    os << "," << i;
+  }
+  return os.str();
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  string all_sets;
+  for (int i = 0; i < num_sets; i++) {
+    all_sets += (i == 0 ? "" : ",") + string(sets[i].name);
+  }
+
+  ParamMap params;
+  params.addParam("sets", all_sets, "csv list of sets to run");
+  params.addParam("threads", defaultThreads(), "csv list of thread counts");
+  params.addParam("lookups", "0,50,90,100", "csv list of lookup percentages");
+  params.addParam("ranges", "64,1024", "csv list of key ranges");
+  params.addParam("duration", "0.2", "seconds per sweep point");
+  if (! params.parseArgv(argc, argv)) {
+    params.printUsage();
+    return -1;
+  }
+
+  string sets_param, threads_param, lookups_param, ranges_param;
+  string duration_param;
+  params.getParam("sets", &sets_param);
+  params.getParam("threads", &threads_param);
+  params.getParam("lookups", &lookups_param);
+  params.getParam("ranges", &ranges_param);
+  params.getParam("duration", &duration_param);
+
+  const vector<string> set_names = split(sets_param);
+  const vector<int> threads = splitInts(threads_param);
+  const vector<int> lookups = splitInts(lookups_param);
+  const vector<int> ranges = splitInts(ranges_param);
+
+  Config config;
+  config.duration = atof(duration_param.c_str());
+
+  // Calibrate the clock before anything is timed.
+  TicksClock::ticksPerSecond();
+
+  cout << std::left << setw(10) << "set" << setw(9) << "threads"
+       << setw(9) << "lookup%" << setw(8) << "range" << "ops/s" << endl;
+  for (size_t s = 0; s < set_names.size(); s++) {
+    const SetEntry* entry = NULL;
+    for (int i = 0; i < num_sets; i++) {
+      if (set_names[s] == sets[i].name) {
+        entry = &sets[i];
+      }
+    }
+    if (entry == NULL) {
+      std::cerr << "unknown set " << set_names[s] << endl;
+      return -1;
+    }
+
+    for (size_t r = 0; r < ranges.size(); r++) {
+      for (size_t t = 0; t < threads.size(); t++) {
+        for (size_t l = 0; l < lookups.size(); l++) {
+          config.threads = threads[t];
+          config.lookups = lookups[l];
+          config.range = ranges[r];
+          ListBasedSet* set = entry->make();
+          Runner runner(set, config);
+          const double ops = runner.run();
+          delete set;
+          cout << std::left << setw(10) << entry->name
+               << setw(9) << config.threads << setw(9) << config.lookups
+               << setw(8) << config.range
+               << static_cast<uint64_t>(ops) << endl;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
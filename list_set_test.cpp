@@ -1,13 +1,138 @@
+#include "callback.hpp"
 #include "list_set.hpp"
+#include "thread.hpp"
 #include "test_unit.hpp"
 
 namespace {
 
+using base::Callback;
 using base::ListBasedSet;
+using base::ListSetCoarse;
+using base::ListSetHandOverHand;
+using base::ListSetLazy;
+using base::ListSetLockFree;
+using base::makeCallableOnce;
+using base::makeThread;
+
+const int kNumImpls = 4;
+
+ListBasedSet* makeSet(int impl) {
+  switch (impl) {
+  case 0:  return new ListSetCoarse;
+  case 1:  return new ListSetHandOverHand;
+  case 2:  return new ListSetLazy;
+  default: return new ListSetLockFree;
+  }
+}
+
+// Each thread works on the values congruent to its id, modulo the
+// number of threads: it inserts all of them, then removes the odd
+// ones. Meanwhile, it looks up values other threads are working on.
+class Worker {
+public:
+  Worker(ListBasedSet* set, int id, int num_threads, int num_values)
+    : set_(set), id_(id), num_threads_(num_threads),
+      num_values_(num_values), failures_(0) { }
+
+  void run() {
+    for (int v = id_; v < num_values_; v += num_threads_) {
+      if (! set_->insert(v)) failures_++;
+      set_->lookup(num_values_ - v);
+    }
+    for (int v = id_; v < num_values_; v += num_threads_) {
+      if (v % 2 == 1 && ! set_->remove(v)) failures_++;
+      set_->lookup(v + 1);
+    }
+  }
+
+  int failures() const { return failures_; }
+
+private:
+  ListBasedSet* set_;
+  int           id_;
+  int           num_threads_;
+  int           num_values_;
+  int           failures_;
+};
+
+//
+// Test Cases
+//
 
 TEST(Simple, Insertion) {
-  ListBasedSet s;
-  EXPECT_TRUE(s.insert(99));
+  for (int i = 0; i < kNumImpls; i++) {
+    ListBasedSet* s = makeSet(i);
+    EXPECT_TRUE(s->insert(99));
+    EXPECT_FALSE(s->insert(99));
+    EXPECT_TRUE(s->lookup(99));
+    EXPECT_FALSE(s->lookup(98));
+    delete s;
+  }
+}
+
+TEST(Simple, Removal) {
+  for (int i = 0; i < kNumImpls; i++) {
+    ListBasedSet* s = makeSet(i);
+    EXPECT_FALSE(s->remove(5));
+    EXPECT_TRUE(s->insert(5));
+    EXPECT_TRUE(s->insert(3));
+    EXPECT_TRUE(s->insert(7));
+    EXPECT_TRUE(s->remove(5));
+    EXPECT_FALSE(s->remove(5));
+    EXPECT_FALSE(s->lookup(5));
+    EXPECT_TRUE(s->lookup(3));
+    EXPECT_TRUE(s->lookup(7));
+    EXPECT_TRUE(s->checkIntegrity());
+    delete s;
+  }
+}
+
+TEST(Simple, Clear) {
+  for (int i = 0; i < kNumImpls; i++) {
+    ListBasedSet* s = makeSet(i);
+    for (int v = 100; v > 0; v--) {
+      EXPECT_TRUE(s->insert(v));
+    }
+    EXPECT_TRUE(s->checkIntegrity());
+    for (int v = 1; v <= 100; v += 2) {
+      EXPECT_TRUE(s->remove(v));
+    }
+    s->clear();
+    EXPECT_FALSE(s->lookup(2));
+    EXPECT_TRUE(s->insert(2));
+    EXPECT_TRUE(s->checkIntegrity());
+    delete s;
+  }
+}
+
+TEST(Concurrent, InsertsAndRemoves) {
+  const int num_threads = 4;
+  const int num_values = 2000;
+  for (int i = 0; i < kNumImpls; i++) {
+    ListBasedSet* s = makeSet(i);
+    Worker* workers[num_threads];
+    pthread_t tids[num_threads];
+    for (int t = 0; t < num_threads; t++) {
+      workers[t] = new Worker(s, t, num_threads, num_values);
+      tids[t] = makeThread(makeCallableOnce(&Worker::run, workers[t]));
+    }
+    for (int t = 0; t < num_threads; t++) {
+      pthread_join(tids[t], NULL);
+      EXPECT_EQ(workers[t]->failures(), 0);
+      delete workers[t];
+    }
+
+    EXPECT_TRUE(s->checkIntegrity());
+    int missing = 0;
+    int extra = 0;
+    for (int v = 0; v < num_values; v++) {
+      if (v % 2 == 0 && ! s->lookup(v)) missing++;
+      if (v % 2 == 1 && s->lookup(v)) extra++;
+    }
+    EXPECT_EQ(missing, 0);
+    EXPECT_EQ(extra, 0);
+    delete s;
+  }
 }
 
 } // unnamed namespace
@@ -4,6 +4,10 @@
 #include <stdio.h>    // perror
 #include <pthread.h>
 
+#ifdef MCP_FUTEX_MUTEX
+#include "futex_mutex.hpp"
+#endif
+
 // Convenient wrappers around
 // + pthread_mutex
 // + pthread_cond
@@ -11,9 +15,20 @@
 //
 // And a mutex wrapper that locks at construction and unlocks at
 // destruction. It can be used for "scope locking."
+//
+// Building with MCP_FUTEX_MUTEX defined (waf configure --futex-mutex)
+// swaps Mutex and ConditionVar for the futex-based, adaptively
+// spinning FutexMutex and FutexConditionVar (see futex_mutex.hpp).
 
 namespace base {
 
+#ifdef MCP_FUTEX_MUTEX
+
+typedef FutexMutex        Mutex;
+typedef FutexConditionVar ConditionVar;
+
+#else
+
 class Mutex {
 public:
   Mutex()         { pthread_mutex_init(&m_, NULL); }
@@ -32,19 +47,6 @@ private:
   Mutex& operator=(Mutex&);
 };
 
-class ScopedLock {
-public:
-  explicit ScopedLock(Mutex* lock) : m_(lock) { m_->lock(); }
-  ~ScopedLock()   { m_->unlock(); }
-
-private:
-  Mutex* m_;
-
-  // Non-copyable, non-assignable
-  ScopedLock(ScopedLock&);
-  ScopedLock& operator=(ScopedLock&);
-};
-
 class ConditionVar {
 public:
   ConditionVar()          { pthread_cond_init(&cv_, NULL); }
@@ -67,6 +69,37 @@ private:
   ConditionVar& operator=(ConditionVar&);
 };
 
+#endif  // MCP_FUTEX_MUTEX
+
+class ScopedLock {
+public:
+  explicit ScopedLock(Mutex* lock) : m_(lock) { m_->lock(); }
+  ~ScopedLock()   { m_->unlock(); }
+
+private:
+  Mutex* m_;
+
+  // Non-copyable, non-assignable
+  ScopedLock(ScopedLock&);
+  ScopedLock& operator=(ScopedLock&);
+};
+
+// A ScopedLock for any class with lock() and unlock() -- the
+// spinlocks, say.
+template<typename LockType>
+class LockGuard {
+public:
+  explicit LockGuard(LockType* lock) : l_(lock) { l_->lock(); }
+  ~LockGuard()   { l_->unlock(); }
+
+private:
+  LockType* l_;
+
+  // Non-copyable, non-assignable
+  LockGuard(LockGuard&);
+  LockGuard& operator=(LockGuard&);
+};
+
 class RWMutex {
 public:
   RWMutex()      { pthread_rwlock_init(&rw_m_, NULL); }
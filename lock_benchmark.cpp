@@ -0,0 +1,377 @@
+#include <inttypes.h>
+#include <iomanip>
+#include <iostream>
+#include <math.h>
+#include <sched.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "callback.hpp"
+#include "cohort_lock.hpp"
+#include "futex_mutex.hpp"
+#include "lock.hpp"
+#include "log_histogram.hpp"
+#include "param_map.hpp"
+#include "spinlock.hpp"
+#include "spinlock_clh.hpp"
+#include "spinlock_mcs.hpp"
+#include "spinlock_ticket.hpp"
+#include "thread.hpp"
+#include "ticks_clock.hpp"
+
+// Contrasts locks under contention. Each of 'threads' threads loops
+// over: 'ncs' units of work outside the lock, then acquiring the lock,
+// 'cs' units of work inside it, and releasing it. A unit of work is
+// one iteration of a busy loop. Threads beyond the number of CPUs
+// show how a lock behaves when its holder may be preempted.
+//
+// For every combination of the sweep parameters, it reports:
+//   + throughput: lock acquisitions per second, across all threads
+//   + the latency of acquiring the lock (from calling lock() to it
+//     returning): p50, p99, p99.9 and max, in nanoseconds
+//   + fairness: the fewest acquisitions a thread got, as a fraction
+//     of the mean ('min_share'; 1.0 is perfectly even, 0.0 means some
+//     thread starved), and the coefficient of variation of the
+//     per-thread acquisitions ('cv'; 0.0 is perfectly even)
+//
+// Usage:
+//   lock_benchmark --locks=mutex,mcs --threads=1,2,4,8 --cs=0,100
+//                  --ncs=0,1000 --duration=0.5 --csv=true
+//
+// The default thread sweep goes from 1 to four times the number of
+// CPUs.
+
+namespace {
+
+using std::cout;
+using std::endl;
+using std::istringstream;
+using std::setprecision;
+using std::setw;
+using std::string;
+using std::vector;
+
+using base::Callback;
+using base::CohortLock;
+using base::FutexMutex;
+using base::LogHistogram;
+using base::makeCallableOnce;
+using base::makeThread;
+using base::Mutex;
+using base::ParamMap;
+using base::Spinlock;
+using base::SpinlockCLH;
+using base::SpinlockMCS;
+using base::SpinlockTicket;
+using base::TicksClock;
+
+// One sweep point.
+struct Config {
+  int    threads;
+  int    cs;
+  int    ncs;
+  double duration;   // in seconds
+};
+
+// What one sweep point measured.
+struct Result {
+  double   ops_per_sec;
+  double   p50_ns;
+  double   p99_ns;
+  double   p999_ns;
+  double   max_ns;
+  double   min_share;
+  double   cv;
+};
+
+void work(int units) {
+  volatile int sink = 0;
+  for (int i = 0; i < units; i++) {
+    sink = sink + i;
+  }
+}
+
+// Per-thread counters, each on cache lines of its own.
+struct ThreadStats {
+  uint64_t     acquisitions;
+  LogHistogram acquire_ticks;
+  char         pad[64];
+};
+
+template<typename LockType>
+class Contender {
+public:
+  explicit Contender(const Config& config)
+    : config_(config), ready_(0), go_(0), stop_(0), shared_(0) { }
+
+  Result run() {
+    vector<ThreadStats*> stats;
+    vector<pthread_t> tids;
+    for (int i = 0; i < config_.threads; i++) {
+      stats.push_back(new ThreadStats);
+      stats.back()->acquisitions = 0;
+      Callback<void>* body =
+        makeCallableOnce(&Contender::loop, this, stats.back());
+      tids.push_back(makeThread(body));
+    }
+
+    while (ready_ < config_.threads) {
+      sched_yield();
+    }
+    const TicksClock::Ticks start = TicksClock::getTicks();
+    go_ = 1;
+
+    struct timespec t;
+    t.tv_sec = static_cast<time_t>(config_.duration);
+    t.tv_nsec = static_cast<long>((config_.duration - t.tv_sec) * 1e9);
+    nanosleep(&t, NULL);
+    stop_ = 1;
+
+    for (int i = 0; i < config_.threads; i++) {
+      pthread_join(tids[i], NULL);
+    }
+    const TicksClock::Ticks end = TicksClock::getTicks();
+
+    Result res = summarize(stats, end - start);
+    for (int i = 0; i < config_.threads; i++) {
+      delete stats[i];
+    }
+    return res;
+  }
+
+private:
+  const Config   config_;
+  LockType       lock_;
+  int            ready_;
+  volatile int   go_;
+  volatile int   stop_;
+  uint64_t       shared_;   // only changed under lock_
+
+  void loop(ThreadStats* stats) {
+    __sync_fetch_and_add(&ready_, 1);
+    while (! go_) {
+      sched_yield();
+    }
+
+    while (! stop_) {
+      work(config_.ncs);
+
+      const TicksClock::Ticks before = TicksClock::getTicks();
+      lock_.lock();
+      const TicksClock::Ticks after = TicksClock::getTicks();
+      shared_++;
+      work(config_.cs);
+      lock_.unlock();
+
+      stats->acquire_ticks.record(after > before ? after - before : 0);
+      stats->acquisitions++;
+    }
+  }
+
+  Result summarize(const vector<ThreadStats*>& stats,
+                   TicksClock::Ticks elapsed) {
+    LogHistogram all;
+    uint64_t total = 0;
+    uint64_t fewest = stats[0]->acquisitions;
+    for (size_t i = 0; i < stats.size(); i++) {
+      all.merge(stats[i]->acquire_ticks);
+      total += stats[i]->acquisitions;
+      if (stats[i]->acquisitions < fewest) {
+        fewest = stats[i]->acquisitions;
+      }
+    }
+    if (total != shared_) {
+      std::cerr << "lost updates: " << total << " acquisitions, "
+                << shared_ << " increments" << endl;
+      exit(1);
+    }
+
+    const double mean = double(total) / stats.size();
+    double var = 0.0;
+    for (size_t i = 0; i < stats.size(); i++) {
+      const double d = stats[i]->acquisitions - mean;
+      var += d * d;
+    }
+    var /= stats.size();
+
+    const double ns_per_tick = 1e9 / TicksClock::ticksPerSecond();
+    Result res;
+    res.ops_per_sec = total * TicksClock::ticksPerSecond() / elapsed;
+    res.p50_ns = all.percentile(0.50) * ns_per_tick;
+    res.p99_ns = all.percentile(0.99) * ns_per_tick;
+    res.p999_ns = all.percentile(0.999) * ns_per_tick;
+    res.max_ns = all.max() * ns_per_tick;
+    res.min_share = mean > 0 ? fewest / mean : 0.0;
+    res.cv = mean > 0 ? sqrt(var) / mean : 0.0;
+    return res;
+  }
+};
+
+template<typename LockType>
+Result contend(const Config& config) {
+  Contender<LockType> contender(config);
+  return contender.run();
+}
+
+// The locks the benchmark knows about. Add new ones here.
+struct LockEntry {
+  const char* name;
+  Result (*contend)(const Config& config);
+};
+
+const LockEntry locks[] = {
+  { "mutex",  &contend<Mutex> },
+  { "futex",  &contend<FutexMutex> },
+  { "spin",   &contend<Spinlock> },
+  { "mcs",    &contend<SpinlockMCS> },
+  { "ticket", &contend<SpinlockTicket> },
+  { "clh",    &contend<SpinlockCLH> },
+  { "cohort", &contend<CohortLock> },
+};
+
+const int num_locks = sizeof(locks) / sizeof(locks[0]);
+
+// Splits the comma-separated 'list'.
+vector<string> split(const string& list) {
+  vector<string> res;
+  istringstream is(list);
+  string item;
+  while (getline(is, item, ',')) {
+    if (! item.empty()) {
+      res.push_back(item);
+    }
+  }
+  return res;
+}
+
+vector<int> splitInts(const string& list) {
+  vector<string> items = split(list);
+  vector<int> res;
+  for (size_t i = 0; i < items.size(); i++) {
+    res.push_back(atoi(items[i].c_str()));
+  }
+  return res;
+}
+
+string defaultThreads() {
+  const int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  std::ostringstream os;
+  os << 1;
+  for (int i = 2; i <= 4 * cpus; i *= 2) {
+    os << "," << i;
+  }
+  if (4 * cpus > 1 && (4 * cpus & (4 * cpus - 1)) != 0) {
+    os << "," << 4 * cpus;
+  }
+  return os.str();
+}
+
+void printHeader(bool csv) {
+  if (csv) {
+    cout << "lock,threads,cs,ncs,ops_per_sec,p50_ns,p99_ns,p999_ns,max_ns,"
+         << "min_share,cv" << endl;
+    return;
+  }
+  cout << std::left
+       << setw(8) << "lock" << setw(8) << "threads"
+       << setw(7) << "cs" << setw(7) << "ncs"
+       << setw(12) << "ops/s" << setw(10) << "p50ns"
+       << setw(10) << "p99ns" << setw(10) << "p99.9ns"
+       << setw(12) << "maxns" << setw(10) << "minshare"
+       << "cv" << endl;
+}
+
+void printResult(bool csv,
+                 const char* lock,
+                 const Config& config,
+                 const Result& res) {
+  if (csv) {
+    cout << lock << "," << config.threads << ","
+         << config.cs << "," << config.ncs << ","
+         << static_cast<uint64_t>(res.ops_per_sec) << ","
+         << res.p50_ns << "," << res.p99_ns << ","
+         << res.p999_ns << "," << res.max_ns << ","
+         << res.min_share << "," << res.cv << endl;
+    return;
+  }
+  cout << std::left << setprecision(3)
+       << setw(8) << lock << setw(8) << config.threads
+       << setw(7) << config.cs << setw(7) << config.ncs
+       << setw(12) << static_cast<uint64_t>(res.ops_per_sec)
+       << setw(10) << res.p50_ns << setw(10) << res.p99_ns
+       << setw(10) << res.p999_ns << setw(12) << res.max_ns
+       << setw(10) << res.min_share << res.cv << endl;
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  string all_locks;
+  for (int i = 0; i < num_locks; i++) {
+    all_locks += (i == 0 ? "" : ",") + string(locks[i].name);
+  }
+
+  ParamMap params;
+  params.addParam("locks", all_locks, "csv list of locks to run");
+  params.addParam("threads", defaultThreads(), "csv list of thread counts");
+  params.addParam("cs", "0,100,1000", "csv list of critical section lengths");
+  params.addParam("ncs", "0,1000", "csv list of non-critical work lengths");
+  params.addParam("duration", "0.2", "seconds per sweep point");
+  params.addParam("csv", "false", "print comma-separated values");
+  if (! params.parseArgv(argc, argv)) {
+    params.printUsage();
+    return -1;
+  }
+
+  string locks_param, threads_param, cs_param, ncs_param;
+  string duration_param, csv_param;
+  params.getParam("locks", &locks_param);
+  params.getParam("threads", &threads_param);
+  params.getParam("cs", &cs_param);
+  params.getParam("ncs", &ncs_param);
+  params.getParam("duration", &duration_param);
+  params.getParam("csv", &csv_param);
+
+  const vector<string> lock_names = split(locks_param);
+  const vector<int> threads = splitInts(threads_param);
+  const vector<int> css = splitInts(cs_param);
+  const vector<int> ncss = splitInts(ncs_param);
+  const bool csv = csv_param == "true";
+
+  Config config;
+  config.duration = atof(duration_param.c_str());
+
+  // Calibrate the clock before anything is timed.
+  TicksClock::ticksPerSecond();
+
+  printHeader(csv);
+  for (size_t l = 0; l < lock_names.size(); l++) {
+    const LockEntry* entry = NULL;
+    for (int i = 0; i < num_locks; i++) {
+      if (lock_names[l] == locks[i].name) {
+        entry = &locks[i];
+      }
+    }
+    if (entry == NULL) {
+      std::cerr << "unknown lock " << lock_names[l] << endl;
+      return -1;
+    }
+
+    for (size_t t = 0; t < threads.size(); t++) {
+      for (size_t c = 0; c < css.size(); c++) {
+        for (size_t n = 0; n < ncss.size(); n++) {
+          config.threads = threads[t];
+          config.cs = css[c];
+          config.ncs = ncss[n];
+          printResult(csv, entry->name, config, entry->contend(config));
+        }
+      }
+    }
+  }
+
+  return 0;
+}
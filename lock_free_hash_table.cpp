@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+#include "lock_free_hash_table.hpp"
+
+namespace base {
+
+namespace {
+
+// MurmurHash3's finalizer: every input bit affects every output bit.
+uint64_t mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+  return h;
+}
+
+uint64_t reverseBits(uint64_t v) {
+  // Swap ever larger groups of bits: odd and even bits, then pairs,
+  // nibbles, bytes, 16-bit and 32-bit halves.
+  static const uint64_t masks[] = { UINT64_C(0x5555555555555555),
+                                    UINT64_C(0x3333333333333333),
+                                    UINT64_C(0x0f0f0f0f0f0f0f0f),
+                                    UINT64_C(0x00ff00ff00ff00ff),
+                                    UINT64_C(0x0000ffff0000ffff) };
+  for (int i = 0; i < 5; i++) {
+    const int shift = 1 << i;
+    v = ((v >> shift) & masks[i]) | ((v & masks[i]) << shift);
+  }
+  return (v >> 32) | (v << 32);
+}
+
+}  // unnamed namespace
+
+uint64_t hashKey(uint64_t key) {
+  return mix(key);
+}
+
+uint64_t hashKey(const string& key) {
+  // FNV-1a, mixed further so the low bits are good too.
+  uint64_t h = UINT64_C(0xcbf29ce484222325);
+  for (size_t i = 0; i < key.size(); i++) {
+    h ^= static_cast<unsigned char>(key[i]);
+    h *= UINT64_C(0x100000001b3);
+  }
+  return mix(h);
+}
+
+uint64_t itemSplitKey(uint64_t hash) {
+  // Setting the top bit makes the reversed key odd, so it sorts after
+  // its bucket's dummy.
+  return reverseBits(hash | (uint64_t(1) << 63));
+}
+
+uint64_t dummySplitKey(size_t bucket) {
+  return reverseBits(bucket);
+}
+
+}  // namespace base
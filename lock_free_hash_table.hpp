@@ -0,0 +1,403 @@
+#ifndef MCP_BASE_LOCK_FREE_HASH_TABLE_HEADER
+#define MCP_BASE_LOCK_FREE_HASH_TABLE_HEADER
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string>
+
+namespace base {
+
+using std::string;
+
+// A LockFreeHashTable maps keys to (non-NULL) pointers. insert(),
+// lookup() and remove() never block: there are no locks, and a thread
+// stalled mid-operation doesn't keep others from completing theirs.
+//
+// It uses Shalev and Shavit's split-ordered lists. All items are in a
+// single lock-free linked list (Harris-Michael, as ListSetLockFree),
+// sorted by the bit-reversed hash of their keys. A bucket is a
+// pointer to a dummy node in that list, where the items hashing to
+// it start. In that order, the items of bucket b are followed by the
+// items of bucket b + n when there are n buckets -- so doubling the
+// number of buckets only takes splitting each bucket by inserting a
+// dummy node in the middle. Nothing is ever moved.
+//
+// The table doubles its buckets when it holds more than kMaxLoad
+// items per bucket on average; the new buckets are set up lazily, by
+// the first operation that needs each of them. Bucket pointers live
+// in segments of growing size (2, 2, 4, 8, ...), so growing never
+// copies the bucket array either.
+//
+// Removed items are unlinked, but their nodes are only freed when the
+// table is destroyed: a concurrent traversal may still be reading
+// them. A table with heavy churn grows accordingly.
+//
+// Keys can be uint64_t or string; others need a hashKey() overload.
+//
+// Thread safety:
+//   + insert(), lookup() and remove() can be issued concurrently
+//   + the destructor is not thread-safe
+//
+// Usage:
+//   LockFreeHashTable<string, Node> index;
+//   index.insert(file_name, node);
+//   Node* node = index.lookup(file_name);
+//   index.remove(file_name);
+//
+template<typename K, typename V>
+class LockFreeHashTable {
+public:
+  // Average items per bucket that triggers a doubling.
+  static const size_t kMaxLoad = 2;
+
+  LockFreeHashTable();
+  ~LockFreeHashTable();
+
+  // Maps 'key' to 'value' and returns true, unless 'key' is mapped
+  // already; then it returns false and changes nothing.
+  // REQUIRES: 'value' is not NULL.
+  bool insert(const K& key, V* value);
+
+  // Returns what 'key' maps to, or NULL if it isn't mapped.
+  V* lookup(const K& key) const;
+
+  // Unmaps 'key' and returns what it mapped to, or NULL if it wasn't
+  // mapped.
+  V* remove(const K& key);
+
+  // Returns the number of keys mapped. Approximate while the table is
+  // changing.
+  size_t size() const { return count_; }
+
+  // Returns the number of buckets, for testing.
+  size_t numBuckets() const { return num_buckets_; }
+
+private:
+  // Buckets are at most 2^kNumSegments.
+  static const int kNumSegments = 32;
+
+  // 'next' holds the successor's address, with the lowest bit set
+  // once the node is removed. Dummy nodes have even 'so_key's, items
+  // odd ones.
+  struct Node {
+    uint64_t           so_key;
+    K                  key;
+    V*                 value;
+    volatile uintptr_t next;
+    Node*              retired_next;
+
+    bool isDummy() const { return (so_key & 1) == 0; }
+  };
+
+  typedef Node* volatile Bucket;
+
+  Bucket* volatile segments_[kNumSegments];
+  volatile size_t  num_buckets_;   // a power of 2
+  volatile size_t  count_;
+  Node* volatile   retired_;       // unlinked, to be freed at the end
+
+  // Returns the slot of 'bucket', allocating its segment if needed.
+  Bucket* bucketSlot(size_t bucket);
+
+  // Returns the dummy node of 'bucket', setting it up if needed.
+  Node* bucketHead(size_t bucket);
+
+  // Returns the dummy node of 'bucket', or of the closest bucket it
+  // split from that has one.
+  Node* closestHead(size_t bucket) const;
+
+  // Sets '*pred' and '*curr' around where a node with 'so_key' and
+  // 'key' goes in the list, starting at 'head'. Returns true if
+  // '*curr' is such a node. Unlinks the removed nodes it comes
+  // across.
+  bool find(Node* head, uint64_t so_key, const K& key,
+            Node** pred, Node** curr);
+
+  // Links 'node' into the list starting at 'head'. Returns the node
+  // already there with the same key instead, if there's one.
+  Node* link(Node* head, Node* node);
+
+  void retire(Node* node);
+
+  // Returns the index of the highest bit set in 'bucket' > 0.
+  static int highestBit(size_t bucket) {
+    return 63 - __builtin_clzll(bucket);
+  }
+
+  // Returns the bucket 'bucket' > 0 splits from: the same bits but
+  // the highest one.
+  static size_t parentOf(size_t bucket) {
+    return bucket & ~(size_t(1) << highestBit(bucket));
+  }
+
+  static bool isMarked(uintptr_t next)   { return next & 1; }
+  static Node* address(uintptr_t next) {
+    return reinterpret_cast<Node*>(next & ~uintptr_t(1));
+  }
+  static uintptr_t word(Node* node)      {
+    return reinterpret_cast<uintptr_t>(node);
+  }
+
+  // Non-copyable, non-assignable
+  LockFreeHashTable(const LockFreeHashTable&);
+  LockFreeHashTable& operator=(const LockFreeHashTable&);
+};
+
+// Hashes for the supported keys. The results are well mixed in
+// their low bits, which pick the bucket.
+uint64_t hashKey(uint64_t key);
+uint64_t hashKey(const string& key);
+
+// Split-order keys of items and of bucket dummy nodes.
+uint64_t itemSplitKey(uint64_t hash);
+uint64_t dummySplitKey(size_t bucket);
+
+//
+// Implementation. Internal to this file.
+//
+
+template<typename K, typename V>
+LockFreeHashTable<K, V>::LockFreeHashTable()
+  : num_buckets_(2), count_(0), retired_(NULL) {
+  for (int i = 0; i < kNumSegments; i++) {
+    segments_[i] = NULL;
+  }
+
+  // Bucket 0's dummy heads the whole list.
+  Node* head = new Node;
+  head->so_key = dummySplitKey(0);
+  head->value = NULL;
+  head->next = 0;
+  *bucketSlot(0) = head;
+}
+
+template<typename K, typename V>
+LockFreeHashTable<K, V>::~LockFreeHashTable() {
+  Node* curr = *bucketSlot(0);
+  while (curr != NULL) {
+    Node* to_delete = curr;
+    curr = address(curr->next);
+    delete to_delete;
+  }
+  while (retired_ != NULL) {
+    Node* to_delete = retired_;
+    retired_ = to_delete->retired_next;
+    delete to_delete;
+  }
+  for (int i = 0; i < kNumSegments; i++) {
+    delete [] segments_[i];
+  }
+}
+
+template<typename K, typename V>
+typename LockFreeHashTable<K, V>::Bucket*
+LockFreeHashTable<K, V>::bucketSlot(size_t bucket) {
+  // Segment 0 has buckets 0 and 1; segment s > 0 has [2^s, 2^(s+1)).
+  int segment = 0;
+  size_t first = 0;
+  size_t segment_size = 2;
+  if (bucket >= 2) {
+    segment = highestBit(bucket);
+    first = size_t(1) << segment;
+    segment_size = first;
+  }
+
+  if (segments_[segment] == NULL) {
+    Bucket* buckets = new Bucket[segment_size];
+    for (size_t i = 0; i < segment_size; i++) {
+      buckets[i] = NULL;
+    }
+    if (! __sync_bool_compare_and_swap(&segments_[segment],
+                                       static_cast<Bucket*>(NULL),
+                                       buckets)) {
+      delete [] buckets;
+    }
+  }
+  return &segments_[segment][bucket - first];
+}
+
+template<typename K, typename V>
+typename LockFreeHashTable<K, V>::Node*
+LockFreeHashTable<K, V>::bucketHead(size_t bucket) {
+  Bucket* slot = bucketSlot(bucket);
+  if (*slot != NULL) {
+    return *slot;
+  }
+
+  // Split the bucket off its parent.
+  Node* dummy = new Node;
+  dummy->so_key = dummySplitKey(bucket);
+  dummy->value = NULL;
+  Node* head = link(bucketHead(parentOf(bucket)), dummy);
+  if (head != dummy) {
+    delete dummy;
+  }
+
+  // Everyone setting up this bucket found the same dummy.
+  *slot = head;
+  return head;
+}
+
+template<typename K, typename V>
+typename LockFreeHashTable<K, V>::Node*
+LockFreeHashTable<K, V>::closestHead(size_t bucket) const {
+  while (true) {
+    const int segment = bucket < 2 ? 0 : highestBit(bucket);
+    const size_t first = bucket < 2 ? 0 : size_t(1) << segment;
+    Bucket* buckets = segments_[segment];
+    if (buckets != NULL && buckets[bucket - first] != NULL) {
+      return buckets[bucket - first];
+    }
+    bucket = parentOf(bucket);
+  }
+}
+
+template<typename K, typename V>
+bool LockFreeHashTable<K, V>::find(Node* head, uint64_t so_key, const K& key,
+                                   Node** pred, Node** curr) {
+retry:
+  Node* p = head;
+  Node* c = address(p->next);
+  while (true) {
+    if (c == NULL) {
+      *pred = p;
+      *curr = NULL;
+      return false;
+    }
+
+    uintptr_t succ = c->next;
+    if (isMarked(succ)) {
+      // 'c' is removed; unlink it. If 'p' changed meanwhile, start
+      // over.
+      if (! __sync_bool_compare_and_swap(&p->next, word(c), succ & ~1)) {
+        goto retry;
+      }
+      retire(c);
+      c = address(succ);
+      continue;
+    }
+
+    if (c->so_key > so_key) {
+      *pred = p;
+      *curr = c;
+      return false;
+    }
+    if (c->so_key == so_key && (c->isDummy() || c->key == key)) {
+      *pred = p;
+      *curr = c;
+      return true;
+    }
+    p = c;
+    c = address(succ);
+  }
+}
+
+template<typename K, typename V>
+typename LockFreeHashTable<K, V>::Node*
+LockFreeHashTable<K, V>::link(Node* head, Node* node) {
+  while (true) {
+    Node* pred;
+    Node* curr;
+    if (find(head, node->so_key, node->key, &pred, &curr)) {
+      return curr;
+    }
+
+    // The CAS is a full barrier: the node is complete before it's
+    // reachable.
+    node->next = word(curr);
+    if (__sync_bool_compare_and_swap(&pred->next, word(curr), word(node))) {
+      return node;
+    }
+  }
+}
+
+template<typename K, typename V>
+void LockFreeHashTable<K, V>::retire(Node* node) {
+  Node* old;
+  do {
+    old = retired_;
+    node->retired_next = old;
+  } while (! __sync_bool_compare_and_swap(&retired_, old, node));
+}
+
+template<typename K, typename V>
+bool LockFreeHashTable<K, V>::insert(const K& key, V* value) {
+  const uint64_t hash = hashKey(key);
+  const size_t buckets = num_buckets_;
+
+  Node* node = new Node;
+  node->so_key = itemSplitKey(hash);
+  node->key = key;
+  node->value = value;
+  if (link(bucketHead(hash & (buckets - 1)), node) != node) {
+    delete node;
+    return false;
+  }
+
+  // Double the buckets if the load got too high. Only one of the
+  // threads noticing succeeds; the others see the new count.
+  const size_t count = __sync_add_and_fetch(&count_, 1);
+  if (count > buckets * kMaxLoad &&
+      buckets < (size_t(1) << (kNumSegments - 1))) {
+    __sync_bool_compare_and_swap(&num_buckets_, buckets, 2 * buckets);
+  }
+  return true;
+}
+
+template<typename K, typename V>
+V* LockFreeHashTable<K, V>::lookup(const K& key) const {
+  // Doesn't help unlinking removed nodes nor set up buckets, so it
+  // never writes.
+  const uint64_t hash = hashKey(key);
+  const uint64_t so_key = itemSplitKey(hash);
+  Node* curr = closestHead(hash & (num_buckets_ - 1));
+  while (curr != NULL && curr->so_key < so_key) {
+    curr = address(curr->next);
+  }
+  while (curr != NULL && curr->so_key == so_key) {
+    const uintptr_t next = curr->next;
+    if (curr->key == key && ! isMarked(next)) {
+      return curr->value;
+    }
+    curr = address(next);
+  }
+  return NULL;
+}
+
+template<typename K, typename V>
+V* LockFreeHashTable<K, V>::remove(const K& key) {
+  const uint64_t hash = hashKey(key);
+  const uint64_t so_key = itemSplitKey(hash);
+  Node* head = bucketHead(hash & (num_buckets_ - 1));
+  while (true) {
+    Node* pred;
+    Node* curr;
+    if (! find(head, so_key, key, &pred, &curr)) {
+      return NULL;
+    }
+
+    // Marking 'curr->next' removes 'curr' and keeps anyone from
+    // linking a node after it.
+    const uintptr_t succ = curr->next;
+    if (isMarked(succ)) {
+      continue;
+    }
+    if (! __sync_bool_compare_and_swap(&curr->next, succ, succ | 1)) {
+      continue;
+    }
+
+    // Try unlinking it; if that fails, a find() will.
+    V* value = curr->value;
+    if (__sync_bool_compare_and_swap(&pred->next, word(curr), succ)) {
+      retire(curr);
+    } else {
+      find(head, so_key, key, &pred, &curr);
+    }
+    __sync_sub_and_fetch(&count_, 1);
+    return value;
+  }
+}
+
+} // namespace base
+
+#endif // MCP_BASE_LOCK_FREE_HASH_TABLE_HEADER
@@ -0,0 +1,322 @@
+#include <inttypes.h>
+#include <iomanip>
+#include <iostream>
+#include <sched.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <tr1/unordered_map>
+#include <unistd.h>
+#include <vector>
+
+#include "callback.hpp"
+#include "lock.hpp"
+#include "lock_free_hash_table.hpp"
+#include "param_map.hpp"
+#include "scalable_rw_mutex.hpp"
+#include "thread.hpp"
+#include "ticks_clock.hpp"
+
+// Contrasts LockFreeHashTable with an unordered_map guarded by a
+// reader-writer lock. The map starts with half of the keys in
+// [0, 'keys'). Each of 'threads' threads then loops over a random
+// operation on a random key in that range: a lookup with probability
+// 'lookups' percent, otherwise an insert or a remove, evenly, so the
+// map stays about half full.
+//
+// For every combination of the sweep parameters, it reports the
+// operations per second across all threads.
+//
+// Usage:
+//   lock_free_hash_table_benchmark --maps=lockfree,rwmutex
+//                                  --threads=1,4 --lookups=50,90,100
+//                                  --keys=1000,100000 --duration=0.5
+//
+
+namespace {
+
+using std::cout;
+using std::endl;
+using std::istringstream;
+using std::setw;
+using std::string;
+using std::tr1::unordered_map;
+using std::vector;
+
+using base::Callback;
+using base::LockFreeHashTable;
+using base::makeCallableOnce;
+using base::makeThread;
+using base::ParamMap;
+using base::RWMutex;
+using base::ScalableRWMutex;
+using base::TicksClock;
+
+// The operations the benchmark issues, whatever the map.
+class Map {
+public:
+  virtual ~Map() { }
+  virtual bool insert(uint64_t key, int* value) = 0;
+  virtual int* lookup(uint64_t key) = 0;
+  virtual int* remove(uint64_t key) = 0;
+};
+
+class LockFreeMap : public Map {
+public:
+  virtual bool insert(uint64_t key, int* value) {
+    return table_.insert(key, value);
+  }
+  virtual int* lookup(uint64_t key) { return table_.lookup(key); }
+  virtual int* remove(uint64_t key) { return table_.remove(key); }
+
+private:
+  LockFreeHashTable<uint64_t, int> table_;
+};
+
+template<typename RWLockType>
+class LockedMap : public Map {
+public:
+  virtual bool insert(uint64_t key, int* value) {
+    rw_.wLock();
+    const bool inserted = map_.insert(std::make_pair(key, value)).second;
+    rw_.unlock();
+    return inserted;
+  }
+
+  virtual int* lookup(uint64_t key) {
+    rw_.rLock();
+    typename Table::const_iterator it = map_.find(key);
+    int* value = it == map_.end() ? NULL : it->second;
+    rw_.unlock();
+    return value;
+  }
+
+  virtual int* remove(uint64_t key) {
+    rw_.wLock();
+    int* value = NULL;
+    typename Table::iterator it = map_.find(key);
+    if (it != map_.end()) {
+      value = it->second;
+      map_.erase(it);
+    }
+    rw_.unlock();
+    return value;
+  }
+
+private:
+  typedef unordered_map<uint64_t, int*> Table;
+
+  RWLockType rw_;
+  Table      map_;
+};
+
+struct Config {
+  int    threads;
+  int    lookups;    // percent of operations that are lookups
+  int    keys;       // keys are in [0, keys)
+  double duration;   // in seconds
+};
+
+// Per-thread counters, each on cache lines of its own.
+struct ThreadStats {
+  uint64_t ops;
+  char     pad[64];
+};
+
+class Runner {
+public:
+  Runner(Map* map, const Config& config)
+    : map_(map), config_(config), ready_(0), go_(0), stop_(0) { }
+
+  // Returns the operations per second.
+  double run() {
+    for (int k = 0; k < config_.keys; k += 2) {
+      map_->insert(k, &value_);
+    }
+
+    vector<ThreadStats*> stats;
+    vector<pthread_t> tids;
+    for (int i = 0; i < config_.threads; i++) {
+      stats.push_back(new ThreadStats);
+      stats.back()->ops = 0;
+      const unsigned seed = i + 1;
+      Callback<void>* body =
+        makeCallableOnce(&Runner::loop, this, stats.back(), seed);
+      tids.push_back(makeThread(body));
+    }
+
+    while (ready_ < config_.threads) {
+      sched_yield();
+    }
+    const TicksClock::Ticks start = TicksClock::getTicks();
+    go_ = 1;
+
+    struct timespec t;
+    t.tv_sec = static_cast<time_t>(config_.duration);
+    t.tv_nsec = static_cast<long>((config_.duration - t.tv_sec) * 1e9);
+    nanosleep(&t, NULL);
+    stop_ = 1;
+
+    uint64_t total = 0;
+    for (int i = 0; i < config_.threads; i++) {
+      pthread_join(tids[i], NULL);
+      total += stats[i]->ops;
+      delete stats[i];
+    }
+    const TicksClock::Ticks end = TicksClock::getTicks();
+    return total * TicksClock::ticksPerSecond() / (end - start);
+  }
+
+private:
+  Map*           map_;   // not owned here
+  const Config   config_;
+  int            value_;
+  int            ready_;
+  volatile int   go_;
+  volatile int   stop_;
+
+  void loop(ThreadStats* stats, unsigned seed) {
+    __sync_fetch_and_add(&ready_, 1);
+    while (! go_) {
+      sched_yield();
+    }
+
+    while (! stop_) {
+      const int op = rand_r(&seed) % 100;
+      const uint64_t key = rand_r(&seed) % config_.keys;
+      if (op < config_.lookups) {
+        map_->lookup(key);
+      } else if ((op - config_.lookups) % 2 == 0) {
+        map_->insert(key, &value_);
+      } else {
+        map_->remove(key);
+      }
+      stats->ops++;
+    }
+  }
+};
+
+template<typename MapType>
+Map* makeMap() {
+  return new MapType;
+}
+
+// The maps the benchmark knows about. Add new ones here.
+struct MapEntry {
+  const char* name;
+  Map* (*make)();
+};
+
+const MapEntry maps[] = {
+  { "lockfree", &makeMap<LockFreeMap> },
+  { "rwmutex",  &makeMap<LockedMap<RWMutex> > },
+  { "scalable", &makeMap<LockedMap<ScalableRWMutex> > },
+};
+
+const int num_maps = sizeof(maps) / sizeof(maps[0]);
+
+vector<string> split(const string& list) {
+  vector<string> res;
+  istringstream is(list);
+  string item;
+  while (getline(is, item, ',')) {
+    if (! item.empty()) {
+      res.push_back(item);
+    }
+  }
+  return res;
+}
+
+vector<int> splitInts(const string& list) {
+  vector<string> items = split(list);
+  vector<int> res;
+  for (size_t i = 0; i < items.size(); i++) {
+    res.push_back(atoi(items[i].c_str()));
+  }
+  return res;
+}
+
+string defaultThreads() {
+  const int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  std::ostringstream os;
+  os << 1;
+  for (int i = 2; i <= 2 * cpus; i *= 2) {
+    os << "," << i;
+  }
+  return os.str();
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  string all_maps;
+  for (int i = 0; i < num_maps; i++) {
+    all_maps += (i == 0 ? "" : ",") + string(maps[i].name);
+  }
+
+  ParamMap params;
+  params.addParam("maps", all_maps, "csv list of maps to run");
+  params.addParam("threads", defaultThreads(), "csv list of thread counts");
+  params.addParam("lookups", "50,90,100", "csv list of lookup percentages");
+  params.addParam("keys", "1000,100000", "csv list of key ranges");
+  params.addParam("duration", "0.2", "seconds per sweep point");
+  if (! params.parseArgv(argc, argv)) {
+    params.printUsage();
+    return -1;
+  }
+
+  string maps_param, threads_param, lookups_param, keys_param;
+  string duration_param;
+  params.getParam("maps", &maps_param);
+  params.getParam("threads", &threads_param);
+  params.getParam("lookups", &lookups_param);
+  params.getParam("keys", &keys_param);
+  params.getParam("duration", &duration_param);
+
+  const vector<string> map_names = split(maps_param);
+  const vector<int> threads = splitInts(threads_param);
+  const vector<int> lookups = splitInts(lookups_param);
+  const vector<int> keys = splitInts(keys_param);
+
+  Config config;
+  config.duration = atof(duration_param.c_str());
+
+  // Calibrate the clock before anything is timed.
+  TicksClock::ticksPerSecond();
+
+  cout << std::left << setw(10) << "map" << setw(9) << "threads"
+       << setw(9) << "lookup%" << setw(9) << "keys" << "ops/s" << endl;
+  for (size_t m = 0; m < map_names.size(); m++) {
+    const MapEntry* entry = NULL;
+    for (int i = 0; i < num_maps; i++) {
+      if (map_names[m] == maps[i].name) {
+        entry = &maps[i];
+      }
+    }
+    if (entry == NULL) {
+      std::cerr << "unknown map " << map_names[m] << endl;
+      return -1;
+    }
+
+    for (size_t k = 0; k < keys.size(); k++) {
+      for (size_t t = 0; t < threads.size(); t++) {
+        for (size_t l = 0; l < lookups.size(); l++) {
+          config.threads = threads[t];
+          config.lookups = lookups[l];
+          config.keys = keys[k];
+          Map* map = entry->make();
+          Runner runner(map, config);
+          const double ops = runner.run();
+          delete map;
+          cout << std::left << setw(10) << entry->name
+               << setw(9) << config.threads << setw(9) << config.lookups
+               << setw(9) << config.keys
+               << static_cast<uint64_t>(ops) << endl;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
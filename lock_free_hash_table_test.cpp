@@ -0,0 +1,143 @@
+#include <inttypes.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "callback.hpp"
+#include "lock_free_hash_table.hpp"
+#include "thread.hpp"
+#include "test_unit.hpp"
+
+namespace {
+
+using base::LockFreeHashTable;
+using base::makeCallableOnce;
+using base::makeThread;
+using std::ostringstream;
+using std::string;
+using std::vector;
+
+typedef LockFreeHashTable<uint64_t, int> IntTable;
+
+// Each thread maps the keys congruent to its id, modulo the number of
+// threads, to their values; then unmaps the odd ones. Meanwhile, it
+// looks up keys other threads are working on.
+class Worker {
+public:
+  Worker(IntTable* table, vector<int>* values, int id, int num_threads)
+    : table_(table), values_(values), id_(id), num_threads_(num_threads),
+      failures_(0) { }
+
+  void run() {
+    const int n = values_->size();
+    for (int k = id_; k < n; k += num_threads_) {
+      if (! table_->insert(k, &(*values_)[k])) failures_++;
+      table_->lookup(n - 1 - k);
+    }
+    for (int k = id_; k < n; k += num_threads_) {
+      if (k % 2 == 1 && table_->remove(k) != &(*values_)[k]) failures_++;
+      table_->lookup(k + 1);
+    }
+  }
+
+  int failures() const { return failures_; }
+
+private:
+  IntTable*    table_;
+  vector<int>* values_;
+  int          id_;
+  int          num_threads_;
+  int          failures_;
+};
+
+//
+// Test Cases
+//
+
+TEST(Sequential, InsertLookupRemove) {
+  IntTable table;
+  int a = 1;
+  int b = 2;
+  EXPECT_TRUE(table.insert(10, &a));
+  EXPECT_FALSE(table.insert(10, &b));
+  EXPECT_TRUE(table.insert(20, &b));
+  EXPECT_EQ(table.lookup(10), &a);
+  EXPECT_EQ(table.lookup(20), &b);
+  EXPECT_EQ(table.lookup(30), static_cast<int*>(NULL));
+  EXPECT_EQ(table.size(), 2U);
+
+  EXPECT_EQ(table.remove(10), &a);
+  EXPECT_EQ(table.remove(10), static_cast<int*>(NULL));
+  EXPECT_EQ(table.lookup(10), static_cast<int*>(NULL));
+  EXPECT_EQ(table.size(), 1U);
+
+  // A removed key can come back.
+  EXPECT_TRUE(table.insert(10, &b));
+  EXPECT_EQ(table.lookup(10), &b);
+}
+
+TEST(Sequential, StringKeys) {
+  LockFreeHashTable<string, int> table;
+  int values[100];
+  for (int i = 0; i < 100; i++) {
+    ostringstream os;
+    os << "/files/" << i << ".html";
+    EXPECT_TRUE(table.insert(os.str(), &values[i]));
+  }
+  for (int i = 0; i < 100; i++) {
+    ostringstream os;
+    os << "/files/" << i << ".html";
+    EXPECT_EQ(table.lookup(os.str()), &values[i]);
+  }
+  EXPECT_EQ(table.lookup("/files/100.html"), static_cast<int*>(NULL));
+}
+
+TEST(Sequential, Grows) {
+  IntTable table;
+  const size_t initial = table.numBuckets();
+  vector<int> values(10000);
+  for (size_t k = 0; k < values.size(); k++) {
+    EXPECT_TRUE(table.insert(k, &values[k]));
+  }
+  EXPECT_TRUE(table.numBuckets() > initial);
+  EXPECT_TRUE(table.size() <= table.numBuckets() * IntTable::kMaxLoad);
+
+  int missing = 0;
+  for (size_t k = 0; k < values.size(); k++) {
+    if (table.lookup(k) != &values[k]) missing++;
+  }
+  EXPECT_EQ(missing, 0);
+}
+
+TEST(Concurrent, InsertsAndRemoves) {
+  const int num_threads = 4;
+  IntTable table;
+  vector<int> values(20000);
+  Worker* workers[num_threads];
+  pthread_t tids[num_threads];
+  for (int t = 0; t < num_threads; t++) {
+    workers[t] = new Worker(&table, &values, t, num_threads);
+    tids[t] = makeThread(makeCallableOnce(&Worker::run, workers[t]));
+  }
+  for (int t = 0; t < num_threads; t++) {
+    pthread_join(tids[t], NULL);
+    EXPECT_EQ(workers[t]->failures(), 0);
+    delete workers[t];
+  }
+
+  int missing = 0;
+  int extra = 0;
+  for (size_t k = 0; k < values.size(); k++) {
+    if (k % 2 == 0 && table.lookup(k) != &values[k]) missing++;
+    if (k % 2 == 1 && table.lookup(k) != NULL) extra++;
+  }
+  EXPECT_EQ(missing, 0);
+  EXPECT_EQ(extra, 0);
+  EXPECT_EQ(table.size(), values.size() / 2);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  return RUN_TESTS(argc, argv);
+}
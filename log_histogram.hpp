@@ -0,0 +1,134 @@
+#ifndef MCP_BASE_LOG_HISTOGRAM_HEADER
+#define MCP_BASE_LOG_HISTOGRAM_HEADER
+
+#include <inttypes.h>
+#include <string.h>
+
+namespace base {
+
+// A LogHistogram counts non-negative values (latencies, say) in
+// log-linear buckets. Values under kSubBuckets get a bucket each;
+// above that, every power of two is split into kSubBuckets equal
+// buckets. Any 64-bit value is covered by a fixed array of counters,
+// and a value is reported with a relative error under 1/kSubBuckets.
+//
+// Recording is a handful of plain instructions: no allocation, no
+// atomics.
+//
+// Thread safety:
+//   + a histogram has a single writer. Others may copy it or merge()
+//     it in concurrently; they then get a snapshot where counters
+//     may be off by the few values recorded meanwhile
+//
+// Usage:
+//   LogHistogram h;
+//   h.record(latency);
+//   ...
+//   uint64_t p99 = h.percentile(0.99);
+//
+class LogHistogram {
+public:
+  static const int kSubBits = 3;
+  static const int kSubBuckets = 1 << kSubBits;
+  static const int kNumBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+  LogHistogram() { clear(); }
+  ~LogHistogram() { }
+
+  void record(uint64_t val) {
+    counts_[bucketFor(val)]++;
+    count_++;
+    sum_ += val;
+    if (val > max_) {
+      max_ = val;
+    }
+  }
+
+  // Adds the values counted in 'other' to this histogram.
+  void merge(const LogHistogram& other) {
+    for (int i = 0; i < kNumBuckets; i++) {
+      counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    if (other.max_ > max_) {
+      max_ = other.max_;
+    }
+  }
+
+  void clear() {
+    memset(counts_, 0, sizeof(counts_));
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+  }
+
+  // Returns a value no smaller than the fraction 'p' (0.0 to 1.0) of
+  // the recorded values: the top of the bucket the p-th value fell
+  // in, capped at max(). Returns 0 if nothing was recorded.
+  uint64_t percentile(double p) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * count_);
+    if (rank == 0) {
+      rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; i++) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        uint64_t top = bucketTop(i);
+        return top < max_ ? top : max_;
+      }
+    }
+    return max_;
+  }
+
+  // Returns the bucket 'val' is counted in.
+  static int bucketFor(uint64_t val) {
+    if (val < static_cast<uint64_t>(kSubBuckets)) {
+      return static_cast<int>(val);
+    }
+    const int shift = 63 - __builtin_clzll(val) - kSubBits;
+    const int sub = static_cast<int>(val >> shift) & (kSubBuckets - 1);
+    return (shift + 1) * kSubBuckets + sub;
+  }
+
+  // Returns the smallest value counted in 'bucket'.
+  static uint64_t bucketBottom(int bucket) {
+    if (bucket < kSubBuckets) {
+      return bucket;
+    }
+    const int shift = bucket / kSubBuckets - 1;
+    const uint64_t sub = bucket % kSubBuckets;
+    return (kSubBuckets + sub) << shift;
+  }
+
+  // Returns the largest value counted in 'bucket'.
+  static uint64_t bucketTop(int bucket) {
+    if (bucket == kNumBuckets - 1) {
+      return ~static_cast<uint64_t>(0);
+    }
+    return bucketBottom(bucket + 1) - 1;
+  }
+
+  // accessors
+
+  uint64_t count() const { return count_; }
+  uint64_t sum() const   { return sum_; }
+  uint64_t max() const   { return max_; }
+  double mean() const    { return count_ ? double(sum_) / count_ : 0.0; }
+
+  // Copyable and assignable.
+
+private:
+  uint64_t counts_[kNumBuckets];
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t max_;
+};
+
+} // namespace base
+
+#endif // MCP_BASE_LOG_HISTOGRAM_HEADER
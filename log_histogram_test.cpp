@@ -0,0 +1,84 @@
+#include "log_histogram.hpp"
+#include "test_unit.hpp"
+
+namespace {
+
+using base::LogHistogram;
+
+//
+// Test Cases
+//
+
+TEST(Buckets, SmallValuesAreExact) {
+  for (int i = 0; i < LogHistogram::kSubBuckets; i++) {
+    EXPECT_EQ(LogHistogram::bucketFor(i), i);
+    EXPECT_EQ(LogHistogram::bucketBottom(i), uint64_t(i));
+    EXPECT_EQ(LogHistogram::bucketTop(i), uint64_t(i));
+  }
+}
+
+TEST(Buckets, BoundsContainValue) {
+  uint64_t val = 1;
+  for (int i = 0; i < 64; i++, val = val * 3 + 1) {
+    int bucket = LogHistogram::bucketFor(val);
+    EXPECT_TRUE(bucket < LogHistogram::kNumBuckets);
+    EXPECT_TRUE(LogHistogram::bucketBottom(bucket) <= val);
+    EXPECT_TRUE(val <= LogHistogram::bucketTop(bucket));
+  }
+  EXPECT_EQ(LogHistogram::bucketFor(~uint64_t(0)),
+            LogHistogram::kNumBuckets - 1);
+}
+
+TEST(Buckets, Contiguous) {
+  for (int i = 0; i < LogHistogram::kNumBuckets - 1; i++) {
+    EXPECT_EQ(LogHistogram::bucketTop(i) + 1,
+              LogHistogram::bucketBottom(i + 1));
+  }
+}
+
+TEST(Percentiles, Empty) {
+  LogHistogram h;
+  EXPECT_EQ(h.count(), 0U);
+  EXPECT_EQ(h.percentile(0.5), 0U);
+}
+
+TEST(Percentiles, RelativeError) {
+  LogHistogram h;
+  for (uint64_t i = 1; i <= 10000; i++) {
+    h.record(i);
+  }
+  EXPECT_EQ(h.count(), 10000U);
+  EXPECT_EQ(h.max(), 10000U);
+  EXPECT_EQ(h.sum(), 10000U * 10001 / 2);
+
+  // Within one sub-bucket (1/8) of the exact answer, never below it.
+  uint64_t p50 = h.percentile(0.50);
+  uint64_t p99 = h.percentile(0.99);
+  EXPECT_TRUE(p50 >= 5000 && p50 <= 5000 + 5000 / 8);
+  EXPECT_TRUE(p99 >= 9900 && p99 <= 10000);
+  EXPECT_EQ(h.percentile(1.0), 10000U);
+}
+
+TEST(Merge, AddsUp) {
+  LogHistogram a;
+  LogHistogram b;
+  for (int i = 0; i < 100; i++) {
+    a.record(10);
+    b.record(1000);
+  }
+  a.merge(b);
+  EXPECT_EQ(a.count(), 200U);
+  EXPECT_EQ(a.max(), 1000U);
+  EXPECT_TRUE(a.percentile(0.25) <= 10);
+  EXPECT_TRUE(a.percentile(0.75) >= 1000);
+
+  a.clear();
+  EXPECT_EQ(a.count(), 0U);
+  EXPECT_EQ(a.max(), 0U);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  return RUN_TESTS(argc, argv);
+}
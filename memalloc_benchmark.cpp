@@ -1,7 +1,13 @@
+// Compare myAlloc with and without huge page arenas with, e.g.,
+//   LD_PRELOAD=myAlloc_2Layer_lock/myAlloc.so ./memalloc_benchmark_glibc 4
+//   LD_PRELOAD=... MALLOCHUGEPAGES=1 ./memalloc_benchmark_glibc 4
+// dTLB misses are reported as 0 if the kernel doesn't let us count.
+//
 #include <iostream>
 
 #include "memtest_binsmgr.hpp"
 #include "callback.hpp"
+#include "perf_counter.hpp"
 #include "thread.hpp"
 #include "thread_barrier.hpp"
 #include "ticks_clock.hpp"
@@ -14,9 +20,13 @@ using base::Callback;
 using base::makeCallableOnce;
 using base::makeThread;
 using base::Barrier;
+using base::PerfCounter;
 using base::TicksClock;
 
-uint64_t memAllocBenchmark(const int N_THREADS, int maxsizeperbin) {
+// Returns the average ticks per round. Fills 'dtlb_misses' with the
+// average dTLB load misses per round.
+uint64_t memAllocBenchmark(const int N_THREADS, int maxsizeperbin,
+                           uint64_t* dtlb_misses) {
   size_t imax = 10000;
   const int rounds = 100;
   size_t numbins = MEMORYLIMIT / (N_THREADS * maxsizeperbin);
@@ -26,6 +36,8 @@ uint64_t memAllocBenchmark(const int N_THREADS, int maxsizeperbin) {
     (sizeof(Callback<void>*) * N_THREADS);
   pthread_t* tids =new pthread_t[N_THREADS];
   TicksClock::Ticks total = 0;
+  uint64_t total_misses = 0;
+  PerfCounter dtlb(PerfCounter::DTLB_LOAD_MISSES);
 
 
   for (int i = 0; i < rounds; ) {
@@ -36,7 +48,8 @@ uint64_t memAllocBenchmark(const int N_THREADS, int maxsizeperbin) {
           j + rounds, &b);
       bodies[j] = makeCallableOnce(&MemTestBinsMgr::MallocTest, testers[j]);
     }
-    // Create all child-threads
+    // Create all child-threads. They inherit the counter.
+    dtlb.start();
     for (int j = 0; j < N_THREADS; j++) {
       tids[j] = makeThread(bodies[j]);
     }
@@ -51,6 +64,8 @@ uint64_t memAllocBenchmark(const int N_THREADS, int maxsizeperbin) {
     // End of timing
     TicksClock::Ticks diff = TicksClock::getTicks() - start;
     total += diff;
+    dtlb.stop();
+    total_misses += dtlb.read();
     // std::cout << "Ticks used= " << diff << std::endl;
 
     i++;
@@ -74,6 +89,7 @@ uint64_t memAllocBenchmark(const int N_THREADS, int maxsizeperbin) {
   free(bodies);
   delete [] tids;
 
+  *dtlb_misses = total_misses / rounds;
   return total / static_cast<uint64_t>(rounds);
 }
 
@@ -81,11 +97,13 @@ void varyAllocSize(int N_THREADS) {
   int allocsize = 6;
   const int maxsize = 20, interval = 2;
   uint64_t ticksdiff;
+  uint64_t misses;
 
-  std::cout << "Allocsize(log 2)   Ticks\n";
+  std::cout << "Allocsize(log 2)   Ticks   dTLB-misses\n";
   while (allocsize <= maxsize) {
-    ticksdiff = memAllocBenchmark(N_THREADS, (1 << allocsize));
-    std::cout << allocsize << "   " << ticksdiff << std::endl;
+    ticksdiff = memAllocBenchmark(N_THREADS, (1 << allocsize), &misses);
+    std::cout << allocsize << "   " << ticksdiff << "   " << misses
+              << std::endl;
     allocsize += interval;
   }
 }
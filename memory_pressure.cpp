@@ -0,0 +1,115 @@
+#include <dlfcn.h>   // dlsym
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>  // strerror
+#include <unistd.h>
+#include <algorithm>
+
+#include "logging.hpp"
+#include "memory_pressure.hpp"
+#include "thread.hpp"
+
+namespace base {
+
+using std::find;
+
+// Entry points exported by myAlloc.so. See heap_alloc.cpp.
+typedef void (*SetLimitsFunc)(size_t soft, size_t hard);
+typedef void (*SetHandlerFunc)(void (*handler)(size_t bytes));
+
+pthread_once_t MemoryPressure::init_control_ = PTHREAD_ONCE_INIT;
+MemoryPressure* MemoryPressure::instance_ = NULL;
+
+MemoryPressure::MemoryPressure() : reclaiming_(false), reliefs_(0) {
+  pipe_fds_[0] = pipe_fds_[1] = -1;
+}
+
+MemoryPressure::~MemoryPressure() {
+}
+
+void MemoryPressure::init() {
+  instance_ = new MemoryPressure;
+}
+
+MemoryPressure* MemoryPressure::instance() {
+  pthread_once(&init_control_, &MemoryPressure::init);
+  return instance_;
+}
+
+bool MemoryPressure::setLimits(size_t soft, size_t hard) {
+  SetLimitsFunc set_limits = reinterpret_cast<SetLimitsFunc>(
+    dlsym(RTLD_DEFAULT, "mallocSetMemoryLimits"));
+  SetHandlerFunc set_handler = reinterpret_cast<SetHandlerFunc>(
+    dlsym(RTLD_DEFAULT, "mallocSetPressureHandler"));
+  if (set_limits == NULL || set_handler == NULL) {
+    LOG(LogMessage::WARNING) << "malloc does not support memory limits";
+    return false;
+  }
+
+  ScopedLock l(&m_);
+  if (! reclaiming_) {
+    if (pipe(pipe_fds_) < 0) {
+      LOG(LogMessage::ERROR) << "can't create pressure pipe: "
+                             << strerror(errno);
+      return false;
+    }
+    // The allocator must never block on the pipe. If the reclaimer is
+    // that far behind, dropping a request is fine.
+    fcntl(pipe_fds_[1], F_SETFL, O_NONBLOCK);
+
+    makeThread(makeCallableOnce(&MemoryPressure::reclaim, this));
+    reclaiming_ = true;
+    (*set_handler)(&MemoryPressure::allocatorHandler);
+  }
+  (*set_limits)(soft, hard);
+  return true;
+}
+
+void MemoryPressure::registerPressureHandler(Callback<void, size_t>* cb) {
+  ScopedLock l(&m_);
+  handlers_.push_back(cb);
+}
+
+bool MemoryPressure::unregisterPressureHandler(Callback<void, size_t>* cb) {
+  ScopedLock l(&m_);
+  Handlers::iterator it = find(handlers_.begin(), handlers_.end(), cb);
+  if (it == handlers_.end()) {
+    return false;
+  }
+  handlers_.erase(it);
+  return true;
+}
+
+void MemoryPressure::relieve(size_t bytes) {
+  ScopedLock l(&m_);
+  reliefs_++;
+  for (Handlers::iterator it = handlers_.begin(); it != handlers_.end(); ++it) {
+    (**it)(bytes);
+  }
+}
+
+void MemoryPressure::allocatorHandler(size_t bytes) {
+  // We're inside malloc() here. No locks, no allocation: a write of
+  // less than PIPE_BUF bytes to a pipe is atomic.
+  int res;
+  do {
+    res = write(instance_->pipe_fds_[1], &bytes, sizeof(bytes));
+  } while ((res < 0) && (errno == EINTR));
+}
+
+void MemoryPressure::reclaim() {
+  while (true) {
+    size_t bytes;
+    int res = read(pipe_fds_[0], &bytes, sizeof(bytes));
+    if (res < 0 && errno == EINTR) {
+      continue;
+    }
+    if (res != sizeof(bytes)) {
+      LOG(LogMessage::ERROR) << "pressure pipe closed: " << strerror(errno);
+      return;
+    }
+    relieve(bytes);
+  }
+}
+
+} // namespace base
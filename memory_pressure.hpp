@@ -0,0 +1,106 @@
+#ifndef MCP_BASE_MEMORY_PRESSURE_HEADER
+#define MCP_BASE_MEMORY_PRESSURE_HEADER
+
+#include <pthread.h>
+#include <vector>
+
+#include "callback.hpp"
+#include "lock.hpp"
+
+namespace base {
+
+using std::vector;
+
+// A singleton that lets caches give memory back when the process gets
+// close to its memory budget.
+//
+// Caches register a (repeatable) handler that receives the number of
+// bytes the process would like back. When the process is running on
+// top of our allocator (myAlloc.so), setLimits() arms it: as the heap
+// grows past the soft limit, the allocator reports how much, and the
+// handlers are called. Past the hard limit, the handlers are asked for
+// everything above the soft limit.
+//
+// The allocator notices pressure inside malloc(), possibly while the
+// application holds its own locks. So the handlers are never run from
+// there. The allocator just writes the request into a pipe and a
+// reclaimer thread, started by setLimits(), runs the handlers. A
+// handler can therefore take any lock its cache uses.
+//
+// Thread safety:
+//   + all methods are thread-safe
+//   + a handler must not call registerPressureHandler() or
+//     unregisterPressureHandler() -- handlers run under the same lock
+//
+// Usage:
+//   MemoryPressure* mp = MemoryPressure::instance();
+//   mp->setLimits(800<<20 /* soft */, 1000<<20 /* hard */);
+//
+//   Callback<void, size_t>* cb = makeCallableMany(&Cache::shrink, &cache);
+//   mp->registerPressureHandler(cb);
+//   ...
+//   mp->unregisterPressureHandler(cb);
+//   delete cb;
+//
+class MemoryPressure {
+public:
+  ~MemoryPressure();
+
+  // Returns MemoryPressure's singleton instance.
+  static MemoryPressure* instance();
+
+  // Sets the soft and hard heap limits, in bytes (0 disables a limit),
+  // and starts the reclaimer thread if need be. Returns false if the
+  // malloc in use does not support memory limits.
+  bool setLimits(size_t soft, size_t hard);
+
+  // Adds 'cb' to the handlers called on pressure. 'cb' must be a
+  // repeatable callback and is not owned here.
+  void registerPressureHandler(Callback<void, size_t>* cb);
+
+  // Removes 'cb' and returns true, if it was registered. When this
+  // returns, 'cb' is not running and won't be called anymore.
+  bool unregisterPressureHandler(Callback<void, size_t>* cb);
+
+  // Calls all registered handlers asking for 'bytes'. This is what the
+  // reclaimer thread does, but it can be called directly as well.
+  void relieve(size_t bytes);
+
+  // accessors
+
+  int reliefs() const { return reliefs_; }
+
+private:
+  typedef vector<Callback<void, size_t>*> Handlers;
+
+  // Singleton initialization state.
+  static pthread_once_t init_control_;
+  static MemoryPressure* instance_;
+
+  mutable Mutex m_;            // protects below and serializes relieve()
+  Handlers      handlers_;     // not owned here
+  bool          reclaiming_;   // reclaimer thread started
+  int           reliefs_;      // # of relieve() calls
+
+  // Pipe between the allocator (write end, non-blocking) and the
+  // reclaimer thread (read end).
+  int           pipe_fds_[2];
+
+  // Handler handed to the allocator. Runs inside malloc().
+  static void allocatorHandler(size_t bytes);
+
+  // Reclaimer thread body.
+  void reclaim();
+
+  // This is a singleton class. To access it, call 'instance()'.
+  MemoryPressure();
+  static void init();
+
+  // Non-copyable, non-assignable
+  MemoryPressure(MemoryPressure&);
+  MemoryPressure& operator=(MemoryPressure&);
+};
+
+} // namespace base
+
+#endif // MCP_BASE_MEMORY_PRESSURE_HEADER
@@ -0,0 +1,74 @@
+#include "callback.hpp"
+#include "memory_pressure.hpp"
+#include "test_unit.hpp"
+
+namespace {
+
+using base::Callback;
+using base::makeCallableMany;
+using base::MemoryPressure;
+
+class Shrinker {
+public:
+  Shrinker() : calls_(0), bytes_(0) { }
+
+  void shrink(size_t bytes) {
+    calls_++;
+    bytes_ += bytes;
+  }
+
+  int calls() const { return calls_; }
+  size_t bytes() const { return bytes_; }
+
+private:
+  int    calls_;
+  size_t bytes_;
+};
+
+TEST(Handlers, AllCalled) {
+  MemoryPressure* mp = MemoryPressure::instance();
+  Shrinker s1, s2;
+  Callback<void, size_t>* cb1 = makeCallableMany(&Shrinker::shrink, &s1);
+  Callback<void, size_t>* cb2 = makeCallableMany(&Shrinker::shrink, &s2);
+  mp->registerPressureHandler(cb1);
+  mp->registerPressureHandler(cb2);
+
+  int reliefs = mp->reliefs();
+  mp->relieve(100);
+  mp->relieve(50);
+  EXPECT_EQ(mp->reliefs(), reliefs + 2);
+  EXPECT_EQ(s1.calls(), 2);
+  EXPECT_EQ(s1.bytes(), 150U);
+  EXPECT_EQ(s2.calls(), 2);
+  EXPECT_EQ(s2.bytes(), 150U);
+
+  EXPECT_TRUE(mp->unregisterPressureHandler(cb1));
+  EXPECT_TRUE(mp->unregisterPressureHandler(cb2));
+  delete cb1;
+  delete cb2;
+}
+
+TEST(Handlers, Unregister) {
+  MemoryPressure* mp = MemoryPressure::instance();
+  Shrinker s;
+  Callback<void, size_t>* cb = makeCallableMany(&Shrinker::shrink, &s);
+  mp->registerPressureHandler(cb);
+  EXPECT_TRUE(mp->unregisterPressureHandler(cb));
+  EXPECT_FALSE(mp->unregisterPressureHandler(cb));
+
+  mp->relieve(100);
+  EXPECT_EQ(s.calls(), 0);
+  delete cb;
+}
+
+TEST(Limits, NeedsOurMalloc) {
+  // This test does not run on top of myAlloc.so, so there are no
+  // limits to set.
+  EXPECT_FALSE(MemoryPressure::instance()->setLimits(1 << 20, 2 << 20));
+}
+
+}  // unnamed namespace
+
+int main(int argc, char *argv[]) {
+  return RUN_TESTS(argc, argv);
+}
@@ -0,0 +1,174 @@
+#ifndef MCP_BASE_MPMC_QUEUE_HEADER
+#define MCP_BASE_MPMC_QUEUE_HEADER
+
+#include <stddef.h>
+
+namespace base {
+
+// A bounded, lock-free, multi-producer multi-consumer FIFO queue
+// (Dmitry Vyukov's design). The queue is a ring of cells, each
+// carrying a sequence number that says whether the cell is ready to
+// be written (seq == pos) or read (seq == pos + 1) at a given
+// position. Producers and consumers each claim a position with one
+// CAS; they only contend with their own kind.
+//
+// The queue never blocks and never allocates after construction:
+// tryPush() fails if the queue is full and tryPop() fails if it is
+// empty. See EventCount for a way to wait for either condition.
+//
+// T must be copyable with plain loads and stores (a pointer, say).
+//
+// Thread safety:
+//   + all methods are thread-safe
+//
+// Usage:
+//   MPMCQueue<Task*> queue(1024);
+//   if (! queue.tryPush(task)) ... queue full
+//   if (queue.tryPop(&task)) ...
+//
+template<typename T>
+class MPMCQueue {
+public:
+  // Builds a queue holding up to 'capacity' items, rounded up to a
+  // power of 2.
+  explicit MPMCQueue(size_t capacity);
+  ~MPMCQueue();
+
+  // Adds 'item' at the tail of the queue and returns true, or returns
+  // false if the queue is full.
+  bool tryPush(T item);
+
+  // Removes the item at the head into 'item' and returns true, or
+  // returns false if the queue is empty.
+  bool tryPop(T* item);
+
+  // accessors
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Returns the number of items in the queue. The result is a
+  // snapshot and may be stale by the time it is used.
+  size_t size() const;
+
+private:
+  struct Cell {
+    volatile size_t seq;
+    T               item;
+  };
+
+  static const int kLineSizeInBytes = 64;
+
+  // Each index gets its own cache line: producers only write the
+  // tail, consumers only write the head.
+  char            pad0_[kLineSizeInBytes];
+  Cell* const     cells_;
+  const size_t    mask_;
+  char            pad1_[kLineSizeInBytes - sizeof(Cell*) - sizeof(size_t)];
+  volatile size_t tail_;   // next position to push to
+  char            pad2_[kLineSizeInBytes - sizeof(size_t)];
+  volatile size_t head_;   // next position to pop from
+  char            pad3_[kLineSizeInBytes - sizeof(size_t)];
+
+  static size_t roundUp(size_t capacity);
+
+  // Non-copyable, non-assignable
+  MPMCQueue(const MPMCQueue&);
+  MPMCQueue& operator=(const MPMCQueue&);
+};
+
+template<typename T>
+MPMCQueue<T>::MPMCQueue(size_t capacity)
+  : cells_(new Cell[roundUp(capacity)]),
+    mask_(roundUp(capacity) - 1),
+    tail_(0),
+    head_(0) {
+  for (size_t i = 0; i <= mask_; i++) {
+    cells_[i].seq = i;
+  }
+}
+
+template<typename T>
+MPMCQueue<T>::~MPMCQueue() {
+  delete [] cells_;
+}
+
+template<typename T>
+bool MPMCQueue<T>::tryPush(T item) {
+  size_t pos = tail_;
+  Cell* cell;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    size_t seq = cell->seq;
+    long diff = (long)seq - (long)pos;
+    if (diff == 0) {
+      // The cell is free at 'pos'. Claim the position.
+      size_t prev = __sync_val_compare_and_swap(&tail_, pos, pos + 1);
+      if (prev == pos) {
+        break;
+      }
+      pos = prev;
+    } else if (diff < 0) {
+      // The cell still holds the item pushed one lap ago.
+      return false;
+    } else {
+      // Another producer got 'pos' first.
+      pos = tail_;
+    }
+  }
+
+  cell->item = item;
+  // The item must be visible before the cell is marked readable.
+  __sync_synchronize();
+  cell->seq = pos + 1;
+  return true;
+}
+
+template<typename T>
+bool MPMCQueue<T>::tryPop(T* item) {
+  size_t pos = head_;
+  Cell* cell;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    size_t seq = cell->seq;
+    long diff = (long)seq - (long)(pos + 1);
+    if (diff == 0) {
+      size_t prev = __sync_val_compare_and_swap(&head_, pos, pos + 1);
+      if (prev == pos) {
+        break;
+      }
+      pos = prev;
+    } else if (diff < 0) {
+      // Nothing was pushed at 'pos' yet.
+      return false;
+    } else {
+      pos = head_;
+    }
+  }
+
+  *item = cell->item;
+  // Read the item before handing the cell to the producer one lap
+  // ahead.
+  __sync_synchronize();
+  cell->seq = pos + mask_ + 1;
+  return true;
+}
+
+template<typename T>
+size_t MPMCQueue<T>::size() const {
+  size_t head = head_;
+  size_t tail = tail_;
+  return (tail > head) ? tail - head : 0;
+}
+
+template<typename T>
+size_t MPMCQueue<T>::roundUp(size_t capacity) {
+  size_t res = 2;
+  while (res < capacity) {
+    res <<= 1;
+  }
+  return res;
+}
+
+} // namespace base
+
+#endif // MCP_BASE_MPMC_QUEUE_HEADER
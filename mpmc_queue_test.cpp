@@ -0,0 +1,138 @@
+#include <pthread.h>
+#include <vector>
+
+#include "callback.hpp"
+#include "mpmc_queue.hpp"
+#include "test_unit.hpp"
+#include "thread.hpp"
+
+namespace {
+
+using base::makeCallableOnce;
+using base::makeThread;
+using base::MPMCQueue;
+using std::vector;
+
+typedef MPMCQueue<long> Queue;
+
+const long kItemsPerProducer = 100000;
+
+struct Producer {
+  Producer(Queue* queue, long first) : queue_(queue), first_(first) { }
+
+  void run() {
+    for (long i = first_; i < first_ + kItemsPerProducer; i++) {
+      while (! queue_->tryPush(i)) { }
+    }
+  }
+
+  Queue* queue_;
+  long   first_;
+};
+
+struct Consumer {
+  Consumer(Queue* queue, long expected, volatile long* popped)
+    : queue_(queue), expected_(expected), popped_(popped), sum(0) { }
+
+  void run() {
+    long item;
+    while (*popped_ < expected_) {
+      if (queue_->tryPop(&item)) {
+        sum += item;
+        __sync_fetch_and_add(popped_, 1);
+      }
+    }
+  }
+
+  Queue*         queue_;
+  long           expected_;
+  volatile long* popped_;
+  long           sum;
+};
+
+//
+// Test Cases
+//
+
+TEST(Basics, FIFO) {
+  Queue queue(4);
+  long item = 0;
+
+  EXPECT_EQ(queue.capacity(), 4u);
+  EXPECT_FALSE(queue.tryPop(&item));
+  for (long i = 0; i < 4; i++) {
+    EXPECT_TRUE(queue.tryPush(i));
+  }
+  EXPECT_EQ(queue.size(), 4u);
+  for (long i = 0; i < 4; i++) {
+    EXPECT_TRUE(queue.tryPop(&item));
+    EXPECT_EQ(item, i);
+  }
+  EXPECT_FALSE(queue.tryPop(&item));
+  EXPECT_EQ(queue.size(), 0u);
+}
+
+TEST(Basics, Full) {
+  Queue queue(3);  // rounded up to 4
+  long item = 0;
+
+  EXPECT_EQ(queue.capacity(), 4u);
+  // Go around the ring a few times.
+  for (long lap = 0; lap < 3; lap++) {
+    for (long i = 0; i < 4; i++) {
+      EXPECT_TRUE(queue.tryPush(i));
+    }
+    EXPECT_FALSE(queue.tryPush(4));
+    EXPECT_TRUE(queue.tryPop(&item));
+    EXPECT_EQ(item, 0);
+    EXPECT_TRUE(queue.tryPush(4));
+    for (long i = 1; i <= 4; i++) {
+      EXPECT_TRUE(queue.tryPop(&item));
+      EXPECT_EQ(item, i);
+    }
+  }
+}
+
+TEST(Concurrency, ProducersAndConsumers) {
+  const int num_producers = 3;
+  const int num_consumers = 3;
+  const long total = num_producers * kItemsPerProducer;
+  Queue queue(64);
+  volatile long popped = 0;
+
+  vector<Producer*> producers;
+  vector<Consumer*> consumers;
+  vector<pthread_t> tids;
+  for (int i = 0; i < num_consumers; i++) {
+    consumers.push_back(new Consumer(&queue, total, &popped));
+    tids.push_back(makeThread(makeCallableOnce(&Consumer::run,
+                                               consumers[i])));
+  }
+  for (int i = 0; i < num_producers; i++) {
+    producers.push_back(new Producer(&queue, i * kItemsPerProducer));
+    tids.push_back(makeThread(makeCallableOnce(&Producer::run,
+                                               producers[i])));
+  }
+  for (size_t i = 0; i < tids.size(); i++) {
+    pthread_join(tids[i], NULL);
+  }
+
+  // Every item popped exactly once adds up to 0 + 1 + ... + total-1.
+  long sum = 0;
+  for (int i = 0; i < num_consumers; i++) {
+    sum += consumers[i]->sum;
+    delete consumers[i];
+  }
+  for (int i = 0; i < num_producers; i++) {
+    delete producers[i];
+  }
+  EXPECT_EQ(popped, total);
+  EXPECT_EQ(sum, total * (total - 1) / 2);
+  EXPECT_EQ(queue.size(), 0u);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  return RUN_TESTS(argc, argv);
+}
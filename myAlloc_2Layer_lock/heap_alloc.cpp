@@ -4,49 +4,147 @@
 // calling, but without freeing
 //
 #include <cassert>
+#include <fcntl.h>
+#include <linux/mempolicy.h>  // MPOL_PREFERRED
+#include <new>                // placement new
+#include <sched.h>            // sched_getcpu, sched_yield
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include "heap_alloc.hpp"
+#include "raw_write.hpp"
 
 namespace myalloc {
 
-Allocator Allocator::TheAllocator;
+// Zero-initialized storage for the only Allocator, built in place by
+// initializeOnce(). No static constructor ever runs over it.
+static union {
+  char bytes[sizeof(Allocator)];
+  long double align;
+} allocator_storage;
+
+Allocator* const Allocator::TheAllocator =
+  reinterpret_cast<Allocator*>(&allocator_storage);
+int Allocator::_initState = Allocator::INITNONE;
+
+// The thread cache bound to each thread. initial-exec TLS is a plain
+// %fs-relative load; the default model for a shared library may call
+// __tls_get_addr, which can itself malloc.
+static __thread ThreadCache* thread_cache
+  __attribute__((tls_model("initial-exec"))) = NULL;
+
+// Set while a thread runs the pressure handler, so that allocations
+// done by the handler itself do not report pressure again.
+static __thread int in_pressure_handler = 0;
+
+// Node a thread was assigned to, when nodes are simulated.
+static __thread int simulated_node = -1;
+
+// Which of a node's caches a thread uses, handed out round-robin.
+// (pthread_self() values are page aligned: no good as a hash.)
+static __thread int cache_slot = -1;
 
 extern "C" void atExitHandlerInC() {
-  Allocator::TheAllocator.atExitHandler();
-  Allocator::TheAllocator.getThrCaches(0)->atExitHandler();
+  Allocator::ensureInitialized();
+  Allocator::TheAllocator->atExitHandler();
+  Allocator::TheAllocator->getThrCaches(0)->atExitHandler();
+}
+
+// Build the allocator when the library is loaded, if no malloc() did
+// it already, and print statistics / dump the profile at exit. Unlike
+// atexit(), neither may allocate.
+__attribute__((constructor))
+static void initializeAtLoad() {
+  Allocator::ensureInitialized();
+}
+
+__attribute__((destructor))
+static void finalizeAtExit() {
+  atExitHandlerInC();
+}
+
+void Allocator::initializeOnce() {
+  if (__sync_bool_compare_and_swap(&_initState, INITNONE, INITRUNNING)) {
+    new (TheAllocator) Allocator;
+    TheAllocator->initialize();
+    __sync_synchronize();
+    _initState = INITDONE;
+  } else {
+    // Somebody else is building it. initialize() doesn't allocate, so
+    // this can't be ourselves.
+    while (*(volatile int*)&_initState != INITDONE)
+      sched_yield();
+  }
+}
+
+ThreadCache* Allocator::threadCache() {
+  if (thread_cache == NULL)
+    thread_cache = threadCache(currentNode());
+  return thread_cache;
+}
+
+ThreadCache* Allocator::threadCache(int node) {
+  if (cache_slot < 0)
+    cache_slot = __sync_fetch_and_add(&_nextCacheSlot, 1) % _cachesPerNode;
+  return getThrCaches(node * _cachesPerNode + cache_slot);
 }
 
 void Allocator::initialize() {
   // Environment var VERBOSE prints stats at end and turns on debugging
   // Default is on
-  printf("????Allocator INIT Called????");
   _verbose = 1;
   const char * envverbose = getenv("MALLOCVERBOSE");
   if (envverbose && !strcmp( envverbose, "NO")) {
     _verbose = 0;
   }
 
-  // In verbose mode register also printing statistics at exit
-  atexit(atExitHandlerInC);
-  for (int i = 0; i < NUMOFSIZECLASSES; ++i)
-    freels_[i] = NULL;
+  // Profiling mode records requested sizes and object lifetimes
+  _profilePath = getenv("MALLOCPROFILE");
+  _profiling = (_profilePath != NULL && _profilePath[0] != '\0');
+
+  // Huge page arenas replace sbrk()
+  const char* envhuge = getenv("MALLOCHUGEPAGES");
+  _useHugePages = (envhuge != NULL && envhuge[0] != '\0' &&
+                   strcmp(envhuge, "NO") != 0);
+
+  for (int n = 0; n < MAXNUMANODES; ++n) {
+    for (int i = 0; i < NUMOFSIZECLASSES; ++i)
+      _nodes[n].freels_[i] = NULL;
+    _nodes[n]._heapSize = 0;
+    _nodes[n]._hugeCur[0] = _nodes[n]._hugeCur[1] = -1;
+    _nodes[n]._hugeOff[0] = _nodes[n]._hugeOff[1] = 0;
+    _nodes[n]._hugeSpare = -1;
+  }
+  for (int i = 0; i < MAXHUGEPAGES; ++i) {
+    _hugePages[i].base = 0;
+    _hugePages[i].len = 0;
+  }
+  initTopology();
 
-  // _initialized = 1;  // Already set by CAS instruction
   _heapSize = 0;
   _mallocCalls = 0;
   _freeCalls = 0;
   _reallocCalls = 0;
   _callocCalls = 0;
+  _softLimit = 0;
+  _hardLimit = 0;
+  _pressureBytes = 0;
+  _pressureHandler = NULL;
 
+  // Any caches left over by the split go to the last node
+  _cachesPerNode = NUMOFTHREADCACHES / _numNodes;
+  _nextCacheSlot = 0;
   for (int i = 0; i < NUMOFTHREADCACHES; ++i) {
+    int node = i / _cachesPerNode;
     _thr_caches[i].setCentralHeap(this);
+    _thr_caches[i].setNode(node < _numNodes ? node : _numNodes - 1);
+    _thr_caches[i].initialize();
   }
 }
 
-void* Allocator::allocateObject(size_t size) {
+void* Allocator::allocateObject(size_t size, bool forCache, int node) {
   if (!size)  // size == 0, don't allocate
     return NULL;
 
@@ -56,6 +154,9 @@ void* Allocator::allocateObject(size_t size) {
       - 1) & ~(BASICALLOCSIZE - 1);
   // Min = 48, has to have space to fill in "DualLnkNode"
   totalSize = (totalSize < 48)? 48 : totalSize;
+  // Spans larger than a huge page take whole huge pages
+  if (_useHugePages && totalSize > HUGEPAGESIZE)
+    totalSize = (totalSize + HUGEPAGESIZE - 1) & ~(HUGEPAGESIZE - 1);
   assert(totalSize % BASICALLOCSIZE == 0);
 
   // You should get memory from the OS only if the memory in the free
@@ -64,14 +165,17 @@ void* Allocator::allocateObject(size_t size) {
   size_t index = (totalSize / BASICALLOCSIZE > NUMOFSIZECLASSES -1)?
     (NUMOFSIZECLASSES - 1) : (totalSize / BASICALLOCSIZE);
 
-  // Lock the shared doubly-linked-list-of-lists heap:
-  _m.lock();
+  // Lock the doubly-linked-list-of-lists heap of the node:
+  if (node < 0)
+    node = currentNode();
+  NodeHeap* heap = &_nodes[node];
+  heap->_m.lock();
 
-  if (freels_[index++] != NULL) {
+  if (heap->freels_[index++] != NULL) {
     // if 0 <= index <= 63, "mem" won't be NULL, since
     // freels_[index] != NULL
-    mem = static_cast<void*>(rmFromFreeLs(totalSize / BASICALLOCSIZE,
-          totalSize));
+    mem = static_cast<void*>(rmFromFreeLs(node,
+          totalSize / BASICALLOCSIZE, totalSize));
     if (mem != NULL) {  // suitable size free node found
       mem = (void*)((unsigned char*)mem - sizeof(ObjHeader));
       // If the actual size for 'mem' is larger than totalSize, reassign
@@ -79,18 +183,19 @@ void* Allocator::allocateObject(size_t size) {
         totalSize = ((ObjHeader*)mem)->_objectSize;
       }
     } else {  // requesting > 64 * 4k bytes, not suitable free node exist
-      mem = getMemoryFromOS(totalSize);
+      mem = getMemoryFromOS(totalSize, node, forCache);
     }
   } else {  // Search for larger free-lists in "freels_[]"
     while (index < NUMOFSIZECLASSES) {  // search for larger slots
-      if (freels_[index] != NULL)
+      if (heap->freels_[index] != NULL)
         break;
       ++index;
     }
     if (index == NUMOFSIZECLASSES)
-      mem = getMemoryFromOS(totalSize);
+      mem = getMemoryFromOS(totalSize, node, forCache);
     else {  // Split larger free slot
-      DualLnkNode* toSplit = rmFromFreeLs(index, index * BASICALLOCSIZE);
+      DualLnkNode* toSplit = rmFromFreeLs(node, index,
+          index * BASICALLOCSIZE);
       size_t realSize = ((ObjHeader*)((unsigned char*)toSplit -
             sizeof(ObjHeader)))->_objectSize;
       if (realSize >= (totalSize + sizeof(DualLnkNode) +
@@ -101,12 +206,14 @@ void* Allocator::allocateObject(size_t size) {
             totalSize - sizeof(ObjHeader));
         splitobj->_objectSize = realSize - totalSize;  // may > sizeclass
         splitobj->_flags = ObjFree;
+        splitobj->_node = node;
         splitobj = (ObjHeader*)((unsigned char*)toSplit + realSize
           - 2 * sizeof(ObjHeader));  // Now, pointing to footer
         splitobj->_objectSize = realSize - totalSize;  // may > sizeclass
         splitobj->_flags = ObjFree;
+        splitobj->_node = node;
         assert(insertFreeBlock((DualLnkNode*)((unsigned char*)toSplit +
-          totalSize), newclass));
+          totalSize), node, newclass));
         mem = (void*)((unsigned char*)toSplit - sizeof(ObjHeader));
       } else {  // Cannot split
         totalSize = realSize;  // Gave a larger free-node back
@@ -114,7 +221,12 @@ void* Allocator::allocateObject(size_t size) {
       }
     }
   }
-  _m.unlock();
+  if (_useHugePages) {
+    int page = findHugePage(mem);
+    if (page >= 0)
+      _hugePages[page].live += totalSize;
+  }
+  heap->_m.unlock();
 
   // Get a pointer to the object header ????? didn't change footer
   ObjHeader* obj = static_cast<ObjHeader*>(mem);
@@ -122,10 +234,14 @@ void* Allocator::allocateObject(size_t size) {
   obj->_objectSize = totalSize;
   // Set object as allocated
   obj->_flags = ObjAllocated;
+  obj->_node = node;
+  if (_profiling)
+    obj->_stamp = SizeProfile::now();
   // "obj" now points to the Footer, set footer values
   obj = (ObjHeader*)((unsigned char*)obj + totalSize - sizeof(ObjHeader));
   obj->_objectSize = totalSize;
   obj->_flags = ObjAllocated;
+  obj->_node = node;
   // "obj" repoints to the header
   obj = (ObjHeader*)((unsigned char*)obj - totalSize + sizeof(ObjHeader));
 
@@ -140,11 +256,22 @@ void Allocator::freeObject(void* ptr) {
       sizeof(ObjHeader));
   size_t totalSize = obj->_objectSize;
 
-  _m.lock();
+  if (_profiling) {
+    _m.lock();
+    _profile.recordFree(obj->_stamp, SizeProfile::now());
+    _m.unlock();
+  }
+
+  // Back to the heap of the node it came from, whoever frees it
+  int node = obj->_node;
+  if (node < 0 || node >= _numNodes)
+    node = 0;
+  NodeHeap* heap = &_nodes[node];
+  heap->_m.lock();
   // No space to put it into free-list (min: 48 bytes)
   if (totalSize < (sizeof(DualLnkNode) + 2 * sizeof(ObjHeader))) { 
-    _m.unlock();
-    puts("Free without gettting back-------------");
+    heap->_m.unlock();
+    rawWrite(STDOUT_FILENO, "Free without gettting back-------------\n");
     return;
   } else {
     obj->_flags = ObjFree;
@@ -152,8 +279,19 @@ void Allocator::freeObject(void* ptr) {
     obj = (ObjHeader*)((unsigned char*)obj+totalSize - sizeof(ObjHeader));
     obj->_flags = ObjFree;  // Set footer flag to freed
     // "obj" still points to the footer now
-    assert(insertFreeBlock((DualLnkNode*)ptr, (totalSize / BASICALLOCSIZE)));
-    _m.unlock();
+    assert(insertFreeBlock((DualLnkNode*)ptr, node,
+          (totalSize / BASICALLOCSIZE)));
+    if (_useHugePages && totalSize % BASICALLOCSIZE == 0) {
+      // Give the huge page back once nothing in it is used anymore,
+      // unless we're still carving spans out of it. Central heap spans
+      // are whole pages; anything else is a thread cache object that
+      // free() routed here, and was never counted as live.
+      int page = findHugePage(ptr);
+      if (page >= 0 && (_hugePages[page].live -= totalSize) == 0 &&
+          heap->_hugeCur[0] != page && heap->_hugeCur[1] != page)
+        releaseHugePage(page);
+    }
+    heap->_m.unlock();
   }
 }
 
@@ -169,28 +307,389 @@ size_t Allocator::objectSize(void* ptr) {
 }
 
 void Allocator::print() {
-  printf("-------------------\n");
-  printf("# mallocs:\t%d\n", _mallocCalls );
-  printf("# reallocs:\t%d\n", _reallocCalls );
-  printf("# callocs:\t%d\n", _callocCalls );
-  printf("# frees:\t%d\n", _freeCalls );
+  const int out = STDOUT_FILENO;
+  // The thread caches count the calls they serve
+  int mallocCalls = _mallocCalls;
+  int freeCalls = _freeCalls;
+  for (int i = 0; i < NUMOFTHREADCACHES; ++i) {
+    mallocCalls += _thr_caches[i].mallocCalls();
+    freeCalls += _thr_caches[i].freeCalls();
+  }
+  rawWrite(out, "-------------------\n");
+  rawWrite(out, "# mallocs:\t");
+  rawWriteNum(out, mallocCalls);
+  rawWrite(out, "\n# reallocs:\t");
+  rawWriteNum(out, _reallocCalls);
+  rawWrite(out, "\n# callocs:\t");
+  rawWriteNum(out, _callocCalls);
+  rawWrite(out, "\n# frees:\t");
+  rawWriteNum(out, freeCalls);
+  rawWrite(out, "\n");
   size_t sumfreelssize = sumFreeListSize();
   for (int i = 0; i < NUMOFTHREADCACHES; ++i) {
     if (_thr_caches[i].isInitialized()) {
       sumfreelssize += _thr_caches[i].sumFreeListSize();
     }
   }
-  printf("HeapSize: %10lu  sumFreeLsSize: %10lu   (Equal? %c)\n",
-      _heapSize, sumfreelssize, ((_heapSize == sumfreelssize)? 'Y':'N'));
+  rawWrite(out, "HeapSize: ");
+  rawWriteNum(out, _heapSize, 10);
+  rawWrite(out, "  sumFreeLsSize: ");
+  rawWriteNum(out, sumfreelssize, 10);
+  rawWrite(out, (_heapSize == sumfreelssize) ? "   (Equal? Y)\n"
+                                             : "   (Equal? N)\n");
+  if (_numNodes > 1) {
+    for (int n = 0; n < _numNodes; ++n) {
+      rawWrite(out, "Node ");
+      rawWriteNum(out, n);
+      rawWrite(out, " HeapSize: ");
+      rawWriteNum(out, _nodes[n]._heapSize, 10);
+      rawWrite(out, "\n");
+    }
+  }
 
-  printf("-------------------\n");
+  rawWrite(out, "-------------------\n");
 }
 
-void* Allocator::getMemoryFromOS(size_t size) {
-  // Use sbrk() to get memory from OS
+void* Allocator::getMemoryFromOS(size_t size, int node, bool forCache) {
+  // Called with the lock of 'node' held. sbrk() and the huge page
+  // table are shared by all nodes, so _m serializes them.
+  _m.lock();
+  size_t oldHeapSize = _heapSize;
   _heapSize += size;
-  
-  return sbrk(size);
+
+  void* mem = NULL;
+  if (_useHugePages)
+    mem = carveHugeSpan(size, node, forCache);
+  if (mem == NULL) {
+    // Use sbrk() to get memory from OS
+    mem = sbrk(size);
+    bindToNode(mem, size, node);
+  }
+
+  // The handler can't run here (it will free, and likely malloc), so
+  // just note how much we'd like back and let checkPressure() report
+  // it once the lock is released. Carving may have added the tail of
+  // a huge page to the heap too.
+  if (_softLimit != 0 && _heapSize > _softLimit) {
+    size_t over;
+    if (_hardLimit != 0 && _heapSize > _hardLimit) {
+      over = _heapSize - _softLimit;
+    } else if (oldHeapSize > _softLimit) {
+      over = _heapSize - oldHeapSize;
+    } else {
+      over = _heapSize - _softLimit;
+    }
+    __sync_add_and_fetch(&_pressureBytes, over);
+  }
+  _m.unlock();
+
+  _nodes[node]._heapSize += size;
+  return mem;
+}
+
+// Huge page arenas. Called with _m and the lock of 'node' held.
+// Returns NULL if no huge page could be mapped.
+void* Allocator::carveHugeSpan(size_t size, int node, bool forCache) {
+  NodeHeap* heap = &_nodes[node];
+  if (size > HUGEPAGESIZE) {
+    // A run of huge pages of its own, already rounded up by the caller
+    int page = mapHugePages(size, node, 1);
+    return (page < 0) ? NULL : (void*)_hugePages[page].base;
+  }
+
+  const int group = forCache ? 0 : 1;
+  int page = heap->_hugeCur[group];
+  size_t off = heap->_hugeOff[group];
+  if (page < 0 || off + size > HUGEPAGESIZE) {
+    if (page >= 0 && off < HUGEPAGESIZE) {
+      // The rest of the page doesn't fit 'size'. It goes to the free
+      // lists rather than have the span straddle two huge pages.
+      size_t rest = HUGEPAGESIZE - off;
+      ObjHeader* obj = (ObjHeader*)(_hugePages[page].base + off);
+      obj->_objectSize = rest;
+      obj->_flags = ObjFree;
+      obj->_node = node;
+      obj = (ObjHeader*)((unsigned char*)obj + rest - sizeof(ObjHeader));
+      obj->_objectSize = rest;
+      obj->_flags = ObjFree;
+      obj->_node = node;
+      insertFreeBlock((DualLnkNode*)(_hugePages[page].base + off +
+          sizeof(ObjHeader)), node, rest / BASICALLOCSIZE);
+      _heapSize += rest;
+      heap->_heapSize += rest;
+    }
+    page = newHugePage(node);
+    if (page < 0)
+      return NULL;
+    heap->_hugeCur[group] = page;
+    off = 0;
+  }
+  heap->_hugeOff[group] = off + size;
+  return (void*)(_hugePages[page].base + off);
+}
+
+// Returns an empty huge page for 'node', reserving a new arena if the
+// node has no spare page.
+int Allocator::newHugePage(int node) {
+  NodeHeap* heap = &_nodes[node];
+  if (heap->_hugeSpare < 0) {
+    int first = mapHugePages(HUGEPAGESIZE * HUGEARENAPAGES, node,
+        HUGEARENAPAGES);
+    if (first < 0)
+      return -1;
+  }
+  int page = heap->_hugeSpare;
+  heap->_hugeSpare = _hugePages[page].next;
+  return page;
+}
+
+// Maps 'len' bytes aligned to a huge page and registers them as
+// 'npages' pages (1 for a big span). Pages of an arena go to the spare
+// list of 'node'. Returns the first page, or -1.
+int Allocator::mapHugePages(size_t len, int node, int npages) {
+  // Over-map by a huge page, then trim to get the alignment
+  size_t maplen = len + HUGEPAGESIZE;
+  void* res = mmap(NULL, maplen, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (res == MAP_FAILED)
+    return -1;
+  unsigned long start = (unsigned long)res;
+  unsigned long base = (start + HUGEPAGESIZE - 1) & ~(HUGEPAGESIZE - 1);
+  if (base > start)
+    munmap(res, base - start);
+  if (start + maplen > base + len)
+    munmap((void*)(base + len), start + maplen - (base + len));
+  madvise((void*)base, len, MADV_HUGEPAGE);
+  bindToNode((void*)base, len, node);
+
+  size_t pagelen = len / npages;
+  int first = -1;
+  for (int i = npages - 1; i >= 0; --i) {
+    int page = registerHugePage(base + i * pagelen, pagelen, node);
+    if (page < 0) {
+      // Table full. Whatever was registered is still usable.
+      munmap((void*)base, (i + 1) * pagelen);
+      return first;
+    }
+    if (npages > 1) {
+      _hugePages[page].next = _nodes[node]._hugeSpare;
+      _nodes[node]._hugeSpare = page;
+    }
+    first = page;
+  }
+  return first;
+}
+
+int Allocator::registerHugePage(unsigned long base, size_t len, int node) {
+  // Take the first dead slot (an unmapped span's) on our probe path, or
+  // else the empty slot that ends it. Lookups walk past dead slots, so
+  // reusing one doesn't hide what follows it.
+  int slot = (base / HUGEPAGESIZE) & (MAXHUGEPAGES - 1);
+  int found = -1;
+  for (int i = 0; i < MAXHUGEPAGES; ++i) {
+    HugePage* hp = &_hugePages[slot];
+    if (hp->base == 0) {
+      if (found < 0)
+        found = slot;
+      break;
+    }
+    if (hp->len == 0 && found < 0)
+      found = slot;
+    slot = (slot + 1) & (MAXHUGEPAGES - 1);
+  }
+  if (found < 0)
+    return -1;
+
+  // The slot's len is 0, so lookups skip it until it is filled in
+  HugePage* hp = &_hugePages[found];
+  hp->base = base;
+  hp->live = 0;
+  hp->node = node;
+  hp->next = -1;
+  // Lookups run without _m; publish the length last.
+  __sync_synchronize();
+  hp->len = len;
+  return found;
+}
+
+int Allocator::findHugePage(const void* addr) const {
+  unsigned long base = (unsigned long)addr & ~(HUGEPAGESIZE - 1);
+  int slot = (base / HUGEPAGESIZE) & (MAXHUGEPAGES - 1);
+  for (int i = 0; i < MAXHUGEPAGES; ++i) {
+    const HugePage* hp = &_hugePages[slot];
+    if (hp->base == 0)
+      return -1;
+    if (hp->base == base && hp->len != 0)
+      return slot;
+    // Dead slots (len 0) may sit anywhere on the probe path
+    slot = (slot + 1) & (MAXHUGEPAGES - 1);
+  }
+  return -1;
+}
+
+// Called with the lock of the page's node held, when no byte of the
+// page is allocated: everything in it sits in the free lists. Blocks
+// are never merged and spans don't straddle pages, so the page is
+// tiled by free blocks; walk their headers to unlink them.
+void Allocator::releaseHugePage(int page) {
+  HugePage* hp = &_hugePages[page];
+  NodeHeap* heap = &_nodes[hp->node];
+  unsigned long end = hp->base + hp->len;
+  unsigned long addr = hp->base;
+  while (addr < end) {
+    ObjHeader* obj = (ObjHeader*)addr;
+    size_t size = obj->_objectSize;
+    assert(obj->_flags == ObjFree && size > 0 && addr + size <= end);
+    DualLnkNode* block = (DualLnkNode*)(addr + sizeof(ObjHeader));
+    if (block->prev_) {
+      block->prev_->next_ = block->next_;
+    } else {
+      size_t pos = size / BASICALLOCSIZE;
+      if (pos > NUMOFSIZECLASSES - 1)
+        pos = NUMOFSIZECLASSES - 1;
+      assert(heap->freels_[pos] == block);
+      heap->freels_[pos] = block->next_;
+    }
+    if (block->next_)
+      block->next_->prev_ = block->prev_;
+    addr += size;
+  }
+
+  _m.lock();
+  _heapSize -= hp->len;
+  // Don't ask the handler for more than what is still over the limit
+  size_t over = (_softLimit != 0 && _heapSize > _softLimit) ?
+    _heapSize - _softLimit : 0;
+  size_t pending = _pressureBytes;
+  while (pending > over &&
+         !__sync_bool_compare_and_swap(&_pressureBytes, pending, over))
+    pending = _pressureBytes;
+  _m.unlock();
+  heap->_heapSize -= hp->len;
+
+  if (hp->len > HUGEPAGESIZE) {
+    // Big span: unmap it, the slot may be reused for another base
+    munmap((void*)hp->base, hp->len);
+    hp->len = 0;
+  } else {
+    // Keep the (now empty) mapping around for the next arena page
+    madvise((void*)hp->base, hp->len, MADV_DONTNEED);
+    hp->next = heap->_hugeSpare;
+    heap->_hugeSpare = page;
+  }
+}
+
+// Reads at most 'len' - 1 bytes of 'path' into 'buf'. We can't use
+// stdio here: it would call malloc().
+static int readSmallFile(const char* path, char* buf, int len) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  int bytes = read(fd, buf, len - 1);
+  close(fd);
+  if (bytes < 0)
+    return -1;
+  buf[bytes] = '\0';
+  return bytes;
+}
+
+// Parses a cpu list such as "0-3,8-11" and maps those cpus to 'node'.
+static void parseCpuList(const char* list, int16_t node, int16_t* cpuNode) {
+  const char* p = list;
+  while (*p >= '0' && *p <= '9') {
+    int first = strtol(p, const_cast<char**>(&p), 10);
+    int last = first;
+    if (*p == '-')
+      last = strtol(p + 1, const_cast<char**>(&p), 10);
+    for (int cpu = first; cpu <= last && cpu < MAXNUMCPUS; ++cpu)
+      cpuNode[cpu] = node;
+    if (*p == ',')
+      ++p;
+  }
+}
+
+void Allocator::initTopology() {
+  for (int cpu = 0; cpu < MAXNUMCPUS; ++cpu)
+    _cpuNode[cpu] = 0;
+  _numNodes = 1;
+  _simulatedNodes = false;
+  _nextNode = 0;
+
+  const char* envnodes = getenv("MALLOCNUMANODES");
+  if (envnodes && atoi(envnodes) > 0) {
+    _numNodes = atoi(envnodes);
+    if (_numNodes > MAXNUMANODES)
+      _numNodes = MAXNUMANODES;
+    _simulatedNodes = true;
+    return;
+  }
+
+  // /sys/devices/system/node/node<n>/cpulist, for n = 0, 1, ...
+  char path[64] = "/sys/devices/system/node/node";
+  const int prefix = strlen(path);
+  char cpulist[512];
+  for (int n = 0; n < MAXNUMANODES; ++n) {
+    // n has a single digit (MAXNUMANODES <= 10)
+    path[prefix] = '0' + n;
+    strcpy(path + prefix + 1, "/cpulist");
+    if (readSmallFile(path, cpulist, sizeof(cpulist)) < 0)
+      break;
+    parseCpuList(cpulist, n, _cpuNode);
+    _numNodes = n + 1;
+  }
+}
+
+int Allocator::currentNode() {
+  if (_numNodes == 1)
+    return 0;
+  if (_simulatedNodes) {
+    if (simulated_node < 0) {
+      simulated_node = __sync_fetch_and_add(&_nextNode, 1) % _numNodes;
+    }
+    return simulated_node;
+  }
+  int cpu = sched_getcpu();
+  if (cpu < 0 || cpu >= MAXNUMCPUS)
+    return 0;
+  return _cpuNode[cpu];
+}
+
+void Allocator::bindToNode(void* mem, size_t size, int node) {
+  // Nothing to bind to when nodes are simulated. The memory comes
+  // from sbrk() in multiples of pages, so it is page aligned unless
+  // the break started unaligned; then first-touch placement (by the
+  // allocating thread, which writes the header) has to do.
+  if (_numNodes == 1 || _simulatedNodes)
+    return;
+  if (((unsigned long)mem & (BASICALLOCSIZE - 1)) != 0)
+    return;
+  unsigned long mask = 1UL << node;
+  syscall(SYS_mbind, mem, size, MPOL_PREFERRED, &mask, MAXNUMANODES + 1, 0);
+}
+
+void Allocator::setMemoryLimits(size_t soft, size_t hard) {
+  // Read under _m by getMemoryFromOS()
+  _m.lock();
+  _softLimit = soft;
+  _hardLimit = hard;
+  _m.unlock();
+}
+
+void Allocator::setPressureHandler(PressureHandler handler) {
+  _pressureHandler = handler;
+}
+
+void Allocator::checkPressure() {
+  if (in_pressure_handler)
+    return;
+  size_t bytes = __sync_lock_test_and_set(&_pressureBytes, 0);
+  PressureHandler handler = _pressureHandler;
+  if (bytes == 0 || handler == NULL)
+    return;
+
+  in_pressure_handler = 1;
+  (*handler)(bytes);
+  in_pressure_handler = 0;
 }
 
 void Allocator::atExitHandler() {
@@ -199,21 +698,56 @@ void Allocator::atExitHandler() {
     print();
     checkALL();
   }
+  if (_profiling) {
+    dumpProfile(_profilePath);
+  }
+}
+
+void Allocator::recordAlloc(size_t size) {
+  _m.lock();
+  _profile.recordAlloc(size);
+  _m.unlock();
+}
+
+bool Allocator::dumpProfile(const char* path) {
+  // The merged profile is big (~17KB), keep it off the caller's stack.
+  SizeProfile& total = _dumpTotal;
+  _dumpMutex.lock();
+
+  total.clear();
+  _m.lock();
+  _profile.mergeInto(&total);
+  _m.unlock();
+  for (int i = 0; i < NUMOFTHREADCACHES; ++i) {
+    if (_thr_caches[i].isInitialized()) {
+      _thr_caches[i].mergeProfile(&total);
+    }
+  }
+
+  bool res = false;
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0) {
+    res = total.dump(fd);
+    close(fd);
+  }
+  _dumpMutex.unlock();
+  return res;
 }
 
 // Free-list manipulation methods
-bool Allocator::insertFreeBlock(DualLnkNode* toinsert, int pos) {
+bool Allocator::insertFreeBlock(DualLnkNode* toinsert, int node, int pos) {
+  DualLnkNode** freels = _nodes[node].freels_;
   // Check boundary
   if (pos < 0)
     return false;
   if (pos > NUMOFSIZECLASSES - 1)
     pos = NUMOFSIZECLASSES - 1;
 
-  if ((pos == NUMOFSIZECLASSES - 1) && (freels_[pos] != NULL)) {
+  if ((pos == NUMOFSIZECLASSES - 1) && (freels[pos] != NULL)) {
     // Special case, >= 64 * 4k bytes, put them in non-decreasing order
     size_t toinsertSize = ((ObjHeader*)((unsigned char*)toinsert -
         sizeof(ObjHeader)))->_objectSize;
-    DualLnkNode* iter = freels_[pos];
+    DualLnkNode* iter = freels[pos];
     DualLnkNode* preiter = NULL;
     while (iter != NULL) {
       if (((ObjHeader*)((unsigned char*)iter -
@@ -228,7 +762,7 @@ bool Allocator::insertFreeBlock(DualLnkNode* toinsert, int pos) {
       toinsert->prev_ = preiter;
       toinsert->next_ = NULL;
     } else if (preiter == NULL) {  // Insert into the front of the list
-      freels_[pos] = toinsert;
+      freels[pos] = toinsert;
       toinsert->next_ = iter;
       toinsert->prev_ = NULL;
       iter->prev_ = toinsert;
@@ -240,28 +774,30 @@ bool Allocator::insertFreeBlock(DualLnkNode* toinsert, int pos) {
     }
     return true;
   } else {  // Insert at the front of the double-linked list
-    DualLnkNode* tmpnext = freels_[pos];
+    DualLnkNode* tmpnext = freels[pos];
     toinsert->next_ = tmpnext;
     if (tmpnext)
       tmpnext->prev_ = toinsert;
     toinsert->prev_ = NULL;
-    freels_[pos] = toinsert;
+    freels[pos] = toinsert;
 
     return true;
   }
 }
 
-Allocator::DualLnkNode* Allocator::rmFromFreeLs(int pos, size_t totsize) {
+Allocator::DualLnkNode* Allocator::rmFromFreeLs(int node, int pos,
+                                                size_t totsize) {
+  DualLnkNode** freels = _nodes[node].freels_;
   // Check boundary
   if (pos < 0)
     return NULL;
   if (pos > NUMOFSIZECLASSES - 1)
     pos = NUMOFSIZECLASSES - 1;
-  if (freels_[pos] == NULL)
+  if (freels[pos] == NULL)
     return NULL;
 
   if (pos == NUMOFSIZECLASSES - 1) {
-    DualLnkNode* iter = freels_[pos];  // Must exist
+    DualLnkNode* iter = freels[pos];  // Must exist
     // Special case, >= 64 * 4k bytes, list is in non-decreasing order
     while (iter != NULL) {
       if (((ObjHeader*)((unsigned char*)iter -
@@ -272,8 +808,8 @@ Allocator::DualLnkNode* Allocator::rmFromFreeLs(int pos, size_t totsize) {
     if (iter == NULL)
       return NULL;  // Didn't find suitable size
     else {  // Remove iter from this doulbe linked list
-      if (iter == freels_[pos]) {  // Free first node
-        freels_[pos] = iter->next_;
+      if (iter == freels[pos]) {  // Free first node
+        freels[pos] = iter->next_;
         if (iter->next_)
           iter->next_->prev_ = NULL;
         return iter;  // Didn't do splitting, ---- internal fragmentation
@@ -285,8 +821,8 @@ Allocator::DualLnkNode* Allocator::rmFromFreeLs(int pos, size_t totsize) {
       }
     }
   } else {
-    DualLnkNode* firstNode = freels_[pos];  // Must exist
-    freels_[pos] = firstNode->next_;
+    DualLnkNode* firstNode = freels[pos];  // Must exist
+    freels[pos] = firstNode->next_;
     if (firstNode->next_)
       firstNode->next_->prev_ = NULL;
 
@@ -298,24 +834,31 @@ Allocator::DualLnkNode* Allocator::rmFromFreeLs(int pos, size_t totsize) {
 void Allocator::getHeadFootInfo(const DualLnkNode* node) const {
   ObjHeader* obj = (ObjHeader*)((unsigned char*)node - sizeof(ObjHeader));
   size_t objsize = obj->_objectSize;
-  printf("Header: h_size = %lu, h_flag = %d\n", objsize, obj->_flags);
+  rawWrite(STDOUT_FILENO, "Header: h_size = ");
+  rawWriteNum(STDOUT_FILENO, objsize);
+  rawWrite(STDOUT_FILENO, ", h_flag = ");
+  rawWriteNum(STDOUT_FILENO, obj->_flags);
   // Now "obj" points to the footer of this node
   obj = (ObjHeader*)((unsigned char*)node + objsize-2*sizeof(ObjHeader));
-  printf("Footer: f_size = %lu, f_flag = %d\n", obj->_objectSize,
-      obj->_flags);
+  rawWrite(STDOUT_FILENO, "\nFooter: f_size = ");
+  rawWriteNum(STDOUT_FILENO, obj->_objectSize);
+  rawWrite(STDOUT_FILENO, ", f_flag = ");
+  rawWriteNum(STDOUT_FILENO, obj->_flags);
+  rawWrite(STDOUT_FILENO, "\n");
 }
 
-void Allocator::checkFreeLsConsist(int index) const {
+void Allocator::checkFreeLsConsist(int node, int index) const {
   assert(index < NUMOFSIZECLASSES);
 
   size_t classsize = index * BASICALLOCSIZE, totsize = 0;
   size_t prenodesize = 0;
-  DualLnkNode* iter = freels_[index];
+  DualLnkNode* iter = _nodes[node].freels_[index];
   ObjHeader* head, *foot;
 
   while (iter != NULL) {
     head = (ObjHeader*)((unsigned char*)iter - sizeof(ObjHeader));
     assert(head->_flags == ObjFree);
+    assert(head->_node == node);
     totsize = head->_objectSize;
     assert(totsize % BASICALLOCSIZE == 0);
     if (index <= NUMOFSIZECLASSES - 2) {
@@ -334,9 +877,9 @@ void Allocator::checkFreeLsConsist(int index) const {
   }
 }
 
-void Allocator::checkDualLnkList(int index) const {
+void Allocator::checkDualLnkList(int node, int index) const {
   assert(index < NUMOFSIZECLASSES);
-  DualLnkNode* iter = freels_[index], *preiter = NULL;
+  DualLnkNode* iter = _nodes[node].freels_[index], *preiter = NULL;
 
   while (iter != NULL) {
     assert(iter->prev_ == preiter);
@@ -346,20 +889,24 @@ void Allocator::checkDualLnkList(int index) const {
 }
 
 void Allocator::checkALL() const {
-  for (int i = 0; i < NUMOFSIZECLASSES; ++i) {
-    checkFreeLsConsist(i);
-    checkDualLnkList(i);
+  for (int n = 0; n < _numNodes; ++n) {
+    for (int i = 0; i < NUMOFSIZECLASSES; ++i) {
+      checkFreeLsConsist(n, i);
+      checkDualLnkList(n, i);
+    }
   }
 }
 
 size_t Allocator::sumFreeListSize() const {
   size_t sumsize = 0;
   DualLnkNode* iter;
-  for (int i = 0; i < NUMOFSIZECLASSES; ++i) {
-    iter = freels_[i];
-    while (iter != NULL) {
-      sumsize += getFreeNodeSize(iter);
-      iter = iter->next_;
+  for (int n = 0; n < _numNodes; ++n) {
+    for (int i = 0; i < NUMOFSIZECLASSES; ++i) {
+      iter = _nodes[n].freels_[i];
+      while (iter != NULL) {
+        sumsize += getFreeNodeSize(iter);
+        iter = iter->next_;
+      }
     }
   }
   return sumsize;
@@ -371,19 +918,20 @@ size_t Allocator::getFreeNodeSize(const DualLnkNode* node) const {
 }
 
 void* Allocator::assignMalloc(size_t size) {
-  //Make sure that allocator is initialized
-  if (!_initialized) {
-    if (__sync_bool_compare_and_swap(&_initialized, 0, 1))
-      initialize();
-  }
+  ensureInitialized();
   void* ptr;
 
-  int index = pthread_self() % NUMOFTHREADCACHES;
   if (size > CENTHEAPALLOCTHRESHOLD) {  // Alloc directly from cent-heap
+    if (_profiling)
+      recordAlloc(size);
+    if (_verbose)
+      increaseMallocCalls();
     ptr = allocateObject(size);
-  } else {  // Satisfy request from central heap
-    ptr = getThrCaches(index)->allocateObject(size);
+  } else {  // Satisfy request from the thread cache, which counts it
+    ptr = threadCache()->allocateObject(size);
   }
+  if (_pressureBytes != 0)
+    checkPressure();
   return ptr;
 }
 
@@ -393,9 +941,16 @@ void* Allocator::assignMalloc(size_t size) {
 
 extern "C" void* malloc(size_t size) {
   assert(size > 0);
-  void* ptr = Allocator::TheAllocator.assignMalloc(size);
-  Allocator::TheAllocator.increaseMallocCalls();
-  return ptr;
+  // Fast path: a thread that has a cache is past initialization.
+  ThreadCache* cache = thread_cache;
+  Allocator* allocator = Allocator::TheAllocator;
+  if (__builtin_expect(cache != NULL && size <= CENTHEAPALLOCTHRESHOLD, 1)) {
+    void* ptr = cache->allocateObject(size);
+    if (__builtin_expect(allocator->hasPressure(), 0))
+      allocator->checkPressure();
+    return ptr;
+  }
+  return allocator->assignMalloc(size);
 }
 
 extern "C" void free(void* ptr) {
@@ -403,14 +958,26 @@ extern "C" void free(void* ptr) {
     return;  // No object to free
   }
 
-  int index = pthread_self() % NUMOFTHREADCACHES;
-
-  Allocator::TheAllocator.increaseFreeCalls();
-  size_t freeobjsize = Allocator::TheAllocator.objectSize(ptr);
-  if (freeobjsize % CENTHEAPALLOCTHRESHOLD == 0) {
-    Allocator::TheAllocator.freeObject(ptr);
+  // Anything we free was allocated, so the allocator is built
+  Allocator* allocator = Allocator::TheAllocator;
+  // Objects above the thread cache threshold are central heap spans:
+  // whole pages. Anything else goes to a thread cache of the node it
+  // came from: ours, unless another node's thread allocated it.
+  size_t freeobjsize = allocator->objectSize(ptr);
+  size_t totalSize = freeobjsize + (sizeof(ObjHeader) << 1);
+  if (freeobjsize > CENTHEAPALLOCTHRESHOLD &&
+      totalSize % BASICALLOCSIZE == 0) {
+    if (allocator->isVerbose())
+      allocator->increaseFreeCalls();
+    allocator->freeObject(ptr);
   } else {
-    Allocator::TheAllocator.getThrCaches(index)->freeObject(ptr);
+    ThreadCache* cache = allocator->threadCache();
+    int node = reinterpret_cast<ObjHeader*>((char*)ptr -
+        sizeof(ObjHeader))->_node;
+    if (__builtin_expect(node != cache->node(), 0) &&
+        node >= 0 && node < allocator->numNodes())
+      cache = allocator->threadCache(node);
+    cache->freeObject(ptr);
   }
 }
 
@@ -422,35 +989,80 @@ extern "C" void* realloc(void *ptr, size_t size) {
   // Copy old object only if ptr != 0
   if (ptr != 0) {
     // copy only the minimum number of bytes
-    size_t sizeToCopy = Allocator::TheAllocator.objectSize(ptr);
+    size_t sizeToCopy = Allocator::TheAllocator->objectSize(ptr);
     if (sizeToCopy > size) {
       sizeToCopy = size;
     }
     
     memcpy(newptr, ptr, sizeToCopy);
 
-    //Free old object
-    Allocator::TheAllocator.freeObject(ptr);
+    //Free old object, to the heap it came from
+    free(ptr);
   }
 
-  Allocator::TheAllocator.increaseReallocCalls();
+  if (Allocator::TheAllocator->isVerbose())
+    Allocator::TheAllocator->increaseReallocCalls();
   return newptr;
 }
 
-// extern "C" void* calloc(size_t nelem, size_t elsize) {
-//   Allocator::TheAllocator.increaseCallocCalls();
-//   // calloc allocates and initializes
-//   size_t size = nelem * elsize;
-// 
-//   void* ptr = Allocator::TheAllocator.allocateObject(size);
-// 
-//   if (ptr) {
-//     // No error, Initialize chunk with 0s
-//     memset(ptr, 0, size);
-//   }
-// 
-//   return ptr;
-// }
+// glibc (pthread_create() among others) frees what calloc() returned
+// with our free(), so calloc() has to come from us too. Initialization
+// doesn't allocate anymore, so calling it early is fine.
+extern "C" void* calloc(size_t nelem, size_t elsize) {
+  // calloc allocates and initializes
+  size_t size = nelem * elsize;
+  if (elsize != 0 && size / elsize != nelem)
+    return NULL;  // Overflow
+
+  void* ptr = malloc(size ? size : 1);
+  if (ptr) {
+    // No error, Initialize chunk with 0s
+    memset(ptr, 0, size);
+  }
+
+  if (Allocator::TheAllocator->isVerbose())
+    Allocator::TheAllocator->increaseCallocCalls();
+  return ptr;
+}
+
+// Writes the size/lifetime profile merged across all heaps to 'path'.
+// Returns 0 on success, -1 if profiling is off or the write failed.
+extern "C" int mallocDumpProfile(const char* path) {
+  if (!Allocator::TheAllocator->isProfiling())
+    return -1;
+  return Allocator::TheAllocator->dumpProfile(path) ? 0 : -1;
+}
+
+// Sets the heap sizes, in bytes, above which the pressure handler is
+// called (see Allocator::setMemoryLimits). 0 disables a limit.
+extern "C" void mallocSetMemoryLimits(size_t soft, size_t hard) {
+  Allocator::ensureInitialized();
+  Allocator::TheAllocator->setMemoryLimits(soft, hard);
+}
+
+// Installs 'handler' as the memory pressure handler, replacing any
+// previous one. NULL removes the handler.
+extern "C" void mallocSetPressureHandler(PressureHandler handler) {
+  Allocator::ensureInitialized();
+  Allocator::TheAllocator->setPressureHandler(handler);
+}
+
+// Returns the memory taken from the OS and not given back, in bytes.
+extern "C" size_t mallocHeapSize() {
+  return Allocator::TheAllocator->heapSize();
+}
+
+// Returns the NUMA node whose central heap 'ptr' came from.
+extern "C" int mallocObjectNode(void* ptr) {
+  ObjHeader* obj = reinterpret_cast<ObjHeader*>((char*)ptr -
+      sizeof(ObjHeader));
+  return obj->_node;
+}
+
+// Returns the NUMA node the calling thread allocates from.
+extern "C" int mallocCurrentNode() {
+  return Allocator::TheAllocator->currentNode();
+}
 
 extern "C" void checkHeap() {
   // Verifies the heap consistency by iterating over all objects
@@ -2,6 +2,7 @@
 #define HEAP_ALLOC_HEADER_
 
 #include "lock.hpp"
+#include "size_profile.hpp"
 #include "thread_cache.hpp"  // For ThreadCache heap
 
 namespace myalloc {
@@ -11,29 +12,96 @@ namespace myalloc {
 // if <= this size,alloc from threadCache
 #define CENTHEAPALLOCTHRESHOLD (1UL << 14)
 #define NUMOFTHREADCACHES 17
+#define MAXNUMANODES 8
+#define MAXNUMCPUS 256
+#define HUGEPAGESIZE (1UL << 21)
+#define HUGEARENAPAGES 8      // Huge pages reserved per mmap()
+#define MAXHUGEPAGES 4096     // Size of the huge page table, power of 2
 
 using base::Mutex;
 
+// Called, outside of any allocator lock, with the number of bytes the
+// allocator would like the application to give back.
+typedef void (*PressureHandler)(size_t bytes);
+
 // This is the base allocator, It allocate/dealloc in Pages (4k)
 // chunks
+//
+// There is one central heap (free lists and lock) per NUMA node. A
+// request is served from the heap of the node the calling thread runs
+// on, and an object always goes back to the heap it came from, so
+// memory freed on one node is not handed to threads of another one.
+// The thread caches are split evenly among the nodes, and a cache
+// only holds memory of its own node: a thread binds to a cache of
+// the node it runs on, and a small object freed by a thread of
+// another node goes to a cache of the object's node.
+// Memory taken from the OS for a node is bound to it with mbind().
+// The topology is read from /sys. MALLOCNUMANODES=<n> simulates <n>
+// nodes instead: threads are spread round-robin over them and no
+// memory is bound, which lets the code run on a single-node machine.
+//
+// With MALLOCHUGEPAGES set, memory comes from 2MB-aligned mmap()
+// arenas marked MADV_HUGEPAGE instead of sbrk(). Spans are carved from
+// one huge page at a time, and spans for thread caches (which never
+// come back) are carved from other pages than spans for large
+// objects. The bytes in use are counted per huge page: when all the
+// spans of a large-object page are freed, the page is taken out of the
+// free lists and given back to the OS whole. Spans larger than a huge
+// page get their own run of huge pages.
+//
+// Initialization: the C++ runtime calls malloc() before any static
+// constructor of ours runs, so the allocator is not a static object.
+// It is built in place, in static storage, by the first malloc() (or
+// by a load-time constructor, whichever comes first) and never
+// destroyed. After that, each thread binds a thread cache once and
+// the malloc() fast path is a thread-local load plus a free-list pop
+// under the cache's lock. Caches are only shared once a node has more
+// threads than caches, so the lock is normally uncontended. The call
+// counters of verbose mode are kept per cache, under that same lock.
 class Allocator {
 public:
-  // This is the only instance of the allocator.
-  static Allocator TheAllocator;
-  Allocator() : _initialized(0) { }
+  // This is the only instance of the allocator. It's usable only
+  // after ensureInitialized().
+  static Allocator* const TheAllocator;
+  Allocator() { }
   ~Allocator() { }
 
-  //Initializes the heap
+  // Builds TheAllocator, once. Concurrent callers wait for the one
+  // doing it.
+  static void ensureInitialized() {
+    if (__builtin_expect(_initState != INITDONE, 0))
+      initializeOnce();
+  }
+
+  //Initializes the heap. Must not allocate.
   void initialize();
 
-  // Allocates an object, return "Head of 'usable' space
-  void* allocateObject(size_t size);
+  // Returns the thread cache of the calling thread, binding one of
+  // its current node on first use.
+  ThreadCache* threadCache();
+  // Returns the cache of 'node' the calling thread maps to.
+  ThreadCache* threadCache(int node);
+
+  // Allocates an object, return "Head of 'usable' space. 'forCache'
+  // is set when the object is a span for a thread cache. It comes
+  // from the heap of 'node', or of the current node if 'node' < 0.
+  void* allocateObject(size_t size, bool forCache = false, int node = -1);
   // Frees an object
   void freeObject(void* ptr);
-  // Gets memory from the OS
-  void* getMemoryFromOS(size_t size);
+  // Gets memory from the OS for the heap of 'node'
+  void* getMemoryFromOS(size_t size, int node, bool forCache);
+  // malloc() for anything but the thread cache fast path
   void* assignMalloc(size_t size);
 
+  bool isVerbose() const { return _verbose; }
+
+  size_t heapSize() const { return _heapSize; }
+
+  // NUMA topology
+  int numNodes() const { return _numNodes; }
+  // Returns the node the calling thread runs on (or is assigned to)
+  int currentNode();
+
   // At exit handler
   void atExitHandler();
   // Returns the size of an object
@@ -55,6 +123,27 @@ public:
     __sync_add_and_fetch(&_freeCalls, 0x1);
   }
 
+  // Size profiling is turned on by setting MALLOCPROFILE to the path
+  // where the merged profile should be written at exit.
+  bool isProfiling() const { return _profiling; }
+  // Records a request served directly by the central heap
+  void recordAlloc(size_t size);
+  // Merges the profiles of all heaps and writes them to 'path'
+  bool dumpProfile(const char* path);
+
+  // Memory pressure. The limits are checked against _heapSize each
+  // time it grows. Once above 'soft', every growth is reported to the
+  // handler; once above 'hard', the handler is asked for everything
+  // above 'soft'. With MALLOCHUGEPAGES the heap also shrinks, as
+  // empty huge pages go back to the OS; pressure not reported yet is
+  // then cut down to what is still above 'soft'. Allocations never
+  // fail because of the limits. A limit of 0 means no limit.
+  void setMemoryLimits(size_t soft, size_t hard);
+  void setPressureHandler(PressureHandler handler);
+  // Calls the handler if the heap crossed a limit since the last call
+  void checkPressure();
+  bool hasPressure() const { return _pressureBytes != 0; }
+
   struct DualLnkNode {
     DualLnkNode* next_;
     DualLnkNode* prev_;
@@ -67,27 +156,87 @@ public:
   void print();
   void getHeadFootInfo(const DualLnkNode* node) const;
   // For debugging
-  void checkFreeLsConsist(int index) const;  // check list freels_[index]
-  void checkDualLnkList(int index) const;
+  // check list freels_[index] of the heap of 'node'
+  void checkFreeLsConsist(int node, int index) const;
+  void checkDualLnkList(int node, int index) const;
   void checkALL() const;
   size_t sumFreeListSize() const;
   size_t getFreeNodeSize(const DualLnkNode* node) const;
 
 private:
-  DualLnkNode*        freels_[NUMOFSIZECLASSES];
+  // A huge page (or a run of them, for a big span) in use by a node
+  struct HugePage {
+    unsigned long     base;           // 0: empty slot
+    size_t            len;            // 0: unmapped
+    size_t            live;           // Bytes allocated from it
+    int               node;
+    int               next;           // Spare pages list
+  };
+
+  // Central heap of one NUMA node
+  struct NodeHeap {
+    DualLnkNode*      freels_[NUMOFSIZECLASSES];
+    Mutex             _m;             // Protects all below
+    size_t            _heapSize;      // Memory taken from the OS
+    // Huge page being carved and offset in it. [0]: thread cache
+    // spans, [1]: large objects.
+    int               _hugeCur[2];
+    size_t            _hugeOff[2];
+    int               _hugeSpare;     // Empty huge pages, -1 if none
+  };
+
+  NodeHeap            _nodes[MAXNUMANODES];
   ThreadCache         _thr_caches[NUMOFTHREADCACHES];
-  Mutex               _m;
-  size_t              _heapSize;      // Size of the heap
-  int                 _initialized;   // True if heap has been initialized
-  int                 _verbose;       // Verbose mode
-  int                 _mallocCalls;   // # malloc calls
-  int                 _freeCalls;     // # free calls
+  int                 _cachesPerNode; // Caches of node n start at n * this
+  int                 _nextCacheSlot; // Round-robin over a node's caches
+  Mutex               _m;             // Protects sbrk() and _profile
+  size_t              _heapSize;      // Size of the heap, all nodes
+  int                 _numNodes;      // # of NUMA nodes in use
+  bool                _simulatedNodes;  // Set by MALLOCNUMANODES
+  int                 _nextNode;      // Round-robin for simulated nodes
+  int16_t             _cpuNode[MAXNUMCPUS];  // cpu -> node
+  bool                _useHugePages;  // Set by MALLOCHUGEPAGES
+  // Open addressing table of huge pages, indexed by base address.
+  // Entries are added under _m. An unmapped span leaves a dead entry
+  // (len 0) that a later registration may take over. Live counts are
+  // updated under the lock of the entry's node.
+  HugePage            _hugePages[MAXHUGEPAGES];
+  int                 _verbose;       // Verbose mode, counts calls
+  int                 _mallocCalls;   // # malloc calls the caches didn't serve
+  int                 _freeCalls;     // # free calls the caches didn't serve
   int                 _reallocCalls;  // # realloc calls
   int                 _callocCalls;   // # realloc calls
-
-  // Insert to [pos] of the free-list
-  bool insertFreeBlock(DualLnkNode* toinsert, int pos);
-  DualLnkNode* rmFromFreeLs(int pos, size_t totsize);
+  bool                _profiling;     // Record sizes and lifetimes
+  const char*         _profilePath;   // Where to dump the profile at exit
+  SizeProfile         _profile;       // Central heap requests, under _m
+  Mutex               _dumpMutex;     // Serializes dumpProfile()
+  SizeProfile         _dumpTotal;     // Merged profile, under _dumpMutex
+  size_t              _softLimit;     // Heap size that triggers pressure
+  size_t              _hardLimit;     // Heap size that asks for it all
+  size_t              _pressureBytes; // Bytes to report, atomic
+  PressureHandler     _pressureHandler;
+
+  // Insert to [pos] of the free-list of 'node'
+  bool insertFreeBlock(DualLnkNode* toinsert, int node, int pos);
+  DualLnkNode* rmFromFreeLs(int node, int pos, size_t totsize);
+
+  // Reads the cpu -> node map from /sys, or MALLOCNUMANODES
+  void initTopology();
+  // Asks the kernel to place [mem, mem + size) on 'node'
+  void bindToNode(void* mem, size_t size, int node);
+
+  // Huge page arenas. All but the lookup require the node lock.
+  void* carveHugeSpan(size_t size, int node, bool forCache);
+  int newHugePage(int node);
+  int mapHugePages(size_t len, int node, int npages);
+  int registerHugePage(unsigned long base, size_t len, int node);
+  int findHugePage(const void* addr) const;
+  void releaseHugePage(int page);
+
+  enum { INITNONE = 0, INITRUNNING = 1, INITDONE = 2 };
+  static int          _initState;
+
+  static void initializeOnce();  // Slow path of ensureInitialized()
 
   // Non-copyable, non-assignable
   Allocator(const Allocator&);
@@ -0,0 +1,46 @@
+#ifndef RAW_WRITE_HEADER_
+#define RAW_WRITE_HEADER_
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace myalloc {
+
+// Output helpers for the allocator. stdio allocates its buffers with
+// malloc(), so the allocator must never call printf() and friends:
+// these write(2) straight to 'fd' instead. Both return false if the
+// write failed.
+
+inline bool rawWrite(int fd, const char* str) {
+  size_t len = strlen(str);
+  while (len > 0) {
+    ssize_t bytes = write(fd, str, len);
+    if (bytes < 0 && errno == EINTR)
+      continue;
+    if (bytes <= 0)
+      return false;
+    str += bytes;
+    len -= bytes;
+  }
+  return true;
+}
+
+// Writes 'val' in decimal, right-aligned to 'width' characters.
+inline bool rawWriteNum(int fd, unsigned long val, int width = 0) {
+  char buf[24];
+  char* end = buf + sizeof(buf) - 1;
+  char* p = end;
+  *p = '\0';
+  do {
+    *--p = '0' + val % 10;
+    val /= 10;
+  } while (val != 0);
+  while (p > buf && end - p < width)
+    *--p = ' ';
+  return rawWrite(fd, p);
+}
+
+}  // namespace myalloc
+
+#endif  // RAW_WRITE_HEADER_
@@ -0,0 +1,235 @@
+// Reads a size profile written by the allocator (run a program with
+// MALLOCPROFILE=<file>, or call mallocDumpProfile()) and proposes a
+// thread-cache size-class table that minimizes internal fragmentation
+// for the observed requests.
+//
+// Usage: ./sizetuner <profile> [#classes]
+//
+// The current table has one class every 8 bytes, from 48 up to 512
+// bytes (NUMOFSIZECLASSES 65, index = totalSize / 8). Requests whose
+// total size is above 512 bytes all land in the last free list, which
+// is kept sorted and searched linearly. The tuner reports, for both
+// the current and the proposed table, how many requests get an exact
+// class and how many bytes each table wastes rounding them up.
+//
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "size_profile.hpp"
+
+namespace {
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+// Mirror of the ThreadCache object layout: a header and a footer per
+// object, 8-byte rounding and a 48-byte minimum.
+const uint64_t kOverhead = 32;   // 2 * sizeof(ObjHeader)
+const uint64_t kMinObject = 48;  // header + footer + DualLnkNode
+const uint64_t kCurrentMaxClass = 512;
+const int kCurrentNumClasses = 64;
+
+uint64_t objectSize(uint64_t requested) {
+  uint64_t total = (requested + kOverhead + 7) & ~7ULL;
+  return total < kMinObject ? kMinObject : total;
+}
+
+struct Bucket {
+  uint64_t size;   // object size, including header and footer
+  uint64_t count;
+};
+
+struct Profile {
+  vector<Bucket>   buckets;    // sorted by size, distinct sizes
+  uint64_t         small_reqs;
+  uint64_t         large_reqs;  // above the thread cache threshold
+  vector<uint64_t> life;        // lifetime histogram
+  int              tick_shift;
+
+  Profile() : small_reqs(0), large_reqs(0), life(PROFNUMLOG2BUCKETS, 0),
+              tick_shift(PROFTICKSHIFT) { }
+};
+
+bool readProfile(const char* path, Profile* prof) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "can't open " << path << endl;
+    return false;
+  }
+
+  string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream is(line);
+    string kind;
+    uint64_t value, count;
+    if (!(is >> kind >> value >> count)) {
+      std::cerr << "bad line: " << line << endl;
+      return false;
+    }
+    if (kind == "size") {
+      uint64_t size = objectSize(value);
+      // Buckets are written in increasing order. Small requests map
+      // to the 48-byte minimum, so merge equal object sizes here.
+      if (!prof->buckets.empty() && prof->buckets.back().size == size) {
+        prof->buckets.back().count += count;
+      } else {
+        Bucket b = { size, count };
+        prof->buckets.push_back(b);
+      }
+      prof->small_reqs += count;
+    } else if (kind == "large") {
+      prof->large_reqs += count;
+    } else if (kind == "life" && value < prof->life.size()) {
+      prof->life[value] += count;
+    } else if (kind == "tickshift") {
+      prof->tick_shift = value;
+    }
+  }
+  return true;
+}
+
+// Picks 'k' class sizes out of the observed object sizes minimizing
+// sum(count * (class - size)). Every size gets rounded up to the
+// smallest class that fits it, so the largest observed size is always
+// a class. This is the classic O(k * n^2) dynamic program; n is at
+// most the number of 8-byte buckets in the profile (~2K).
+vector<uint64_t> proposeClasses(const vector<Bucket>& b, int k) {
+  const int n = b.size();
+  vector<uint64_t> classes;
+  if (n == 0)
+    return classes;
+  if (k >= n) {
+    for (int i = 0; i < n; ++i)
+      classes.push_back(b[i].size);
+    return classes;
+  }
+
+  // Prefix sums make the waste of one class O(1):
+  // waste(i..j) = size_j * (C_j - C_i) - (S_j - S_i)
+  vector<uint64_t> cnt(n + 1, 0), sum(n + 1, 0);
+  for (int i = 0; i < n; ++i) {
+    cnt[i + 1] = cnt[i] + b[i].count;
+    sum[i + 1] = sum[i] + b[i].count * b[i].size;
+  }
+
+  const uint64_t kInf = ~0ULL;
+  // best[c][j]: least waste covering buckets [0, j) with c classes,
+  // the last class being b[j-1].size. 'from' keeps the split point.
+  vector<vector<uint64_t> > best(k + 1, vector<uint64_t>(n + 1, kInf));
+  vector<vector<int> > from(k + 1, vector<int>(n + 1, 0));
+  best[0][0] = 0;
+  for (int c = 1; c <= k; ++c) {
+    for (int j = c; j <= n; ++j) {
+      for (int i = c - 1; i < j; ++i) {
+        if (best[c - 1][i] == kInf)
+          continue;
+        uint64_t waste = b[j - 1].size * (cnt[j] - cnt[i]) - (sum[j] - sum[i]);
+        if (best[c - 1][i] + waste < best[c][j]) {
+          best[c][j] = best[c - 1][i] + waste;
+          from[c][j] = i;
+        }
+      }
+    }
+  }
+
+  for (int c = k, j = n; c > 0; j = from[c][j], --c) {
+    classes.insert(classes.begin(), b[j - 1].size);
+  }
+  return classes;
+}
+
+struct Report {
+  uint64_t covered;  // requests served from an exact-size class
+  uint64_t waste;    // bytes lost rounding covered requests up
+};
+
+// Requests above the last class fall in the sorted, best-fit list and
+// are not counted as covered (they are not rounded to a class).
+Report evaluate(const vector<Bucket>& b, const vector<uint64_t>& classes) {
+  Report r = { 0, 0 };
+  size_t c = 0;
+  for (size_t i = 0; i < b.size(); ++i) {
+    while (c < classes.size() && classes[c] < b[i].size)
+      ++c;
+    if (c == classes.size())
+      break;
+    r.covered += b[i].count;
+    r.waste += b[i].count * (classes[c] - b[i].size);
+  }
+  return r;
+}
+
+void printReport(const char* name, const Report& r, uint64_t total) {
+  cout << name << ": covers " << r.covered << "/" << total << " requests ("
+       << (total ? 100.0 * r.covered / total : 0.0) << "%), waste "
+       << r.waste << " bytes ("
+       << (r.covered ? static_cast<double>(r.waste) / r.covered : 0.0)
+       << " bytes/request)" << endl;
+}
+
+void printLifetimes(const Profile& prof) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < prof.life.size(); ++i)
+    total += prof.life[i];
+  if (total == 0)
+    return;
+
+  cout << "Object lifetimes (ticks, cumulative %):" << endl;
+  uint64_t acc = 0;
+  for (size_t i = 0; i < prof.life.size(); ++i) {
+    if (prof.life[i] == 0)
+      continue;
+    acc += prof.life[i];
+    uint64_t upto = 1ULL << (i + prof.tick_shift);
+    cout << "  < " << upto << "\t" << 100.0 * acc / total << endl;
+  }
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2 || argc > 3) {
+    std::cout << "Usage: " << argv[0] << " <profile> [#classes]\n";
+    return 1;
+  }
+  int k = (argc == 3) ? atoi(argv[2]) : kCurrentNumClasses;
+  if (k <= 0) {
+    std::cout << "#classes must be positive\n";
+    return 1;
+  }
+
+  Profile prof;
+  if (!readProfile(argv[1], &prof))
+    return 1;
+
+  vector<uint64_t> current;
+  for (uint64_t s = kMinObject; s <= kCurrentMaxClass; s += 8)
+    current.push_back(s);
+  vector<uint64_t> proposed = proposeClasses(prof.buckets, k);
+
+  cout << "Thread-cache requests: " << prof.small_reqs
+       << ", central heap requests: " << prof.large_reqs << endl;
+  printReport("Current table ", evaluate(prof.buckets, current),
+              prof.small_reqs);
+  printReport("Proposed table", evaluate(prof.buckets, proposed),
+              prof.small_reqs);
+
+  cout << "Proposed classes (object size, header and footer included):";
+  for (size_t i = 0; i < proposed.size(); ++i) {
+    cout << (i % 12 ? " " : "\n  ") << proposed[i];
+  }
+  cout << endl;
+
+  printLifetimes(prof);
+  return 0;
+}
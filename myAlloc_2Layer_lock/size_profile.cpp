@@ -0,0 +1,77 @@
+#include <string.h>
+#include <unistd.h>
+#include "raw_write.hpp"
+#include "size_profile.hpp"
+
+namespace myalloc {
+
+void SizeProfile::clear() {
+  memset(small_, 0, sizeof(small_));
+  memset(large_, 0, sizeof(large_));
+  memset(life_, 0, sizeof(life_));
+}
+
+int SizeProfile::log2Floor(uint64_t v) {
+  int res = 0;
+  while (v >>= 1) {
+    ++res;
+  }
+  return res;
+}
+
+void SizeProfile::recordAlloc(size_t size) {
+  if (size <= PROFMAXSMALLSIZE) {
+    ++small_[(size + PROFSIZESTEP - 1) / PROFSIZESTEP];
+  } else {
+    ++large_[log2Floor(size)];
+  }
+}
+
+void SizeProfile::recordFree(uint32_t stamp, uint32_t stamp_now) {
+  // Unsigned subtraction takes care of the stamp wrapping around.
+  uint32_t lived = stamp_now - stamp;
+  ++life_[lived ? log2Floor(lived) + 1 : 0];
+}
+
+void SizeProfile::mergeInto(SizeProfile* total) const {
+  for (size_t i = 0; i < PROFNUMSMALLBUCKETS; ++i)
+    total->small_[i] += small_[i];
+  for (int i = 0; i < PROFNUMLOG2BUCKETS; ++i) {
+    total->large_[i] += large_[i];
+    total->life_[i] += life_[i];
+  }
+}
+
+// One "<kind> <value> <count>" line. See raw_write.hpp for why not
+// stdio.
+static bool writeLine(int fd, const char* kind, unsigned long value,
+                      uint64_t count) {
+  return rawWrite(fd, kind) && rawWrite(fd, " ") &&
+         rawWriteNum(fd, value) && rawWrite(fd, " ") &&
+         rawWriteNum(fd, count) && rawWrite(fd, "\n");
+}
+
+bool SizeProfile::dump(int fd) const {
+  if (!rawWrite(fd, "# myalloc size profile: <kind> <value> <count>\n"))
+    return false;
+  if (!writeLine(fd, "tickshift", PROFTICKSHIFT, 0))
+    return false;
+
+  // 'size' lines carry the upper bound of each 8-byte bucket, 'large'
+  // lines the log2 of the bucket and 'life' lines the lifetime bucket.
+  for (size_t i = 0; i < PROFNUMSMALLBUCKETS; ++i) {
+    if (small_[i] && !writeLine(fd, "size", i * PROFSIZESTEP, small_[i]))
+      return false;
+  }
+  for (int i = 0; i < PROFNUMLOG2BUCKETS; ++i) {
+    if (large_[i] && !writeLine(fd, "large", i, large_[i]))
+      return false;
+  }
+  for (int i = 0; i < PROFNUMLOG2BUCKETS; ++i) {
+    if (life_[i] && !writeLine(fd, "life", i, life_[i]))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace myalloc
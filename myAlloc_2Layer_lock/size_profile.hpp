@@ -0,0 +1,73 @@
+#ifndef SIZE_PROFILE_HEADER_
+#define SIZE_PROFILE_HEADER_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace myalloc {
+
+// Requested sizes up to PROFMAXSMALLSIZE are counted in PROFSIZESTEP
+// byte buckets, larger ones in power-of-two buckets.
+#define PROFSIZESTEP 8
+#define PROFMAXSMALLSIZE (1UL << 14)  // == CENTHEAPALLOCTHRESHOLD
+#define PROFNUMSMALLBUCKETS (PROFMAXSMALLSIZE / PROFSIZESTEP + 1)
+#define PROFNUMLOG2BUCKETS 64
+// Allocation stamps are kept in units of 2^PROFTICKSHIFT ticks so
+// that they fit the 32 bits left free in the ObjHeader.
+#define PROFTICKSHIFT 16
+
+// A SizeProfile is a histogram of the sizes requested to an allocator
+// heap and of how long those objects lived. Each heap (thread cache
+// or central heap) keeps its own profile; profiles are merged only
+// when a dump is requested.
+//
+// The class is NOT thread-safe. The owning heap updates it while
+// holding its own lock.
+//
+class SizeProfile {
+public:
+  SizeProfile() { clear(); }
+  ~SizeProfile() { }
+
+  void clear();
+
+  // Records a request for 'size' bytes.
+  void recordAlloc(size_t size);
+
+  // Records that an object allocated at 'stamp' (see now()) was freed
+  // at 'stamp_now'.
+  void recordFree(uint32_t stamp, uint32_t stamp_now);
+
+  // Adds all the counters in this profile to 'total'.
+  void mergeInto(SizeProfile* total) const;
+
+  // Writes the profile to 'fd' in the text format read by
+  // size_class_tuner. Returns false if the write failed.
+  bool dump(int fd) const;
+
+  // Returns the current coarse time used as allocation stamp. We read
+  // the timestamp counter directly rather than going through
+  // TicksClock, which would drag iostreams into the allocator.
+  static uint32_t now() {
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t hi;
+    uint32_t lo;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return static_cast<uint32_t>(((uint64_t)hi << 32 | lo) >> PROFTICKSHIFT);
+#else
+    return 0;
+#endif
+  }
+
+private:
+  uint64_t small_[PROFNUMSMALLBUCKETS];  // [i]: sizes in (8(i-1), 8i]
+  uint64_t large_[PROFNUMLOG2BUCKETS];   // [i]: sizes in [2^i, 2^(i+1))
+  uint64_t life_[PROFNUMLOG2BUCKETS];    // [0]: lived < 1 stamp unit,
+                                         // [i]: [2^(i-1), 2^i) units
+
+  static int log2Floor(uint64_t v);
+};
+
+}  // namespace myalloc
+
+#endif  // SIZE_PROFILE_HEADER_
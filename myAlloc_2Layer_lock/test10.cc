@@ -0,0 +1,115 @@
+/* Huge page test: run with MALLOCHUGEPAGES=1. Freeing every span of
+ * a huge page, or a span bigger than a huge page, must give the
+ * memory back to the OS. Memory pressure must follow the heap as it
+ * shrinks and grows again. Big spans keep being given back after more
+ * of them than the huge page table holds have come and gone.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+extern "C" size_t mallocHeapSize();
+extern "C" void mallocSetMemoryLimits(size_t soft, size_t hard);
+extern "C" void mallocSetPressureHandler(void (*handler)(size_t bytes));
+
+const int blocks = 256;  // 8MB, more than one huge page
+// Above the thread cache threshold, so free() gives it back to the
+// central heap.
+const size_t blocksize = 32 * 1024 - 32;
+const size_t bigsize = 5 * 1024 * 1024;
+const int spans = 5000;  // More than MAXHUGEPAGES
+
+static size_t reported = 0;
+
+static void onPressure(size_t bytes) {
+  reported += bytes;
+}
+
+int main(int argc, char* argv[]) {
+  printf("\n---- Running test10 ---\n");
+  const char* huge = getenv("MALLOCHUGEPAGES");
+  if (huge == NULL || huge[0] == '\0' || strcmp(huge, "NO") == 0) {
+    puts("Set MALLOCHUGEPAGES=1 to run test10");
+    return 1;
+  }
+
+  size_t before = mallocHeapSize();
+  char* keep[blocks];
+  for (int i = 0; i < blocks; ++i) {
+    keep[i] = (char*) malloc(blocksize);
+    memset(keep[i], 1, blocksize);
+  }
+  size_t peak = mallocHeapSize();
+  for (int i = 0; i < blocks; ++i) {
+    free(keep[i]);
+  }
+  size_t after = mallocHeapSize();
+  printf("heap: %lu before, %lu with blocks, %lu after free\n",
+         before, peak, after);
+  // Only the huge page still being carved, and the one shared with
+  // objects that were live before, may stay around
+  if (after > before + (4UL << 20)) {
+    puts("huge pages were not released");
+    return 1;
+  }
+
+  char* big = (char*) malloc(bigsize);
+  memset(big, 1, bigsize);
+  peak = mallocHeapSize();
+  free(big);
+  if (mallocHeapSize() != peak - (6UL << 20)) {
+    printf("big span not released: heap %lu, was %lu\n",
+           mallocHeapSize(), peak);
+    return 1;
+  }
+
+  // Growing back past the soft limit after the heap shrank reports
+  // only what is above the limit, each time.
+  mallocSetPressureHandler(onPressure);
+  size_t soft = mallocHeapSize() + (1UL << 20);
+  mallocSetMemoryLimits(soft, 0);
+  for (int round = 0; round < 2; ++round) {
+    size_t from = mallocHeapSize() > soft ? mallocHeapSize() : soft;
+    reported = 0;
+    for (int i = 0; i < blocks; ++i) {
+      keep[i] = (char*) malloc(blocksize);
+      memset(keep[i], 1, blocksize);
+    }
+    peak = mallocHeapSize();
+    for (int i = 0; i < blocks; ++i) {
+      free(keep[i]);
+    }
+    if (reported != peak - from) {
+      printf("round %d: pressure reported %lu bytes, heap went %lu over\n",
+             round, reported, peak - from);
+      return 1;
+    }
+  }
+  mallocSetPressureHandler(NULL);
+  mallocSetMemoryLimits(0, 0);
+
+  // Each big span gets a base of its own: reserving address space
+  // where the last one was keeps mmap() from handing it out again.
+  size_t base = mallocHeapSize();
+  void* pins[spans];
+  for (int i = 0; i < spans; ++i) {
+    big = (char*) malloc(bigsize);
+    big[0] = 1;
+    free(big);
+    if (mallocHeapSize() != base) {
+      printf("span %d not released: heap %lu, was %lu\n",
+             i, mallocHeapSize(), base);
+      return 1;
+    }
+    pins[i] = mmap(NULL, 8UL << 20, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  }
+  for (int i = 0; i < spans; ++i) {
+    if (pins[i] != MAP_FAILED)
+      munmap(pins[i], 8UL << 20);
+  }
+
+  puts(">>>> test10 Finished");
+  return 0;
+}
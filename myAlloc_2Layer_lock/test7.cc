@@ -0,0 +1,39 @@
+/* Size profile test: run with MALLOCPROFILE=<file>
+ */
+#include <stdlib.h>
+#include <stdio.h>
+
+extern "C" int mallocDumpProfile(const char* path);
+
+const int allocations = 5000;
+
+int main(int argc, char* argv[]) {
+  printf("\n---- Running test7 ---\n");
+  const char* path = getenv("MALLOCPROFILE");
+  if (path == NULL) {
+    puts("Set MALLOCPROFILE=<file> to run test7");
+    return 1;
+  }
+
+  // A skewed workload: mostly 24 and 100 byte objects, a few larger
+  // ones and some above the thread cache threshold.
+  char* keep[allocations];
+  for (int i = 0; i < allocations; ++i) {
+    int allocsize = (i % 10 < 6) ? 24 : (i % 10 < 9) ? 100 : 700 + i % 300;
+    keep[i] = (char*) malloc(allocsize);
+    *keep[i] = 1;
+  }
+  for (int i = 0; i < allocations; ++i) {
+    free(keep[i]);
+  }
+  char* big = (char*) malloc(100000);
+  *big = 0;
+  free(big);
+
+  if (mallocDumpProfile(path) != 0) {
+    puts("mallocDumpProfile failed");
+    return 1;
+  }
+  printf(">>>> test7 Finished, profile in %s\n\n", path);
+  return 0;
+}
@@ -0,0 +1,49 @@
+/* Memory pressure test: the handler must be called once the heap
+ * grows past the soft limit, and be asked for more past the hard one.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+
+extern "C" void mallocSetMemoryLimits(size_t soft, size_t hard);
+extern "C" void mallocSetPressureHandler(void (*handler)(size_t bytes));
+
+const int blocks = 32;
+const size_t blocksize = 64 * 1024;
+
+static int calls = 0;
+static size_t lastRequest = 0;
+
+static void onPressure(size_t bytes) {
+  ++calls;
+  lastRequest = bytes;
+  // The handler may allocate; that must not call it again.
+  char* tmp = (char*) malloc(2 * blocksize);
+  *tmp = 0;
+  free(tmp);
+}
+
+int main(int argc, char* argv[]) {
+  printf("\n---- Running test8 ---\n");
+  mallocSetPressureHandler(onPressure);
+  mallocSetMemoryLimits(512 * 1024, 1024 * 1024);
+
+  char* keep[blocks];
+  for (int i = 0; i < blocks; ++i) {
+    keep[i] = (char*) malloc(blocksize);
+    *keep[i] = 1;
+  }
+  if (calls == 0 || lastRequest < 1024 * 1024 - 512 * 1024) {
+    printf("pressure not reported: %d calls, last asked %lu bytes\n",
+           calls, lastRequest);
+    return 1;
+  }
+  printf("pressure reported %d times, last asked %lu bytes\n",
+         calls, lastRequest);
+  for (int i = 0; i < blocks; ++i) {
+    free(keep[i]);
+  }
+  mallocSetPressureHandler(NULL);
+
+  puts(">>>> test8 Finished");
+  return 0;
+}
@@ -0,0 +1,103 @@
+/* NUMA test: run with MALLOCNUMANODES=<n> to simulate <n> nodes.
+ * Threads must get memory from their own node's central heap, and
+ * must not reuse what a thread of another node freed. Small objects
+ * a thread frees for another node must go back to that node rather
+ * than to the freeing thread's cache.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+extern "C" int mallocObjectNode(void* ptr);
+extern "C" int mallocCurrentNode();
+
+const int threads = 4;
+const int blocks = 16;
+// Above the thread cache threshold, so free() gives it back to the
+// central heap.
+const size_t blocksize = 32 * 1024 - 32;
+// Served by the thread caches
+const size_t smallsize = 256;
+
+char* freed[blocks];
+// Small blocks allocated by the main thread, freed by worker [i]
+char* handed[threads][blocks];
+int mainNode;
+int errors = 0;
+
+void* worker(void* arg) {
+  int id = (long) arg;
+  int node = mallocCurrentNode();
+  for (int i = 0; i < blocks; ++i) {
+    free(handed[id][i]);
+  }
+  for (int i = 0; i < blocks; ++i) {
+    char* small = (char*) malloc(smallsize);
+    *small = 1;
+    if (mallocObjectNode(small) != node) {
+      printf("small block from node %d, thread on node %d\n",
+             mallocObjectNode(small), node);
+      __sync_add_and_fetch(&errors, 1);
+    }
+    for (int j = 0; node != mainNode && j < blocks; ++j) {
+      if (small == handed[id][j]) {
+        printf("node %d reused a small block of node %d\n", node, mainNode);
+        __sync_add_and_fetch(&errors, 1);
+      }
+    }
+  }
+
+  char* keep[blocks];
+  for (int i = 0; i < blocks; ++i) {
+    keep[i] = (char*) malloc(blocksize);
+    *keep[i] = 1;
+    if (mallocObjectNode(keep[i]) != node) {
+      printf("block from node %d, thread on node %d\n",
+             mallocObjectNode(keep[i]), node);
+      __sync_add_and_fetch(&errors, 1);
+    }
+    for (int j = 0; node != mainNode && j < blocks; ++j) {
+      if (keep[i] == freed[j]) {
+        printf("node %d reused a block freed on node %d\n", node, mainNode);
+        __sync_add_and_fetch(&errors, 1);
+      }
+    }
+  }
+  for (int i = 0; i < blocks; ++i) {
+    free(keep[i]);
+  }
+  return NULL;
+}
+
+int main(int argc, char* argv[]) {
+  printf("\n---- Running test9 ---\n");
+  mainNode = mallocCurrentNode();
+  for (int i = 0; i < blocks; ++i) {
+    freed[i] = (char*) malloc(blocksize);
+    *freed[i] = 1;
+  }
+  for (int i = 0; i < blocks; ++i) {
+    free(freed[i]);
+  }
+  for (int t = 0; t < threads; ++t) {
+    for (int i = 0; i < blocks; ++i) {
+      handed[t][i] = (char*) malloc(smallsize);
+      *handed[t][i] = 1;
+    }
+  }
+
+  pthread_t tids[threads];
+  for (int i = 0; i < threads; ++i) {
+    pthread_create(&tids[i], NULL, worker, (void*) (long) i);
+  }
+  for (int i = 0; i < threads; ++i) {
+    pthread_join(tids[i], NULL);
+  }
+  if (errors) {
+    printf("%d errors\n", errors);
+    return 1;
+  }
+
+  puts(">>>> test9 Finished");
+  return 0;
+}
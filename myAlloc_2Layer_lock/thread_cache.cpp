@@ -6,10 +6,10 @@
 #include <cassert>
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
 #include <unistd.h>
 #include "thread_cache.hpp"
 #include "heap_alloc.hpp"
+#include "raw_write.hpp"
 
 namespace myalloc {
 
@@ -24,17 +24,13 @@ void ThreadCache::initialize() {
 
   for (int i = 0; i < NUMOFSIZECLASSES; ++i)
     freels_[i] = NULL;
+  _mallocCalls = 0;
+  _freeCalls = 0;
 
-  // _initialized = 1;  // Already set by CAS instruction
+  _initialized = 1;
 }
 
 void* ThreadCache::allocateObject(size_t size) {
-  //Make sure that allocator is initialized
-  if (!_initialized) {
-    if (__sync_bool_compare_and_swap(&_initialized, 0, 1))
-      initialize();
-  }
-
   // Add the ObjHeader and Footer to the size and round the total size
   // up to a multiple of 8 bytes for alignment.
   size_t totalSize = (size + (sizeof(ObjHeader) << 1) + 7) & ~7;
@@ -49,6 +45,10 @@ void* ThreadCache::allocateObject(size_t size) {
 
   // Lock the shared doubly-linked-list-of-lists heap:
   _m.lock();
+  if (_verbose)
+    ++_mallocCalls;
+  if (_cent_heap->isProfiling())
+    _profile.recordAlloc(size);
 
   if (freels_[index++] != NULL) {
     // if 0 <= index <= 63, "mem" won't be NULL, since
@@ -82,15 +82,20 @@ void* ThreadCache::allocateObject(size_t size) {
       if (realSize >= (totalSize + sizeof(DualLnkNode) +
             2 * sizeof(ObjHeader))) {
         size_t newclass = (realSize - totalSize) / 8;
+        // Both halves stay on the node of the chunk they came from
+        int16_t node = ((ObjHeader*)((unsigned char*)toSplit -
+            sizeof(ObjHeader)))->_node;
         // Set header and footer for new splitted object
         ObjHeader* splitobj = (ObjHeader*)((unsigned char*)toSplit +
             totalSize - sizeof(ObjHeader));
         splitobj->_objectSize = realSize - totalSize;  // may > sizeclass
         splitobj->_flags = ObjFree;
+        splitobj->_node = node;
         splitobj = (ObjHeader*)((unsigned char*)toSplit + realSize
           - 2 * sizeof(ObjHeader));  // Now, pointing to footer
         splitobj->_objectSize = realSize - totalSize;  // may > sizeclass
         splitobj->_flags = ObjFree;
+        splitobj->_node = node;
         assert(insertFreeBlock((DualLnkNode*)((unsigned char*)toSplit +
           totalSize), newclass));
         mem = (void*)((unsigned char*)toSplit - sizeof(ObjHeader));
@@ -108,6 +113,8 @@ void* ThreadCache::allocateObject(size_t size) {
   obj->_objectSize = totalSize;
   // Set object as allocated
   obj->_flags = ObjAllocated;
+  if (_cent_heap->isProfiling())
+    obj->_stamp = SizeProfile::now();
   // "obj" now points to the Footer, set footer values
   obj = (ObjHeader*)((unsigned char*)obj + totalSize - sizeof(ObjHeader));
   obj->_objectSize = totalSize;
@@ -127,10 +134,14 @@ void ThreadCache::freeObject(void* ptr) {
   size_t totalSize = obj->_objectSize;
 
   _m.lock();
+  if (_verbose)
+    ++_freeCalls;
+  if (_cent_heap->isProfiling())
+    _profile.recordFree(obj->_stamp, SizeProfile::now());
   // No space to put it into free-list (min: 48 bytes)
   if (totalSize < (sizeof(DualLnkNode) + 2 * sizeof(ObjHeader))) { 
     _m.unlock();
-    puts("Free without gettting back-------------");
+    rawWrite(STDOUT_FILENO, "Free without gettting back-------------\n");
     return;
   } else {
     obj->_flags = ObjFree;
@@ -154,16 +165,22 @@ size_t ThreadCache::objectSize(void* ptr) {
 }
 
 void ThreadCache::print() {
-  printf("-------------------\n");
+  const int out = STDOUT_FILENO;
+  rawWrite(out, "-------------------\n");
   size_t sumfreelssize = sumFreeListSize();
-  printf("ThreadCache Size: %10lu  sumFreeLsSize: %10lu   (Equal? %c)\n",
-      _heapSize, sumfreelssize, ((_heapSize == sumfreelssize)? 'Y':'N'));
-  printf("-------------------\n");
+  rawWrite(out, "ThreadCache Size: ");
+  rawWriteNum(out, _heapSize, 10);
+  rawWrite(out, "  sumFreeLsSize: ");
+  rawWriteNum(out, sumfreelssize, 10);
+  rawWrite(out, (_heapSize == sumfreelssize) ? "   (Equal? Y)\n"
+                                             : "   (Equal? N)\n");
+  rawWrite(out, "-------------------\n");
 }
 
 void* ThreadCache::getMemoryFromCentHeap(size_t size) {
-  // Get memory from Allocator class (central heap)-shared among threads
-  void* pAvailSpace = _cent_heap->allocateObject(size);
+  // Get memory from Allocator class (central heap)-shared among threads.
+  // It comes from the heap of the cache's node.
+  void* pAvailSpace = _cent_heap->allocateObject(size, true, _node);
   // Now change the pointer points to the "Head of the whole chunk,
   // *NOT* after (Header)"
   return static_cast<void*>((char*)pAvailSpace - sizeof(ObjHeader));
@@ -274,11 +291,17 @@ ThreadCache::DualLnkNode* ThreadCache::rmFromFreeLs(int pos, size_t totsize) {
 void ThreadCache::getHeadFootInfo(const DualLnkNode* node) const {
   ObjHeader* obj = (ObjHeader*)((unsigned char*)node - sizeof(ObjHeader));
   size_t objsize = obj->_objectSize;
-  printf("Header: h_size = %lu, h_flag = %d\n", objsize, obj->_flags);
+  rawWrite(STDOUT_FILENO, "Header: h_size = ");
+  rawWriteNum(STDOUT_FILENO, objsize);
+  rawWrite(STDOUT_FILENO, ", h_flag = ");
+  rawWriteNum(STDOUT_FILENO, obj->_flags);
   // Now "obj" points to the footer of this node
   obj = (ObjHeader*)((unsigned char*)node + objsize-2*sizeof(ObjHeader));
-  printf("Footer: f_size = %lu, f_flag = %d\n", obj->_objectSize,
-      obj->_flags);
+  rawWrite(STDOUT_FILENO, "\nFooter: f_size = ");
+  rawWriteNum(STDOUT_FILENO, obj->_objectSize);
+  rawWrite(STDOUT_FILENO, ", f_flag = ");
+  rawWriteNum(STDOUT_FILENO, obj->_flags);
+  rawWrite(STDOUT_FILENO, "\n");
 }
 
 void ThreadCache::checkFreeLsConsist(int index) const {
@@ -340,6 +363,12 @@ size_t ThreadCache::sumFreeListSize() const {
   return sumsize;
 }
 
+void ThreadCache::mergeProfile(SizeProfile* total) {
+  _m.lock();
+  _profile.mergeInto(total);
+  _m.unlock();
+}
+
 size_t ThreadCache::getFreeNodeSize(const DualLnkNode* node) const {
   return ((ObjHeader*)((unsigned char*)node - sizeof(ObjHeader)))->
     _objectSize;
@@ -2,6 +2,7 @@
 #define THREAD_CACHE_HEADER_
 
 #include "lock.hpp"
+#include "size_profile.hpp"
 
 namespace myalloc {
 
@@ -13,7 +14,9 @@ enum { ObjFree = 0, ObjAllocated = 1 };
 
 // Header of an object. Used both when the object is allocated and freed
 struct ObjHeader {     // Footer is the same structure
-  int _flags;          // flags == ObjFree or flags = ObjAllocated
+  int16_t _flags;      // flags == ObjFree or flags = ObjAllocated
+  int16_t _node;       // NUMA node of the central heap it came from
+  uint32_t _stamp;     // SizeProfile::now() at allocation, if profiling
   size_t _objectSize;  // Size of the object. Used when allocated/freed
 };
 
@@ -21,8 +24,9 @@ class Allocator;
 
 class ThreadCache {
 public:
-  ThreadCache() : _heapSize(0), _initialized(0), _verbose(0) { }
+  ThreadCache() : _node(0), _heapSize(0), _initialized(0), _verbose(0) { }
   explicit ThreadCache(Allocator* pcentheap) : _cent_heap(pcentheap),
+                                      _node(0),
                                       _heapSize(0),
                                       _initialized(0),
                                       _verbose(0) { }
@@ -31,6 +35,10 @@ public:
   //Initializes the heap
   void initialize();
   void setCentralHeap(Allocator* pheap) { _cent_heap = pheap; }
+  // The cache only holds memory of NUMA node 'node': it refills from
+  // that node's central heap and takes back that node's objects.
+  void setNode(int node) { _node = node; }
+  int node() const { return _node; }
 
   // Allocates an object 
   void* allocateObject(size_t size);
@@ -62,14 +70,23 @@ public:
   size_t sumFreeListSize() const;
   size_t getFreeNodeSize(const DualLnkNode* node) const;
   bool isInitialized() const { return _initialized; }
+  // Calls served by this cache, counted in verbose mode only
+  int mallocCalls() const { return _mallocCalls; }
+  int freeCalls() const { return _freeCalls; }
+  // Adds this cache's size profile to 'total'
+  void mergeProfile(SizeProfile* total);
 
 private:
   DualLnkNode* freels_[NUMOFSIZECLASSES];
   Allocator*   _cent_heap;     // Central shared heap (in 4k allocates)
+  int          _node;          // NUMA node of all memory in the cache
   Mutex        _m;
   size_t       _heapSize;      // Size of the heap
   int          _initialized;   // True if heap has been initialized
   int          _verbose;       // Verbose mode
+  int          _mallocCalls;   // # malloc calls, under _m
+  int          _freeCalls;     // # free calls, under _m
+  SizeProfile  _profile;       // Only updated if central heap profiles
 
   // Insert to [pos] of the free-list
   bool insertFreeBlock(DualLnkNode* toinsert, int pos);
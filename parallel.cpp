@@ -0,0 +1,149 @@
+#include "fixed_size_pool.hpp"
+#include "parallel.hpp"
+
+namespace base {
+
+namespace {
+
+// A pool task that makes its worker a participant of 'job'.
+class ParallelHelper : public Callback<void>, public Pooled<ParallelHelper> {
+public:
+  explicit ParallelHelper(ParallelJob* job) : job_(job) { }
+  virtual ~ParallelHelper() { }
+
+  virtual void operator()() {
+    job_->help();
+    delete this;
+  }
+
+  virtual bool once() const { return true; }
+
+private:
+  ParallelJob* job_;  // one reference owned here
+};
+
+// Runs 'body' on each range; there's nothing to merge.
+class ParallelForJob : public ParallelJob {
+public:
+  ParallelForJob(ThreadPool* pool, size_t begin, size_t end, size_t grain,
+                 Callback<void, size_t, size_t>* body)
+    : ParallelJob(pool, begin, end, grain), body_(body) { }
+  virtual ~ParallelForJob() { }
+
+  virtual void participate() {
+    size_t done = 0;
+    size_t b;
+    size_t e;
+    while (nextRange(&b, &e)) {
+      (*body_)(b, e);
+      done += e - b;
+    }
+    if (done == 0) {
+      return;
+    }
+
+    ScopedLock l(&m_);
+    finishLocked(done);
+  }
+
+private:
+  Callback<void, size_t, size_t>* body_;  // not owned here
+};
+
+} // unnamed namespace
+
+ParallelJob::ParallelJob(ThreadPool* pool,
+                         size_t begin,
+                         size_t end,
+                         size_t grain)
+  : pool_(pool),
+    grain_(grain > 0 ? grain : 1),
+    refs_(1),
+    helpers_(0),
+    remaining_(end - begin) {
+  Range range = { begin, end };
+  ranges_.push_back(range);
+}
+
+ParallelJob::~ParallelJob() {
+}
+
+void ParallelJob::unref() {
+  if (__sync_sub_and_fetch(&refs_, 1) == 0) {
+    delete this;
+  }
+}
+
+void ParallelJob::help() {
+  participate();
+
+  m_.lock();
+  helpers_--;
+  m_.unlock();
+
+  unref();
+}
+
+void ParallelJob::run() {
+  participate();
+
+  ScopedLock l(&m_);
+  while (remaining_ > 0) {
+    cv_done_.wait(&m_);
+  }
+}
+
+bool ParallelJob::nextRange(size_t* b, size_t* e) {
+  int helpers = 0;
+
+  m_.lock();
+  if (ranges_.empty()) {
+    m_.unlock();
+    return false;
+  }
+  Range range = ranges_.back();
+  ranges_.pop_back();
+  while (range.end - range.begin > grain_) {
+    Range upper = { range.begin + (range.end - range.begin) / 2, range.end };
+    ranges_.push_back(upper);
+    range.end = upper.begin;
+    if (pool_ != NULL && helpers_ < kMaxHelpers) {
+      helpers_++;
+      helpers++;
+    }
+  }
+  m_.unlock();
+
+  // One helper per range put back, up to kMaxHelpers. A NULL pool
+  // leaves it all to the caller.
+  for (int i = 0; i < helpers; i++) {
+    ref();
+    pool_->addTask(new ParallelHelper(this));
+  }
+
+  *b = range.begin;
+  *e = range.end;
+  return true;
+}
+
+void ParallelJob::finishLocked(size_t done) {
+  remaining_ -= done;
+  if (remaining_ == 0) {
+    cv_done_.signalAll();
+  }
+}
+
+void parallelFor(ThreadPool* pool,
+                 size_t begin,
+                 size_t end,
+                 size_t grain,
+                 Callback<void, size_t, size_t>* body) {
+  if (begin >= end) {
+    return;
+  }
+  ParallelJob* job = new ParallelForJob(pool, begin, end, grain, body);
+  job->run();
+  job->unref();
+}
+
+} // namespace base
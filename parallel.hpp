@@ -0,0 +1,192 @@
+#ifndef MCP_BASE_PARALLEL_HEADER
+#define MCP_BASE_PARALLEL_HEADER
+
+#include <stddef.h>
+#include <vector>
+
+#include "callback.hpp"
+#include "lock.hpp"
+#include "thread_pool.hpp"
+
+namespace base {
+
+using std::vector;
+
+// parallelFor() and parallelReduce() spread the work on a range of
+// indices [begin, end) over a ThreadPool's workers and the calling
+// thread, and return when all of it is done.
+//
+// The range is split recursively: a participant takes a range, and
+// while it is larger than 'grain' keeps the lower half and puts the
+// upper half back for someone else, posting a helper task to the
+// pool for it. Only ranges of at most 'grain' run. A call keeps at
+// most ParallelJob::kMaxHelpers helpers queued or running, so it
+// doesn't flood a pool with helpers that would find nothing left to
+// do. A call from inside a ThreadPoolNormal worker may still meet a
+// full queue; the worker then runs the helper itself.
+// The caller participates until no range is left, so the call
+// completes even if the pool is busy -- or is the very pool the
+// caller runs on.
+//
+// parallelReduce() keeps each participant's partial result in a local
+// variable and merges it into the total once, when the participant
+// runs out of ranges. No per-chunk results are stored side by side,
+// so there is nothing to false-share. 'combine' must be associative
+// and commutative: partial results are merged in no particular
+// order.
+//
+// The callbacks aren't owned; they're issued concurrently and must be
+// many-callbacks.
+//
+// Usage:
+//   struct Squares {
+//     void fill(size_t b, size_t e) { for (...) v[i] = i * i; }
+//     long sum(size_t b, size_t e) { ... }
+//     long add(long a, long b) { return a + b; }
+//   };
+//   Callback<void, size_t, size_t>* fill =
+//     makeCallableMany(&Squares::fill, &squares);
+//   parallelFor(pool, 0, n, 1024, fill);
+//   long total = parallelReduce(pool, 0, n, 1024, 0L, sum, add);
+//
+
+// Issues 'body(b, e)' on subranges of [begin, end) of at most 'grain'
+// indices that together cover it.
+void parallelFor(ThreadPool* pool,
+                 size_t begin,
+                 size_t end,
+                 size_t grain,
+                 Callback<void, size_t, size_t>* body);
+
+// Returns 'identity' combined with 'map(b, e)' for subranges of
+// [begin, end) of at most 'grain' indices that together cover it.
+template<typename T>
+T parallelReduce(ThreadPool* pool,
+                 size_t begin,
+                 size_t end,
+                 size_t grain,
+                 const T& identity,
+                 Callback<T, size_t, size_t>* map,
+                 Callback<T, T, T>* combine);
+
+//
+// Implementation. Internal to this file.
+//
+
+// The state of one parallel call: the ranges left to run, and the
+// count of indices not done yet. Participants are the caller and the
+// helper tasks posted to the pool; helpers that start late just find
+// no range left. The job lives until the caller and every helper let
+// go of it.
+class ParallelJob {
+public:
+  static const int kMaxHelpers = 64;
+
+  ParallelJob(ThreadPool* pool, size_t begin, size_t end, size_t grain);
+  virtual ~ParallelJob();
+
+  // Runs the caller's share and waits for the others' to finish.
+  void run();
+
+  void ref() { __sync_fetch_and_add(&refs_, 1); }
+  void unref();
+
+  // Takes ranges until none is left. Called by every participant.
+  virtual void participate() = 0;
+
+  // Participates as one of the helpers posted to the pool, then lets
+  // go of the job.
+  void help();
+
+protected:
+  // Protects the ranges, the remaining count and whatever the derived
+  // class merges results into.
+  Mutex m_;
+
+  // Fills [*b, *e) with a range of at most 'grain' indices, splitting
+  // bigger ones. Returns false if no range is left.
+  bool nextRange(size_t* b, size_t* e);
+
+  // Accounts for 'done' indices being run. REQUIRES: m_ held.
+  void finishLocked(size_t done);
+
+private:
+  struct Range {
+    size_t begin;
+    size_t end;
+  };
+
+  ThreadPool*    pool_;        // not owned here
+  const size_t   grain_;
+  int            refs_;
+  int            helpers_;     // posted and not done yet
+  vector<Range>  ranges_;      // ranges nobody took yet
+  size_t         remaining_;   // indices not run yet
+  ConditionVar   cv_done_;     // remaining_ reached 0
+
+  // Non-copyable, non-assignable.
+  ParallelJob(const ParallelJob&);
+  ParallelJob& operator=(const ParallelJob&);
+};
+
+template<typename T>
+class ParallelReduceJob : public ParallelJob {
+public:
+  ParallelReduceJob(ThreadPool* pool, size_t begin, size_t end, size_t grain,
+                    const T& identity,
+                    Callback<T, size_t, size_t>* map,
+                    Callback<T, T, T>* combine)
+    : ParallelJob(pool, begin, end, grain),
+      identity_(identity), result_(identity), map_(map), combine_(combine) { }
+  virtual ~ParallelReduceJob() { }
+
+  virtual void participate() {
+    T local = identity_;
+    size_t done = 0;
+    size_t b;
+    size_t e;
+    while (nextRange(&b, &e)) {
+      local = (*combine_)(local, (*map_)(b, e));
+      done += e - b;
+    }
+    if (done == 0) {
+      return;
+    }
+
+    ScopedLock l(&m_);
+    result_ = (*combine_)(result_, local);
+    finishLocked(done);
+  }
+
+  // REQUIRES: run() returned.
+  const T& result() const { return result_; }
+
+private:
+  const T                      identity_;
+  T                            result_;
+  Callback<T, size_t, size_t>* map_;      // not owned here
+  Callback<T, T, T>*           combine_;  // not owned here
+};
+
+template<typename T>
+T parallelReduce(ThreadPool* pool,
+                 size_t begin,
+                 size_t end,
+                 size_t grain,
+                 const T& identity,
+                 Callback<T, size_t, size_t>* map,
+                 Callback<T, T, T>* combine) {
+  if (begin >= end) {
+    return identity;
+  }
+  ParallelReduceJob<T>* job =
+    new ParallelReduceJob<T>(pool, begin, end, grain, identity, map, combine);
+  job->run();
+  T res = job->result();
+  job->unref();
+  return res;
+}
+
+} // namespace base
+
+#endif // MCP_BASE_PARALLEL_HEADER
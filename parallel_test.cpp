@@ -0,0 +1,187 @@
+#include <vector>
+
+#include "callback.hpp"
+#include "lock.hpp"
+#include "parallel.hpp"
+#include "thread_pool_fast.hpp"
+#include "thread_pool_normal.hpp"
+#include "thread_pool_stealing.hpp"
+#include "test_unit.hpp"
+
+namespace {
+
+using base::Callback;
+using base::makeCallableMany;
+using base::makeCallableOnce;
+using base::Notification;
+using base::parallelFor;
+using base::parallelReduce;
+using base::ThreadPool;
+using base::ThreadPoolFast;
+using base::ThreadPoolNormal;
+using base::ThreadPoolStealing;
+using std::vector;
+
+// Counts the visits to each index and the calls to the body.
+struct Visits {
+  explicit Visits(size_t n) : hits(n, 0), calls(0), too_big(0) { }
+
+  void visit(size_t b, size_t e) {
+    __sync_fetch_and_add(&calls, 1);
+    if (e - b > 16) {
+      __sync_fetch_and_add(&too_big, 1);
+    }
+    for (size_t i = b; i < e; i++) {
+      __sync_fetch_and_add(&hits[i], 1);
+    }
+  }
+
+  bool eachOnce() const {
+    for (size_t i = 0; i < hits.size(); i++) {
+      if (hits[i] != 1) return false;
+    }
+    return true;
+  }
+
+  vector<int> hits;
+  int         calls;
+  int         too_big;
+};
+
+struct Sum {
+  long sum(size_t b, size_t e) {
+    long res = 0;
+    for (size_t i = b; i < e; i++) res += i;
+    return res;
+  }
+  long add(long a, long b) { return a + b; }
+};
+
+// Sums [0, n) on 'pool'. Meant to be run from one of its workers.
+struct Nested {
+  Nested(ThreadPool* p, size_t n) : pool(p), n(n), res(0) { }
+
+  void run() {
+    Callback<long, size_t, size_t>* sum = makeCallableMany(&Sum::sum, &s);
+    Callback<long, long, long>* add = makeCallableMany(&Sum::add, &s);
+    res = parallelReduce(pool, 0, n, 10, 0L, sum, add);
+    delete sum;
+    delete add;
+    done.notify();
+  }
+
+  ThreadPool*  pool;
+  size_t       n;
+  Sum          s;
+  long         res;
+  Notification done;
+};
+
+long sumOn(ThreadPool* pool, size_t n, size_t grain) {
+  Sum s;
+  Callback<long, size_t, size_t>* sum = makeCallableMany(&Sum::sum, &s);
+  Callback<long, long, long>* add = makeCallableMany(&Sum::add, &s);
+  long res = parallelReduce(pool, 0, n, grain, 0L, sum, add);
+  delete sum;
+  delete add;
+  return res;
+}
+
+//
+// Test Cases
+//
+
+TEST(For, VisitsEachIndexOnce) {
+  ThreadPool* pool = new ThreadPoolFast(4);
+  Visits visits(10000);
+  Callback<void, size_t, size_t>* body =
+    makeCallableMany(&Visits::visit, &visits);
+
+  parallelFor(pool, 0, 10000, 16, body);
+  EXPECT_TRUE(visits.eachOnce());
+  EXPECT_EQ(visits.too_big, 0);
+
+  delete body;
+  pool->stop();
+  delete pool;
+}
+
+TEST(For, EmptyRange) {
+  ThreadPool* pool = new ThreadPoolFast(2);
+  Visits visits(10);
+  Callback<void, size_t, size_t>* body =
+    makeCallableMany(&Visits::visit, &visits);
+
+  parallelFor(pool, 5, 5, 1, body);
+  parallelFor(pool, 7, 3, 1, body);
+  EXPECT_EQ(visits.calls, 0);
+
+  delete body;
+  pool->stop();
+  delete pool;
+}
+
+TEST(For, NoPool) {
+  Visits visits(1000);
+  Callback<void, size_t, size_t>* body =
+    makeCallableMany(&Visits::visit, &visits);
+
+  parallelFor(NULL, 0, 1000, 16, body);
+  EXPECT_TRUE(visits.eachOnce());
+
+  delete body;
+}
+
+TEST(Reduce, Sum) {
+  const size_t n = 100000;
+  const long expected = long(n) * (n - 1) / 2;
+
+  ThreadPool* pools[] = { new ThreadPoolNormal(4),
+                          new ThreadPoolFast(4),
+                          new ThreadPoolStealing(4) };
+  for (size_t i = 0; i < sizeof(pools)/sizeof(pools[0]); i++) {
+    EXPECT_EQ(sumOn(pools[i], n, 1000), expected);
+    EXPECT_EQ(sumOn(pools[i], n, 1), expected);
+    EXPECT_EQ(sumOn(pools[i], n, n), expected);
+    pools[i]->stop();
+    delete pools[i];
+  }
+  EXPECT_EQ(sumOn(NULL, n, 1000), expected);
+  EXPECT_EQ(sumOn(NULL, 0, 1000), 0);
+}
+
+TEST(Reduce, FromWorker) {
+  // The only worker issues the call: the helpers it posts can't run
+  // until it is done, so it has to do all of the work itself.
+  ThreadPool* pool = new ThreadPoolFast(1);
+  Nested nested(pool, 1000);
+  pool->addTask(makeCallableOnce(&Nested::run, &nested));
+  nested.done.wait();
+  EXPECT_EQ(nested.res, 1000L * 999 / 2);
+
+  pool->stop();
+  delete pool;
+}
+
+TEST(Reduce, FromWorkersOfFullPool) {
+  // Both workers issue calls into a queue with room for two helpers.
+  // Neither may block waiting for room the other won't make.
+  ThreadPool* pool = new ThreadPoolNormal(2, 2);
+  Nested nested1(pool, 100000);
+  Nested nested2(pool, 100000);
+  pool->addTask(makeCallableOnce(&Nested::run, &nested1));
+  pool->addTask(makeCallableOnce(&Nested::run, &nested2));
+  nested1.done.wait();
+  nested2.done.wait();
+  EXPECT_EQ(nested1.res, 100000L * 99999 / 2);
+  EXPECT_EQ(nested2.res, 100000L * 99999 / 2);
+
+  pool->stop();
+  delete pool;
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  return RUN_TESTS(argc, argv);
+}
@@ -0,0 +1,100 @@
+#ifndef MCP_BASE_PERF_COUNTER_HEADER
+#define MCP_BASE_PERF_COUNTER_HEADER
+
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace base {
+
+// A hardware event counter for this process, backed by
+// perf_event_open(2). Threads created after the counter is built are
+// counted as well; their counts are added in when they exit.
+//
+// The kernel may refuse to open the counter (no PMU in a VM,
+// perf_event_paranoid too strict). Then valid() is false and read()
+// returns 0, so benchmarks can print the column anyway.
+//
+// Usage:
+//
+//   PerfCounter dtlb(PerfCounter::DTLB_LOAD_MISSES);
+//   dtlb.start();
+//   ... event we want to count
+//   dtlb.stop();
+//
+//   std::cout << "dTLB misses " << dtlb.read();
+//
+
+class PerfCounter {
+public:
+  enum Event { DTLB_LOAD_MISSES, DTLB_STORE_MISSES, CYCLES };
+
+  explicit PerfCounter(Event event) : fd_(-1) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    switch (event) {
+    case DTLB_LOAD_MISSES:
+    case DTLB_STORE_MISSES:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_DTLB |
+        ((event == DTLB_LOAD_MISSES ? PERF_COUNT_HW_CACHE_OP_READ
+                                    : PERF_COUNT_HW_CACHE_OP_WRITE) << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case CYCLES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    }
+    fd_ = syscall(__NR_perf_event_open, &attr, 0 /* this process */,
+                  -1 /* any cpu */, -1 /* no group */, 0);
+  }
+
+  ~PerfCounter() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  bool valid() const { return fd_ >= 0; }
+
+  void start() {
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  void stop() {
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+
+  uint64_t read() const {
+    uint64_t count = 0;
+    if (fd_ < 0 || ::read(fd_, &count, sizeof(count)) != sizeof(count)) {
+      return 0;
+    }
+    return count;
+  }
+
+private:
+  int fd_;
+
+  // Non-copyable, non-assignable
+  PerfCounter(PerfCounter&);
+  PerfCounter& operator=(PerfCounter&);
+};
+
+}  // namespace base
+
+#endif  // MCP_BASE_PERF_COUNTER_HEADER
@@ -34,6 +34,7 @@ void RequestStats::finishedRequest(int thread_num, TicksClock::Ticks now) {
     LOG(LogMessage::FATAL) << "wrong thread num";
   }
   Counts& counts = counts_[thread_num];
+  counts.seq.writeBegin();
 
   // Has at least one slot expired between the last and this request?
   if (now > counts.base_tick + kTicksPerSlot) {
@@ -61,6 +62,7 @@ void RequestStats::finishedRequest(int thread_num, TicksClock::Ticks now) {
   }
 
   ++counts.val[counts.base_pos];
+  counts.seq.writeEnd();
 }
 
 void RequestStats::getStats(TicksClock::Ticks now,
@@ -73,18 +75,32 @@ void RequestStats::getStats(TicksClock::Ticks now,
 
     const Counts& counts = counts_[i];
 
+    // Copy a consistent snapshot of the thread's counts.
+    uint32_t base_pos;
+    uint64_t base_tick;
+    uint32_t val[kNumSlots];
+    unsigned seq;
+    do {
+      seq = counts.seq.readBegin();
+      base_pos = counts.base_pos;
+      base_tick = counts.base_tick;
+      for (size_t j=0; j<kNumSlots; ++j) {
+        val[j] = counts.val[j];
+      }
+    } while (counts.seq.readRetry(seq));
+
     // If the last request on this thread come in more than a second
     // ago, don't bother checking the thread. Otherwise, accumulate
     // the slots that are within the last second.
-    if (now - counts.base_tick > TicksClock::ticksPerSecond()) {
+    if (now - base_tick > TicksClock::ticksPerSecond()) {
       continue;
     } else {
       // posForTick(now - 1sec) == posForTick(now)
       uint32_t curr_pos = posForTick(now);
       do {
         curr_pos = incPos(curr_pos);
-        reqs_acc += counts.val[curr_pos];
-      } while (curr_pos != counts.base_pos);
+        reqs_acc += val[curr_pos];
+      } while (curr_pos != base_pos);
     }
   }
 
@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <string>
 
+#include "seqlock.hpp"
 #include "ticks_clock.hpp"
 
 namespace base {
@@ -19,13 +20,13 @@ using std::string;
 // Thread Safety:
 //
 //   We assume that finishedRequest(i,...) is only called by the i-th
-//   thread, according to ThreadPoolFast::ME(). Calls to
+//   thread, according to IOManager::workerNum(). Calls to
 //   finishRequest(j,...)  can be done concurrently with the former.
 //
-//   getStats() will be called at any time by some unknow thread. For
-//   the lab4's purposes, we'll assume it can read the internal state
-//   without synchronization (we'll reason about what could happen to
-//   accuracy of the results).
+//   getStats() will be called at any time by some unknow thread. It
+//   reads each thread's counts under that thread's SeqLock, so it
+//   never sees a slot roll-over half done. Recording a request costs
+//   the writer two stores to its own cache line on top of the counts.
 
 class RequestStats {
 public:
@@ -34,7 +35,7 @@ public:
 
   // Records that one request completed 'now'.  The thread calling
   // this should use it's identifier (returned by
-  // ThreadPoolFast::ME())
+  // IOManager::workerNum())
   void finishedRequest(int thread_num, TicksClock::Ticks now);
 
   // Writes the current req/s stats for the second finishing 'now' in
@@ -64,6 +65,7 @@ private:
   // were received in a give slot of time, during a 1 second rolling
   // window of time.
   struct Counts {
+    SeqLock  seq;                   // the owner thread writes under it
     uint32_t base_pos;              // "now" slot in the val array (circular)
     uint64_t base_tick;             // ticks when "now" started
     uint32_t val[kNumSlots];        // partial counts of requests
@@ -0,0 +1,265 @@
+#include <inttypes.h>
+#include <iomanip>
+#include <iostream>
+#include <sched.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "callback.hpp"
+#include "lock.hpp"
+#include "param_map.hpp"
+#include "scalable_rw_mutex.hpp"
+#include "thread.hpp"
+#include "ticks_clock.hpp"
+
+// Contrasts reader-writer locks on read-mostly work. Each of
+// 'threads' threads loops over: picking, at random, a write with
+// probability 'writes' percent or a read otherwise; taking the lock
+// in that mode; reading (or bumping) 'cs' shared words; releasing
+// the lock.
+//
+// For every combination of the sweep parameters, it reports the
+// operations per second across all threads, and how many of them
+// were writes.
+//
+// Usage:
+//   rw_lock_benchmark --locks=rwmutex,scalable --threads=1,2,4,8
+//                     --writes=0,1,10 --cs=10 --duration=0.5
+//
+
+namespace {
+
+using std::cout;
+using std::endl;
+using std::istringstream;
+using std::setw;
+using std::string;
+using std::vector;
+
+using base::Callback;
+using base::makeCallableOnce;
+using base::makeThread;
+using base::ParamMap;
+using base::RWMutex;
+using base::ScalableRWMutex;
+using base::TicksClock;
+
+struct Config {
+  int    threads;
+  int    writes;     // percent of operations that write
+  int    cs;
+  double duration;   // in seconds
+};
+
+// Per-thread counters, each on cache lines of its own.
+struct ThreadStats {
+  uint64_t ops;
+  uint64_t writes;
+  char     pad[64];
+};
+
+template<typename LockType>
+class Contender {
+public:
+  explicit Contender(const Config& config)
+    : config_(config), ready_(0), go_(0), stop_(0) {
+    for (int i = 0; i < kWords; i++) {
+      words_[i] = 0;
+    }
+  }
+
+  // Returns the operations per second; sets '*writes' to the number
+  // of writes done.
+  double run(uint64_t* writes) {
+    vector<ThreadStats*> stats;
+    vector<pthread_t> tids;
+    for (int i = 0; i < config_.threads; i++) {
+      stats.push_back(new ThreadStats);
+      stats.back()->ops = 0;
+      stats.back()->writes = 0;
+      const unsigned seed = i + 1;
+      Callback<void>* body =
+        makeCallableOnce(&Contender::loop, this, stats.back(), seed);
+      tids.push_back(makeThread(body));
+    }
+
+    while (ready_ < config_.threads) {
+      sched_yield();
+    }
+    const TicksClock::Ticks start = TicksClock::getTicks();
+    go_ = 1;
+
+    struct timespec t;
+    t.tv_sec = static_cast<time_t>(config_.duration);
+    t.tv_nsec = static_cast<long>((config_.duration - t.tv_sec) * 1e9);
+    nanosleep(&t, NULL);
+    stop_ = 1;
+
+    uint64_t total = 0;
+    *writes = 0;
+    for (int i = 0; i < config_.threads; i++) {
+      pthread_join(tids[i], NULL);
+      total += stats[i]->ops;
+      *writes += stats[i]->writes;
+      delete stats[i];
+    }
+    const TicksClock::Ticks end = TicksClock::getTicks();
+    return total * TicksClock::ticksPerSecond() / (end - start);
+  }
+
+private:
+  static const int kWords = 64;
+
+  const Config   config_;
+  LockType       lock_;
+  int            ready_;
+  volatile int   go_;
+  volatile int   stop_;
+  uint64_t       words_[kWords];
+
+  void loop(ThreadStats* stats, unsigned seed) {
+    __sync_fetch_and_add(&ready_, 1);
+    while (! go_) {
+      sched_yield();
+    }
+
+    volatile uint64_t sink = 0;
+    while (! stop_) {
+      if (static_cast<int>(rand_r(&seed) % 100) < config_.writes) {
+        lock_.wLock();
+        for (int i = 0; i < config_.cs; i++) {
+          words_[i % kWords]++;
+        }
+        lock_.unlock();
+        stats->writes++;
+      } else {
+        lock_.rLock();
+        for (int i = 0; i < config_.cs; i++) {
+          sink = sink + words_[i % kWords];
+        }
+        lock_.unlock();
+      }
+      stats->ops++;
+    }
+  }
+};
+
+template<typename LockType>
+double contend(const Config& config, uint64_t* writes) {
+  Contender<LockType> contender(config);
+  return contender.run(writes);
+}
+
+// The locks the benchmark knows about. Add new ones here.
+struct LockEntry {
+  const char* name;
+  double (*contend)(const Config& config, uint64_t* writes);
+};
+
+const LockEntry locks[] = {
+  { "rwmutex",  &contend<RWMutex> },
+  { "scalable", &contend<ScalableRWMutex> },
+};
+
+const int num_locks = sizeof(locks) / sizeof(locks[0]);
+
+vector<int> splitInts(const string& list) {
+  vector<int> res;
+  istringstream is(list);
+  string item;
+  while (getline(is, item, ',')) {
+    if (! item.empty()) {
+      res.push_back(atoi(item.c_str()));
+    }
+  }
+  return res;
+}
+
+vector<string> split(const string& list) {
+  vector<string> res;
+  istringstream is(list);
+  string item;
+  while (getline(is, item, ',')) {
+    if (! item.empty()) {
+      res.push_back(item);
+    }
+  }
+  return res;
+}
+
+string defaultThreads() {
+  const int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  std::ostringstream os;
+  os << 1;
+  for (int i = 2; i <= 2 * cpus; i *= 2) {
+    os << "," << i;
+  }
+  return os.str();
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  ParamMap params;
+  params.addParam("locks", "rwmutex,scalable", "csv list of locks to run");
+  params.addParam("threads", defaultThreads(), "csv list of thread counts");
+  params.addParam("writes", "0,1,10", "csv list of write percentages");
+  params.addParam("cs", "10", "shared words touched per operation");
+  params.addParam("duration", "0.2", "seconds per sweep point");
+  if (! params.parseArgv(argc, argv)) {
+    params.printUsage();
+    return -1;
+  }
+
+  string locks_param, threads_param, writes_param, cs_param, duration_param;
+  params.getParam("locks", &locks_param);
+  params.getParam("threads", &threads_param);
+  params.getParam("writes", &writes_param);
+  params.getParam("cs", &cs_param);
+  params.getParam("duration", &duration_param);
+
+  const vector<string> lock_names = split(locks_param);
+  const vector<int> threads = splitInts(threads_param);
+  const vector<int> writes = splitInts(writes_param);
+
+  Config config;
+  config.cs = atoi(cs_param.c_str());
+  config.duration = atof(duration_param.c_str());
+
+  // Calibrate the clock before anything is timed.
+  TicksClock::ticksPerSecond();
+
+  cout << std::left << setw(10) << "lock" << setw(9) << "threads"
+       << setw(8) << "writes%" << setw(14) << "ops/s" << "writes" << endl;
+  for (size_t l = 0; l < lock_names.size(); l++) {
+    const LockEntry* entry = NULL;
+    for (int i = 0; i < num_locks; i++) {
+      if (lock_names[l] == locks[i].name) {
+        entry = &locks[i];
+      }
+    }
+    if (entry == NULL) {
+      std::cerr << "unknown lock " << lock_names[l] << endl;
+      return -1;
+    }
+
+    for (size_t t = 0; t < threads.size(); t++) {
+      for (size_t w = 0; w < writes.size(); w++) {
+        config.threads = threads[t];
+        config.writes = writes[w];
+        uint64_t num_writes;
+        const double ops = entry->contend(config, &num_writes);
+        cout << std::left << setw(10) << entry->name
+             << setw(9) << config.threads << setw(8) << config.writes
+             << setw(14) << static_cast<uint64_t>(ops)
+             << num_writes << endl;
+      }
+    }
+  }
+
+  return 0;
+}
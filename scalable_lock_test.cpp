@@ -0,0 +1,220 @@
+#include <time.h>
+
+#include "callback.hpp"
+#include "cohort_lock.hpp"
+#include "lock.hpp"
+#include "scalable_rw_mutex.hpp"
+#include "spinlock_clh.hpp"
+#include "spinlock_ticket.hpp"
+#include "thread.hpp"
+#include "test_unit.hpp"
+
+namespace {
+
+using base::Callback;
+using base::CohortLock;
+using base::LockGuard;
+using base::makeCallableOnce;
+using base::makeThread;
+using base::ScalableRWMutex;
+using base::SpinlockCLH;
+using base::SpinlockTicket;
+
+// Has 'num_threads' threads increment a counter under 'LockType'
+// guards, optionally taking a second lock inside the first one.
+template<typename LockType>
+class Incrementer {
+public:
+  Incrementer() : counter_(0) { }
+
+  int run(int num_threads, int incs, bool nested) {
+    pthread_t tids[16];
+    for (int i = 0; i < num_threads; i++) {
+      Callback<void>* body =
+        makeCallableOnce(&Incrementer::loop, this, incs, nested);
+      tids[i] = makeThread(body);
+    }
+    for (int i = 0; i < num_threads; i++) {
+      pthread_join(tids[i], NULL);
+    }
+    return counter_;
+  }
+
+private:
+  LockType outer_;
+  LockType inner_;
+  int      counter_;
+
+  void loop(int incs, bool nested) {
+    for (int i = 0; i < incs; i++) {
+      LockGuard<LockType> l(&outer_);
+      if (nested) {
+        LockGuard<LockType> m(&inner_);
+        counter_++;
+      } else {
+        counter_++;
+      }
+    }
+  }
+};
+
+// Takes 'lock' and leaves it.
+struct Waiter {
+  void wait(SpinlockTicket* lock) {
+    lock->lock();
+    lock->unlock();
+  }
+};
+
+// Writers keep two counters equal under the write lock; readers check
+// that they see them equal under the read lock.
+class ReadersWriters {
+public:
+  ReadersWriters() : a_(0), b_(0), torn_(0) { }
+
+  void run(int readers, int writers, int iters) {
+    pthread_t tids[16];
+    int n = 0;
+    for (int i = 0; i < writers; i++) {
+      tids[n++] = makeThread(makeCallableOnce(&ReadersWriters::write, this,
+                                              iters));
+    }
+    for (int i = 0; i < readers; i++) {
+      tids[n++] = makeThread(makeCallableOnce(&ReadersWriters::read, this,
+                                              iters));
+    }
+    for (int i = 0; i < n; i++) {
+      pthread_join(tids[i], NULL);
+    }
+  }
+
+  int a() const    { return a_; }
+  int torn() const { return torn_; }
+
+  void readOnce() {
+    rw_.rLock();
+    rw_.unlock();
+  }
+
+  void writeOnce() {
+    write(1);
+  }
+
+  ScalableRWMutex* rw() { return &rw_; }
+
+private:
+  ScalableRWMutex rw_;
+  volatile int    a_;
+  volatile int    b_;
+  int             torn_;
+
+  void write(int iters) {
+    for (int i = 0; i < iters; i++) {
+      rw_.wLock();
+      a_++;
+      b_++;
+      rw_.unlock();
+    }
+  }
+
+  void read(int iters) {
+    for (int i = 0; i < iters; i++) {
+      rw_.rLock();
+      if (a_ != b_) {
+        __sync_fetch_and_add(&torn_, 1);
+      }
+      rw_.unlock();
+    }
+  }
+};
+
+//
+// Test Cases
+//
+
+TEST(Ticket, Exclusion) {
+  Incrementer<SpinlockTicket> inc;
+  EXPECT_EQ(inc.run(4, 2000, false), 8000);
+}
+
+TEST(Ticket, HasWaiters) {
+  SpinlockTicket lock;
+  lock.lock();
+  EXPECT_FALSE(lock.hasWaiters());
+
+  Waiter waiter;
+  pthread_t tid = makeThread(makeCallableOnce(&Waiter::wait, &waiter, &lock));
+  while (! lock.hasWaiters()) {
+    sched_yield();
+  }
+  lock.unlock();
+  pthread_join(tid, NULL);
+
+  lock.lock();
+  EXPECT_FALSE(lock.hasWaiters());
+  lock.unlock();
+}
+
+TEST(CLH, Exclusion) {
+  Incrementer<SpinlockCLH> inc;
+  EXPECT_EQ(inc.run(4, 2000, false), 8000);
+}
+
+TEST(CLH, Nested) {
+  Incrementer<SpinlockCLH> inc;
+  EXPECT_EQ(inc.run(4, 2000, true), 8000);
+}
+
+TEST(Cohort, Exclusion) {
+  CohortLock lock;
+  EXPECT_GT(lock.numCohorts(), 0);
+
+  Incrementer<CohortLock> inc;
+  EXPECT_EQ(inc.run(4, 2000, false), 8000);
+}
+
+TEST(ScalableRW, Exclusion) {
+  ReadersWriters rws;
+  rws.run(4, 2, 5000);
+  EXPECT_EQ(rws.a(), 10000);
+  EXPECT_EQ(rws.torn(), 0);
+}
+
+TEST(ScalableRW, SharedReads) {
+  // Another thread gets a read lock while this one holds one.
+  ReadersWriters rws;
+  rws.rw()->rLock();
+  pthread_t tid = makeThread(makeCallableOnce(&ReadersWriters::readOnce,
+                                              &rws));
+  pthread_join(tid, NULL);
+  rws.rw()->unlock();
+
+  rws.rw()->wLock();
+  rws.rw()->unlock();
+}
+
+TEST(ScalableRW, NestedReads) {
+  // A thread holding a read lock gets it again even though a writer
+  // is waiting for it to leave.
+  ReadersWriters rws;
+  rws.rw()->rLock();
+  pthread_t tid = makeThread(makeCallableOnce(&ReadersWriters::writeOnce,
+                                              &rws));
+  struct timespec t = { 0, 50 * 1000 * 1000 };
+  nanosleep(&t, NULL);
+
+  rws.rw()->rLock();
+  EXPECT_EQ(rws.a(), 0);
+  rws.rw()->unlock();
+  EXPECT_EQ(rws.a(), 0);
+  rws.rw()->unlock();
+
+  pthread_join(tid, NULL);
+  EXPECT_EQ(rws.a(), 1);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  return RUN_TESTS(argc, argv);
+}
@@ -0,0 +1,187 @@
+#ifndef MCP_BASE_SCALABLE_RW_MUTEX_HEADER
+#define MCP_BASE_SCALABLE_RW_MUTEX_HEADER
+
+#include <sched.h>
+
+#include "futex.hpp"  // cpuRelax
+#include "lock.hpp"
+
+namespace base {
+
+// A reader-biased reader-writer lock, with the same interface as
+// RWMutex. pthread_rwlock keeps one count of readers, so every
+// rLock() and unlock() writes the same cache line, which then
+// bounces among all the reading CPUs. Here, a reader marks its
+// presence in a slot of its own, on a cache line of its own, and
+// only reads the shared 'writer' word, which stays cached everywhere
+// as long as nobody writes.
+//
+// Slots are assigned per thread, not per CPU: a reader has to unmark
+// the slot it marked, and a thread may migrate while it holds the
+// lock. Threads are spread over kSlots slots round-robin; threads
+// sharing a slot share its (atomic) count, which is still correct,
+// just less scalable.
+//
+// A writer takes a mutex that serializes writers, raises the 'writer'
+// flag and waits for every slot to drain. A reader that sees the flag
+// up takes back its mark and waits on the writers' mutex, so readers
+// don't spin while a writer works -- nor hold it off.
+//
+// A thread that already holds a read lock must not back off, though:
+// the writer it would wait for is waiting for it. So each thread
+// counts, in a small table of its own, how deep it holds each lock it
+// reads, and nested rLock()s just go one deeper. The table has room
+// for kMaxHeld locks read at once; past that, nesting a read lock
+// while a writer waits deadlocks.
+//
+// The catch is that wLock() reads all kSlots slots, and the lock
+// takes kSlots cache lines. It suits read-mostly data, like
+// FileCache's map.
+//
+// Thread safety:
+//   + as RWMutex. Read locks may be nested; write locks may not.
+//
+// Usage:
+//   ScalableRWMutex rw;
+//   rw.rLock();   // or rw.wLock();
+//   ... critical section ...
+//   rw.unlock();
+//
+class ScalableRWMutex {
+public:
+  // Number of reader slots. A power of 2.
+  static const int kSlots = 64;
+
+  // Number of locks a thread can hold read locks on at once and still
+  // nest them.
+  static const int kMaxHeld = 8;
+
+  ScalableRWMutex() : writer_(kFree) {
+    for (int i = 0; i < kSlots; i++) {
+      slots_[i].readers = 0;
+    }
+  }
+
+  ~ScalableRWMutex() { }
+
+  void rLock() {
+    Held* held = myHeld(true);
+    if (held != NULL && held->depth > 0) {
+      // Our mark keeps any writer waiting already.
+      held->depth++;
+      return;
+    }
+
+    Slot* slot = &slots_[mySlot()];
+    while (true) {
+      // The atomic add is a full barrier: the mark is visible before
+      // 'writer_' is read, so either the writer sees the mark or
+      // this sees the flag.
+      __sync_fetch_and_add(&slot->readers, 1);
+      if (writer_ == kFree) {
+        if (held != NULL) {
+          held->depth = 1;
+        }
+        return;
+      }
+
+      __sync_fetch_and_sub(&slot->readers, 1);
+      writers_m_.lock();
+      writers_m_.unlock();
+    }
+  }
+
+  void wLock() {
+    writers_m_.lock();
+
+    // Full barrier: raise the flag before reading the slots.
+    __sync_val_compare_and_swap(&writer_, kFree, kDraining);
+    for (int i = 0; i < kSlots; i++) {
+      for (int spins = 0; slots_[i].readers != 0; spins++) {
+        if (spins < kSpins) {
+          cpuRelax();
+        } else {
+          sched_yield();
+        }
+      }
+    }
+    writer_ = kWriting;
+  }
+
+  void unlock() {
+    // Once 'writer_' is kWriting, every reader is gone, and readers
+    // that show up back off without holding the lock. So only the
+    // writer can be unlocking now.
+    if (writer_ == kWriting) {
+      __sync_lock_release(&writer_);  // release barrier; sets kFree
+      writers_m_.unlock();
+      return;
+    }
+    Held* held = myHeld(false);
+    if (held != NULL && --held->depth > 0) {
+      return;
+    }
+    __sync_fetch_and_sub(&slots_[mySlot()].readers, 1);
+  }
+
+private:
+  enum WriterState { kFree = 0, kDraining = 1, kWriting = 2 };
+
+  // Spins waiting for a slot to drain before yielding.
+  static const int kSpins = 1000;
+
+  struct Slot {
+    volatile int readers;
+    char         pad[64 - sizeof(int)];
+  };
+
+  // How deep a thread holds a read lock on 'lock'. Free if 0.
+  struct Held {
+    const ScalableRWMutex* lock;
+    int                    depth;
+  };
+
+  Mutex        writers_m_;    // serializes writers; readers wait on it
+  volatile int writer_;       // a WriterState
+  char         pad_[64 - sizeof(int)];  // keep writer_ off slots_[0]
+  Slot         slots_[kSlots];
+
+  static int mySlot() {
+    static int next_slot = 0;
+    static __thread int slot = -1;
+    if (slot < 0) {
+      slot = __sync_fetch_and_add(&next_slot, 1) & (kSlots - 1);
+    }
+    return slot;
+  }
+
+  // Returns the calling thread's entry for this lock. If there's
+  // none, returns a free one if 'add' is set and the table has room,
+  // or NULL.
+  Held* myHeld(bool add) const {
+    static __thread Held held[kMaxHeld];
+    Held* free = NULL;
+    for (int i = 0; i < kMaxHeld; i++) {
+      if (held[i].depth > 0) {
+        if (held[i].lock == this) {
+          return &held[i];
+        }
+      } else if (free == NULL) {
+        free = &held[i];
+      }
+    }
+    if (! add || free == NULL) {
+      return NULL;
+    }
+    free->lock = this;
+    return free;
+  }
+
+  // Non-copyable, non-assignable
+  ScalableRWMutex(ScalableRWMutex&);
+  ScalableRWMutex& operator=(ScalableRWMutex&);
+};
+
+} // namespace base
+
+#endif // MCP_BASE_SCALABLE_RW_MUTEX_HEADER
@@ -0,0 +1,94 @@
+#ifndef MCP_BASE_SEQLOCK_HEADER
+#define MCP_BASE_SEQLOCK_HEADER
+
+#include "futex.hpp"  // cpuRelax
+
+namespace base {
+
+// A SeqLock lets readers take consistent snapshots of data spanning
+// several words without ever writing to shared memory -- and without
+// ever holding up the writer.
+//
+// The writer bumps a sequence number before and after changing the
+// data, so the sequence is odd while a change is under way. A reader
+// notes the sequence, copies the data and checks the sequence again:
+// if it was odd or it changed, the copy may be torn and the reader
+// retries. Writing costs two plain stores to a line the writer owns
+// anyway; reading costs a retry now and then.
+//
+// The barriers: the writer's stores to the data must not be seen
+// before the first bump nor after the second one; the reader's loads
+// of the data must not happen before the first read of the sequence
+// nor after the second one. x86 keeps stores in order and loads in
+// order, so only the compiler needs holding back there; other CPUs
+// get a full barrier.
+//
+// Restrictions:
+//   + writers must be serialized by the caller. Usually there's a
+//     single writer, e.g. the thread owning a per-thread counter
+//   + readers may see data in any intermediate state before they
+//     validate it. They should only copy it, not follow pointers
+//     in it
+//
+// Usage:
+//   // writer                    // reader
+//   seq.writeBegin();            unsigned s;
+//   a++;                         do {
+//   b += n;                        s = seq.readBegin();
+//   seq.writeEnd();                a_copy = a;
+//                                  b_copy = b;
+//                                } while (seq.readRetry(s));
+//
+class SeqLock {
+public:
+  SeqLock() : seq_(0) { }
+  ~SeqLock() { }
+
+  void writeBegin() {
+    seq_ = seq_ + 1;
+    barrier();
+  }
+
+  void writeEnd() {
+    barrier();
+    seq_ = seq_ + 1;
+  }
+
+  // Returns the sequence to pass to readRetry(), once no write is
+  // under way.
+  unsigned readBegin() const {
+    unsigned seq = seq_;
+    while (seq & 1) {
+      cpuRelax();
+      seq = seq_;
+    }
+    barrier();
+    return seq;
+  }
+
+  // Returns true if the data read since readBegin() returned 'seq'
+  // may be torn.
+  bool readRetry(unsigned seq) const {
+    barrier();
+    return seq_ != seq;
+  }
+
+private:
+  volatile unsigned seq_;
+
+  static void barrier() {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__ ("" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+  }
+
+  // Non-copyable, non-assignable
+  SeqLock(const SeqLock&);
+  SeqLock& operator=(const SeqLock&);
+};
+
+} // namespace base
+
+#endif // MCP_BASE_SEQLOCK_HEADER
@@ -0,0 +1,109 @@
+#include <inttypes.h>
+
+#include "callback.hpp"
+#include "seqlock.hpp"
+#include "thread.hpp"
+#include "test_unit.hpp"
+
+namespace {
+
+using base::makeCallableOnce;
+using base::makeThread;
+using base::SeqLock;
+
+// A writer keeps all the words equal; readers count the snapshots in
+// which they aren't.
+class Words {
+public:
+  static const int kWords = 16;
+
+  Words() : stop_(0), snapshots_(0), torn_(0) {
+    for (int i = 0; i < kWords; i++) {
+      words_[i] = 0;
+    }
+  }
+
+  void write(int iters) {
+    for (int i = 0; i < iters; i++) {
+      seq_.writeBegin();
+      for (int j = 0; j < kWords; j++) {
+        words_[j]++;
+      }
+      seq_.writeEnd();
+    }
+    stop_ = 1;
+  }
+
+  void read() {
+    while (! stop_) {
+      uint64_t copy[kWords];
+      unsigned seq;
+      do {
+        seq = seq_.readBegin();
+        for (int j = 0; j < kWords; j++) {
+          copy[j] = words_[j];
+        }
+      } while (seq_.readRetry(seq));
+
+      for (int j = 1; j < kWords; j++) {
+        if (copy[j] != copy[0]) {
+          __sync_fetch_and_add(&torn_, 1);
+          break;
+        }
+      }
+      __sync_fetch_and_add(&snapshots_, 1);
+    }
+  }
+
+  uint64_t word(int i) const { return words_[i]; }
+  int snapshots() const      { return snapshots_; }
+  int torn() const           { return torn_; }
+
+private:
+  SeqLock      seq_;
+  uint64_t     words_[kWords];
+  volatile int stop_;
+  int          snapshots_;
+  int          torn_;
+};
+
+//
+// Test Cases
+//
+
+TEST(SeqLock, Sequential) {
+  SeqLock seq;
+  unsigned s = seq.readBegin();
+  EXPECT_FALSE(seq.readRetry(s));
+
+  seq.writeBegin();
+  seq.writeEnd();
+  EXPECT_TRUE(seq.readRetry(s));
+
+  s = seq.readBegin();
+  EXPECT_FALSE(seq.readRetry(s));
+}
+
+TEST(SeqLock, ConsistentSnapshots) {
+  Words words;
+  pthread_t readers[3];
+  for (int i = 0; i < 3; i++) {
+    readers[i] = makeThread(makeCallableOnce(&Words::read, &words));
+  }
+  pthread_t writer = makeThread(makeCallableOnce(&Words::write, &words,
+                                                 200000));
+  pthread_join(writer, NULL);
+  for (int i = 0; i < 3; i++) {
+    pthread_join(readers[i], NULL);
+  }
+
+  EXPECT_EQ(words.word(Words::kWords - 1), 200000U);
+  EXPECT_EQ(words.torn(), 0);
+  EXPECT_TRUE(words.snapshots() > 0);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  return RUN_TESTS(argc, argv);
+}
@@ -2,16 +2,28 @@
 #include <sstream>
 
 #include "acceptor.hpp"
+#include "cpu_placement.hpp"
 #include "http_service.hpp"
+#include "memory_pressure.hpp"
 
 using base::AcceptCallback;
+using base::CpuPlacement;
 using base::IOService;
 using base::makeCallableMany;
+using base::MemoryPressure;
+using base::ThreadPoolFast;
 using http::HTTPService;
 
 int main(int argc, char* argv[]) {
-  if (argc != 3) {
-    std::cout << "Usage: " << argv[0] << " <port> <num-threads>" << std::endl;
+  if (argc < 3 || argc > 5) {
+    std::cout << "Usage: " << argv[0] << " <port> <num-threads>"
+              << " [placement [memory-mb]]" << std::endl;
+    std::cout << "  num-threads is a count or a <min>-<max> range for an"
+              << " elastic pool" << std::endl;
+    std::cout << "  placement is none (default), compact, scatter, socket,"
+              << " socket:<n> or a cpu list like 0,2,4" << std::endl;
+    std::cout << "  memory-mb is a <soft> or <soft>-<hard> heap budget;"
+              << " needs myAlloc.so" << std::endl;
     return 1;
   }
 
@@ -20,19 +32,62 @@ int main(int argc, char* argv[]) {
   std::istringstream port_stream(argv[1]);
   port_stream >> http_port;
 
-  // Parse number of threads in IOService.
+  // Parse number of threads in IOService, or their range.
   int num_workers;
+  int max_workers = 0;
+  char dash = 0;
   std::istringstream thread_stream(argv[2]);
-  thread_stream >> num_workers;
+  thread_stream >> num_workers >> dash >> max_workers;
+  if (dash == '-' && (max_workers < num_workers || num_workers < 1)) {
+    std::cout << "Bad thread range " << argv[2] << std::endl;
+    return 1;
+  }
+
+  // Parse where to run the polling thread and the workers.
+  CpuPlacement placement;
+  if (argc >= 4 && ! CpuPlacement::parse(argv[3], &placement)) {
+    std::cout << "Bad placement " << argv[3] << std::endl;
+    return 1;
+  }
+
+  // Parse the heap budget, if any, and hand it to the allocator. A
+  // lone soft limit is also the hard one.
+  if (argc == 5) {
+    size_t soft_mb = 0;
+    size_t hard_mb = 0;
+    char mem_dash = 0;
+    std::istringstream mem_stream(argv[4]);
+    mem_stream >> soft_mb >> mem_dash >> hard_mb;
+    if (mem_dash != '-') {
+      hard_mb = soft_mb;
+    }
+    if (soft_mb == 0 || hard_mb < soft_mb) {
+      std::cout << "Bad memory budget " << argv[4] << std::endl;
+      return 1;
+    }
+    if (! MemoryPressure::instance()->setLimits(soft_mb << 20,
+                                                hard_mb << 20)) {
+      std::cout << "Memory budget ignored; run on myAlloc.so to enforce it"
+                << std::endl;
+    }
+  }
 
   // Setup the protocols. The HTTP server accepts requests to stop the
   // IOService machinery and requests for its stats.
-  IOService io_service(num_workers);
-  HTTPService http_service(http_port, &io_service);
+  IOService* io_service;
+  if (dash == '-') {
+    io_service = new IOService(ThreadPoolFast::Elastic(num_workers,
+                                                       max_workers),
+                               placement);
+  } else {
+    io_service = new IOService(num_workers, placement);
+  }
+  HTTPService http_service(http_port, io_service);
 
   // Loop until IOService is stopped via /quit request against the
   // HTTP Service.
-  io_service.start();
+  io_service->start();
 
+  delete io_service;
   return 0;
 }
@@ -0,0 +1,91 @@
+#ifndef MCP_BASE_SPINLOCK_CLH_HEADER
+#define MCP_BASE_SPINLOCK_CLH_HEADER
+
+#include <sched.h>
+
+#include "fixed_size_pool.hpp"
+#include "futex.hpp"  // cpuRelax
+
+namespace base {
+
+// A CLH queue lock. Like MCS, each waiter spins on a flag of its own
+// and the lock is granted in FIFO order. The queue is implicit: a
+// thread enqueues a node of its own by swapping it into the tail and
+// spins on its predecessor's node, which the latter clears on unlock.
+// The releasing thread then owns its predecessor's node.
+//
+// A waiter that spun kSpins times without being granted the lock
+// yields the CPU between checks, in case the threads ahead of it are
+// waiting for one.
+//
+// Nodes come from FixedSizePool, one per acquisition, so a thread
+// may hold several CLH locks at once.
+//
+// Usage:
+//   SpinlockCLH l;
+//   l.lock();
+//   ... critical section ...
+//   l.unlock();
+//
+class SpinlockCLH {
+public:
+  // Checks of the predecessor before a waiter starts yielding.
+  static const int kSpins = 10000;
+
+  SpinlockCLH() : tail_(new Node(false)), node_(NULL), pred_(NULL) { }
+
+  // REQUIRES: the lock is free.
+  ~SpinlockCLH() { delete tail_; }
+
+  void lock() {
+    Node* node = new Node(true);
+
+    // The swap must not be moved ahead of the write to 'locked'.
+    // __sync_lock_test_and_set is only an acquire barrier for gcc, but
+    // a full one on Intel; a compiler barrier is all we need there.
+    __asm__ __volatile__ ("" ::: "memory");
+    Node* pred = __sync_lock_test_and_set(&tail_, node);
+    for (int spins = 0; pred->loadLockState(); spins++) {
+      if (spins >= kSpins) {
+        sched_yield();
+      } else {
+        cpuRelax();
+      }
+    }
+    __sync_synchronize();
+
+    // Only the holder touches these.
+    node_ = node;
+    pred_ = pred;
+  }
+
+  void unlock() {
+    // Read our nodes before the next holder overwrites them.
+    Node* node = node_;
+    Node* pred = pred_;
+    __sync_lock_release(&node->locked);
+    delete pred;
+  }
+
+private:
+  struct Node : public Pooled<Node> {
+    explicit Node(bool l) : locked(l) { }
+
+    int  locked;
+    char pad[64 - sizeof(int)];   // waiters spin on a line of their own
+
+    int loadLockState() const volatile { return locked; }
+  };
+
+  Node* tail_;
+  Node* node_;   // the holder's node
+  Node* pred_;   // the node the holder waited on
+
+  // Non-copyable, non-assignable
+  SpinlockCLH(SpinlockCLH&);
+  SpinlockCLH& operator=(SpinlockCLH&);
+};
+
+}  // namespace base
+
+#endif  // MCP_BASE_SPINLOCK_CLH_HEADER
@@ -1,7 +0,0 @@
-#include "spinlock_mcs.hpp"
-
-namespace base {
-
-__thread SpinlockMCS::Node* SpinlockMCS::qnode_;
-
-}
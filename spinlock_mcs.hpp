@@ -2,27 +2,69 @@
 #define MCP_BASE_SPINLOCK_MCS_HEADER
 
 #include <cstddef> // NULL
+#include <new>
+#include <sched.h>
+
+#include "fixed_size_pool.hpp"
+#include "futex.hpp"  // cpuRelax
 
 namespace base {
 
+// An MCS queue lock. Waiters queue up in FIFO order, each spinning on
+// a node of its own, which its predecessor clears on unlock.
+//
+// The queue node can be provided by the caller, for instance on the
+// stack through ScopedMCSLock. The node must stay put until the
+// matching unlock(node). Otherwise, lock() draws a node from
+// FixedSizePool's per-thread cache and unlock() returns it. Either way,
+// a thread may hold any number of MCS locks at once.
+//
+// A thread that spun kSpins times -- waiting for the lock, or on
+// unlock for its successor to link in -- yields the CPU between
+// checks, in case the thread it waits on is waiting for a CPU.
+//
+// Usage:
+//   SpinlockMCS l;
+//   {
+//     ScopedMCSLock g(&l);   // node lives in 'g'
+//     ... critical section ...
+//   }
+//
+//   l.lock();                // node from the pool
+//   ... critical section ...
+//   l.unlock();
+//
 class SpinlockMCS {
 public:
-  SpinlockMCS()
-    : tail_(NULL) { }
+  // Checks before a spinning thread starts yielding.
+  static const int kSpins = 10000;
 
-  ~SpinlockMCS() {
-    delete qnode_;
-    qnode_ = NULL;
-  }
+  struct Node {
+    bool locked;
+    Node* next;
 
-  void lock() {
-    if (qnode_ == NULL) {
-      qnode_ = new Node();
+    Node() : locked(true), next(NULL) {}
+
+    bool loadLockState() const volatile {
+      return locked;
     }
-    qnode_->next = NULL;
-    Node* previous = __sync_lock_test_and_set(&tail_, qnode_);
+
+    Node* loadNextState() const volatile {
+      return next;
+    }
+  };
+
+  SpinlockMCS()
+    : tail_(NULL), holder_(NULL) { }
+
+  ~SpinlockMCS() { }
+
+  // Acquires the lock queueing 'node'.
+  void lock(Node* node) {
+    node->next = NULL;
+    Node* previous = __sync_lock_test_and_set(&tail_, node);
     if (previous != NULL) {
-      qnode_->locked = true;
+      node->locked = true;
 
       // Stricly speaking, we need a compiler barrier here if we want
       // to make sure the compiler is not going to reorder the writes
@@ -36,11 +78,11 @@ public:
       // (checking by hand) gcc 4.4 is not reordering these two writes
       // either. In the context of this exercise, that's good enough
       // for us. (C++11 would make expressing the barriers easier.)
-
       // __sync_synchronize();
-
-      previous->next = qnode_;
-      while (qnode_->loadLockState()) {}
+      previous->next = node;
+      for (int spins = 0; node->loadLockState(); spins++) {
+        relax(spins);
+      }
     }
 
     // We want an acquire barrier at this point so that we are sure to
@@ -53,44 +95,70 @@ public:
     __sync_synchronize();
   }
 
-  void unlock() {
-    if (qnode_->next == NULL) {
-      if (__sync_bool_compare_and_swap(&tail_, qnode_, NULL)) {
+  // Releases the lock acquired with 'node'.
+  void unlock(Node* node) {
+    if (node->next == NULL) {
+      if (__sync_bool_compare_and_swap(&tail_, node, NULL)) {
         return;
       }
-      while (qnode_->loadNextState() == NULL) {}
+      for (int spins = 0; node->loadNextState() == NULL; spins++) {
+        relax(spins);
+      }
     }
 
-    // We want to set qnode_->next->locked to false. We use gcc's
+    // We want to set node->next->locked to false. We use gcc's
     // atomic-write-0-with-a-release-barrier here, since that's
     // exactly what we want.
-    __sync_lock_release(&qnode_->next->locked);
+    __sync_lock_release(&node->next->locked);
   }
 
-private:
-  struct Node {
-    bool locked;
-    Node* next;
-
-    Node() : locked(true), next(NULL) {}
+  void lock() {
+    void* mem = FixedSizePool<sizeof(Node)>::allocate();
+    Node* node = new (mem) Node();
+    lock(node);
 
-    bool loadLockState() const volatile {
-      return locked;
-    }
+    // Only the holder touches 'holder_'.
+    holder_ = node;
+  }
 
-    Node* loadNextState() const volatile {
-      return next;
-    }
-  };
+  void unlock() {
+    Node* node = holder_;
+    unlock(node);
+    FixedSizePool<sizeof(Node)>::release(node);
+  }
 
+private:
   Node* tail_;
-  static __thread Node* qnode_;
+  Node* holder_;   // node of the holder that used lock()
+
+  static void relax(int spins) {
+    if (spins >= kSpins) {
+      sched_yield();
+    } else {
+      cpuRelax();
+    }
+  }
 
   // Non-copyable, non-assignable
   SpinlockMCS(SpinlockMCS&);
   SpinlockMCS& operator=(SpinlockMCS&);
 };
 
+// Holds a SpinlockMCS for its scope, queueing a node of its own.
+class ScopedMCSLock {
+public:
+  explicit ScopedMCSLock(SpinlockMCS* lock) : l_(lock) { l_->lock(&node_); }
+  ~ScopedMCSLock()   { l_->unlock(&node_); }
+
+private:
+  SpinlockMCS*      l_;
+  SpinlockMCS::Node node_;
+
+  // Non-copyable, non-assignable
+  ScopedMCSLock(ScopedMCSLock&);
+  ScopedMCSLock& operator=(ScopedMCSLock&);
+};
+
 }  // namespace base
 
 #endif // MCP_BASE_SPINLOCK_MCS_HEADER
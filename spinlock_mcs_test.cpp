@@ -16,6 +16,7 @@ using base::Barrier;
 using base::Callback;
 using base::makeCallableOnce;
 using base::makeThread;
+using base::ScopedMCSLock;
 using base::Spinlock;
 using base::SpinlockMCS;
 
@@ -97,6 +98,45 @@ TEST(Concurrency, Fairness) {
   }
 }
 
+// Increments a counter holding two MCS locks: the outer one with a
+// node on the stack, the inner one with a pooled node.
+struct Nester {
+  Nester() : counter(0) { }
+
+  void run(int incs) {
+    for (int i = 0; i < incs; i++) {
+      ScopedMCSLock g(&outer);
+      inner.lock();
+      counter++;
+      inner.unlock();
+    }
+  }
+
+  SpinlockMCS outer;
+  SpinlockMCS inner;
+  int         counter;
+};
+
+TEST(Nesting, TwoLocksHeld) {
+  const int NUM_THREADS = 4;
+  const int INCS = 2000;
+
+  Nester nester;
+  pthread_t tids[NUM_THREADS];
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    tids[i] = makeThread(makeCallableOnce(&Nester::run, &nester, INCS));
+  }
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    pthread_join(tids[i], NULL);
+  }
+  EXPECT_EQ(nester.counter, NUM_THREADS * INCS);
+
+  // The locks are free and usable from this thread too.
+  ScopedMCSLock g(&nester.inner);
+  nester.outer.lock();
+  nester.outer.unlock();
+}
+
 }  // unnamed namespace
 
 int main(int argc, char* argv[]) {
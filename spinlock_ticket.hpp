@@ -0,0 +1,86 @@
+#ifndef MCP_BASE_SPINLOCK_TICKET_HEADER
+#define MCP_BASE_SPINLOCK_TICKET_HEADER
+
+#include <sched.h>
+
+#include "futex.hpp"  // cpuRelax
+
+namespace base {
+
+// A ticket lock with proportional backoff. lock() takes the next
+// ticket and waits until it is served, so the lock is granted in FIFO
+// order. While waiting, a thread pauses for a time proportional to
+// how many tickets are ahead of it instead of hammering the
+// 'serving' word, which every waiter reads. A waiter that still isn't
+// served after kSpinRounds rounds yields the CPU between rounds: with
+// more threads than CPUs, the thread holding the next ticket may be
+// the one waiting for a CPU.
+//
+// The lock isn't tied to a thread: any thread may unlock() it, which
+// CohortLock relies on.
+//
+// Usage:
+//   SpinlockTicket l;
+//   l.lock();
+//   ... critical section ...
+//   l.unlock();
+//
+class SpinlockTicket {
+public:
+  // Pause iterations per ticket ahead of the waiter.
+  static const unsigned kBackoffUnit = 32;
+
+  // Backoff rounds before a waiter starts yielding.
+  static const int kSpinRounds = 100;
+
+  SpinlockTicket() : next_(0), serving_(0) { }
+  ~SpinlockTicket() { }
+
+  void lock() {
+    const unsigned ticket = __sync_fetch_and_add(&next_, 1);
+    for (int round = 0; ; round++) {
+      const unsigned ahead = ticket - loadServing();
+      if (ahead == 0) {
+        break;
+      }
+      if (round >= kSpinRounds) {
+        sched_yield();
+      }
+      for (unsigned i = 0; i < ahead * kBackoffUnit; i++) {
+        cpuRelax();
+      }
+    }
+
+    // Acquire barrier: see the writes of the previous critical
+    // section. (A full one is more than needed.)
+    __sync_synchronize();
+  }
+
+  void unlock() {
+    // Only the holder writes 'serving_'; the atomic add doubles as
+    // the release barrier.
+    __sync_fetch_and_add(&serving_, 1);
+  }
+
+  // Returns true if other threads are waiting for the lock. Only
+  // meaningful when called by the holder.
+  bool hasWaiters() const {
+    return loadNext() - loadServing() > 1;
+  }
+
+private:
+  unsigned next_;
+  char     pad_[64 - sizeof(unsigned)];  // keep waiters' reads off next_
+  unsigned serving_;
+
+  unsigned loadNext() const volatile    { return next_; }
+  unsigned loadServing() const volatile { return serving_; }
+
+  // Non-copyable, non-assignable
+  SpinlockTicket(SpinlockTicket&);
+  SpinlockTicket& operator=(SpinlockTicket&);
+};
+
+}  // namespace base
+
+#endif  // MCP_BASE_SPINLOCK_TICKET_HEADER
@@ -1,4 +1,5 @@
 #include <stdio.h>  // perror
+#include <sched.h>  // cpu_set_t
 #include <stdlib.h> // exit
 
 #include "logging.hpp"
@@ -16,10 +17,26 @@ static void* threadFunction(void* arg) {
   return 0;
 }
 
-pthread_t makeThread(Callback<void>* body) {
+pthread_t makeThread(Callback<void>* body, int cpu) {
   void* arg = reinterpret_cast<void*>(body);
   pthread_t tid;
-  if (pthread_create(&tid, NULL, threadFunction, arg) != 0) {
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+  }
+
+  int res = pthread_create(&tid, &attr, threadFunction, arg);
+  if (res != 0 && cpu >= 0) {
+    // Most likely 'cpu' is not one we may run on.
+    LOG(LogMessage::WARNING) << "Can't pin thread to cpu " << cpu;
+    res = pthread_create(&tid, NULL, threadFunction, arg);
+  }
+  pthread_attr_destroy(&attr);
+  if (res != 0) {
     LOG(LogMessage::FATAL) << "Can't create thread";
     return -1;
   }
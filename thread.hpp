@@ -36,8 +36,11 @@ using base::Callback;
 // latter onwership is determined by whether the callback is call-once
 // or not. Internally, 'body' is only invoked once.
 //
+// If 'cpu' is not -1, the thread is created pinned to that CPU (see
+// CpuPlacement). If it can't be pinned, it runs unpinned.
+//
 // If a thread cannot be created, this call will exit()
-pthread_t makeThread(Callback<void>* body);
+pthread_t makeThread(Callback<void>* body, int cpu = -1);
 
 }  // namespace base
 
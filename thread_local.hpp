@@ -1,8 +1,11 @@
 #ifndef MCP_BASE_THREAD_LOCAL_HEADER
 #define MCP_BASE_THREAD_LOCAL_HEADER
 
-#include "pthread.h"
-#include "string.h"
+#include <new>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "callback.hpp"
 
 namespace base {
 
@@ -10,6 +13,17 @@ namespace base {
 // Storage. Each thread accessing a ThreadLocal<T> will have its own
 // instance of T.
 //
+// Each thread's instance lives in a slot of its own, on cache lines
+// of its own, so threads updating their instances don't false-share.
+// There's no bound on the number of threads. When a thread exits, its
+// slot goes back to the ThreadLocal and is handed, reset to T(), to
+// the next thread that needs one.
+//
+// forEach() visits the instances of all the threads alive, e.g. to
+// sum per-thread counters. The visit races with the owners updating
+// their instances; it's up to T to make that safe (say, with atomic
+// updates or a SeqLock).
+//
 // The class is thread-safe.
 //
 // usage:
@@ -22,15 +36,15 @@ namespace base {
 //   void HasALocal::aMethod() {
 //     my_local_.setVal(<value for this thread>);
 //
-#define MAXNUMOFTHREADS 16
-
 template<typename T>
 class ThreadLocal {
 public:
   // Sets up a key by which this local storage is known and sets
   // 'destroyLocalKey' to be run at each thread exit.
   ThreadLocal();
-  ~ThreadLocal() {}
+
+  // Frees all the slots. REQUIRES: no thread uses this anymore.
+  ~ThreadLocal();
 
   // Releases resources used by a thread that had local storage. Called
   // automatically when that thread exited.
@@ -47,47 +61,140 @@ public:
 
   // Stores 'val' into the local storage for the caller's thread.
   void setVal(const T& val);
-  // Get base addr of 'storageArr[]', for testing
-  const T* getBaseAddr() const { return storageArr; }
+
+  // Issues 'cb' on the address of the instance of each live thread
+  // that used this ThreadLocal. Threads can't start or exit using it
+  // meanwhile. 'cb' is not owned and must be a many-callback.
+  void forEach(Callback<void, T*>* cb);
 
 private:
+  static const size_t kLineSize = 64;
+
+  // A thread's instance. 'val' comes first, so a T* is a Slot*.
+  struct Slot {
+    T            val;
+    ThreadLocal* owner;
+    Slot*        prev;   // in the live or the free list
+    Slot*        next;
+  };
+
+  // sizeof(Slot) rounded up to whole cache lines.
+  static const size_t kSlotSize =
+    (sizeof(Slot) + kLineSize - 1) / kLineSize * kLineSize;
+
   // Pthread "key" by which this variable is going to be known.
-  mutable pthread_key_t local_key_;
-  mutable T             storageArr[MAXNUMOFTHREADS];
-  int                   curavail_slot_;
+  pthread_key_t   local_key_;
+
+  pthread_mutex_t m_;       // protects the lists below
+  Slot*           live_;    // slots of running threads
+  Slot*           free_;    // slots of exited threads
 
   // If the calling thread has already allocated its private instance
   // of T, then return that address. Otherwise, allocate a new
   // instance first.
   T* getLocalState();
 
+  // Takes a slot from the free list or from the heap, and puts it in
+  // the live list.
+  Slot* acquireSlot();
+
+  // Moves 'slot' from the live list to the free list.
+  void releaseSlot(Slot* slot);
+
+  static void freeSlots(Slot* list);
+
   // Non-copyable, non-assignable
   ThreadLocal(const ThreadLocal&);
   ThreadLocal& operator=(const ThreadLocal&);
 };
 
 template<typename T>
-ThreadLocal<T>::ThreadLocal() : curavail_slot_(0) {
-  memset(storageArr, 0x0, MAXNUMOFTHREADS * sizeof(T));
+ThreadLocal<T>::ThreadLocal() : live_(NULL), free_(NULL) {
+  pthread_mutex_init(&m_, NULL);
   pthread_key_create(&local_key_, destroyLocalKey);
 }
 
+template<typename T>
+ThreadLocal<T>::~ThreadLocal() {
+  // Threads exiting from now on don't call back into this.
+  pthread_key_delete(local_key_);
+  freeSlots(live_);
+  freeSlots(free_);
+  pthread_mutex_destroy(&m_);
+}
+
 template<typename T>
 void ThreadLocal<T>::destroyLocalKey(void* thread_state) {
   if (thread_state != NULL) {
-    T* p = reinterpret_cast<T*>(thread_state);
-    *p = 0;   // Delete is reset to zero
+    Slot* slot = reinterpret_cast<Slot*>(thread_state);
+    slot->owner->releaseSlot(slot);
   }
 }
 
 template<typename T>
 T* ThreadLocal<T>::getLocalState() {
-  T* local_state = reinterpret_cast<T*>(pthread_getspecific(local_key_));
-  if (local_state == NULL) {
-    local_state = storageArr + __sync_fetch_and_add(&curavail_slot_, 0x1);
-    pthread_setspecific(local_key_, local_state);
+  Slot* slot = reinterpret_cast<Slot*>(pthread_getspecific(local_key_));
+  if (slot == NULL) {
+    slot = acquireSlot();
+    pthread_setspecific(local_key_, slot);
+  }
+  return &slot->val;
+}
+
+template<typename T>
+typename ThreadLocal<T>::Slot* ThreadLocal<T>::acquireSlot() {
+  pthread_mutex_lock(&m_);
+  Slot* slot = free_;
+  if (slot != NULL) {
+    free_ = slot->next;
+  } else {
+    void* p = NULL;
+    if (posix_memalign(&p, kLineSize, kSlotSize) != 0) {
+      pthread_mutex_unlock(&m_);
+      throw std::bad_alloc();
+    }
+    slot = static_cast<Slot*>(p);
+    new (&slot->val) T();
+    slot->owner = this;
+  }
+
+  slot->prev = NULL;
+  slot->next = live_;
+  if (live_ != NULL) {
+    live_->prev = slot;
+  }
+  live_ = slot;
+  pthread_mutex_unlock(&m_);
+  return slot;
+}
+
+template<typename T>
+void ThreadLocal<T>::releaseSlot(Slot* slot) {
+  pthread_mutex_lock(&m_);
+  if (slot->prev != NULL) {
+    slot->prev->next = slot->next;
+  } else {
+    live_ = slot->next;
+  }
+  if (slot->next != NULL) {
+    slot->next->prev = slot->prev;
+  }
+
+  slot->val = T();
+  slot->prev = NULL;
+  slot->next = free_;
+  free_ = slot;
+  pthread_mutex_unlock(&m_);
+}
+
+template<typename T>
+void ThreadLocal<T>::freeSlots(Slot* list) {
+  while (list != NULL) {
+    Slot* slot = list;
+    list = list->next;
+    slot->val.~T();
+    free(slot);
   }
-  return local_state;
 }
 
 template<typename T>
@@ -106,6 +213,15 @@ T* ThreadLocal<T>::getAddr() {
   return getLocalState();
 }
 
+template<typename T>
+void ThreadLocal<T>::forEach(Callback<void, T*>* cb) {
+  pthread_mutex_lock(&m_);
+  for (Slot* slot = live_; slot != NULL; slot = slot->next) {
+    (*cb)(&slot->val);
+  }
+  pthread_mutex_unlock(&m_);
+}
+
 }  // namespace base
 
 #endif // MCP_BASE_THREAD_LOCAL_HEADER
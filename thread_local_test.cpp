@@ -1,4 +1,5 @@
 #include <iostream>
+#include <stdint.h>
 
 #include "callback.hpp"
 #include "lock.hpp"
@@ -11,9 +12,11 @@ namespace {
 using std::cout;
 using base::Callback;
 using base::ConditionVar;
+using base::makeCallableMany;
 using base::makeCallableOnce;
 using base::makeThread;
 using base::Mutex;
+using base::Notification;
 using base::ScopedLock;
 using base::ThreadLocal;
 
@@ -28,9 +31,8 @@ public:
   // Fills in 'p' with the address of the integer for this thread and
   // writes 'val' to it. Blocks until stop() is called.
   void init(int** p, int val) {
-    if (local_.getVal() == 0) {
-      int index = local_.getAddr() - local_.getBaseAddr();
-      cout << "TLS init to 0!\tIndex: " << index << "\n";
+    if (local_.getVal() != 0) {
+      cout << "TLS not initialized to 0!\n";
     }
     *p = local_.getAddr();
     local_.setVal(val);
@@ -74,6 +76,37 @@ private:
   bool             stopped_;      // if stop() was called
 };
 
+// Sums the values forEach() visits.
+struct Summer {
+  Summer() : sum(0), visits(0) { }
+  void add(int* val) { sum += *val; visits++; }
+
+  int sum;
+  int visits;
+};
+
+// Sets a thread's local and, if asked to, waits to be released
+// before exiting.
+struct LocalUser {
+  explicit LocalUser(ThreadLocal<int>* l) : local(l), reset_seen(0) { }
+
+  void set(int val, bool wait) {
+    if (local->getVal() != 0) {
+      __sync_fetch_and_add(&reset_seen, 1);
+    }
+    local->setVal(val);
+    if (wait) {
+      started.notify();
+      release.wait();
+    }
+  }
+
+  ThreadLocal<int>* local;
+  int               reset_seen;   // threads that found a stale value
+  Notification      started;
+  Notification      release;
+};
+
 //
 // Test Cases
 //
@@ -126,6 +159,82 @@ TEST(Basics, PointerType) {
   delete new_int;
 }
 
+TEST(Basics, ManyThreads) {
+  // More threads than the old fixed-size slot array had room for.
+  Tester tester;
+  const int NUM_THREADS = 40;
+  int* ints[NUM_THREADS];
+  pthread_t tids[NUM_THREADS];
+  for (int i=0; i<NUM_THREADS; i++) {
+    Callback<void>* c = makeCallableOnce(&Tester::init, &tester, &ints[i], i);
+    tids[i] = makeThread(c);
+  }
+
+  tester.waitOnCounter(NUM_THREADS);
+  for (int i=0; i<NUM_THREADS; i++) {
+    EXPECT_EQ(*ints[i], i);
+    if (i > 0) {
+      // Slots never share a cache line.
+      const char* a = reinterpret_cast<const char*>(ints[i-1]);
+      const char* b = reinterpret_cast<const char*>(ints[i]);
+      EXPECT_TRUE(a - b >= 64 || b - a >= 64);
+      EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % 64, 0U);
+    }
+  }
+
+  tester.stop();
+  for (int i=0; i<NUM_THREADS; i++) {
+    pthread_join(tids[i], NULL);
+  }
+}
+
+TEST(Recycling, SlotsAreResetAndReused) {
+  ThreadLocal<int> local;
+  LocalUser user(&local);
+  for (int i=0; i<50; i++) {
+    pthread_t tid = makeThread(makeCallableOnce(&LocalUser::set, &user,
+                                                i + 1, false));
+    pthread_join(tid, NULL);
+  }
+  EXPECT_EQ(user.reset_seen, 0);
+
+  // Only this thread is alive now; the exited threads' slots are gone
+  // from forEach().
+  local.setVal(7);
+  Summer summer;
+  Callback<void, int*>* cb = makeCallableMany(&Summer::add, &summer);
+  local.forEach(cb);
+  EXPECT_EQ(summer.visits, 1);
+  EXPECT_EQ(summer.sum, 7);
+  delete cb;
+}
+
+TEST(ForEach, VisitsLiveThreads) {
+  ThreadLocal<int> local;
+  const int NUM_THREADS = 4;
+  LocalUser* users[NUM_THREADS];
+  pthread_t tids[NUM_THREADS];
+  for (int i=0; i<NUM_THREADS; i++) {
+    users[i] = new LocalUser(&local);
+    tids[i] = makeThread(makeCallableOnce(&LocalUser::set, users[i],
+                                          10 * (i + 1), true));
+    users[i]->started.wait();
+  }
+
+  Summer summer;
+  Callback<void, int*>* cb = makeCallableMany(&Summer::add, &summer);
+  local.forEach(cb);
+  EXPECT_EQ(summer.visits, NUM_THREADS);
+  EXPECT_EQ(summer.sum, 100);
+
+  for (int i=0; i<NUM_THREADS; i++) {
+    users[i]->release.notify();
+    pthread_join(tids[i], NULL);
+    delete users[i];
+  }
+  delete cb;
+}
+
 }  // unnamed namespace
 
 int main(int argc, char *argv[]) {
@@ -1,13 +1,72 @@
 #ifndef MCP_BASE_THREAD_POOL_HEADER
 #define MCP_BASE_THREAD_POOL_HEADER
 
+#include <vector>
+
 #include "callback.hpp"
+#include "log_histogram.hpp"
+#include "seqlock.hpp"
+#include "ticks_clock.hpp"
 
 namespace base {
 
+using std::vector;
+
+// What one worker of a pool spent its time on. All times are in
+// TicksClock ticks. Each worker only writes its own WorkerStats.
+struct WorkerStats {
+  LogHistogram queue_delay;  // from the task being added to it starting
+  LogHistogram run_time;     // running the task
+  LogHistogram idle_time;    // gaps between tasks
+  uint64_t     busy_ticks;   // total run_time
+  uint64_t     idle_ticks;   // total idle_time
+
+  WorkerStats() : busy_ticks(0), idle_ticks(0) { }
+
+  // Returns the fraction of time the worker was running tasks.
+  double utilization() const {
+    const uint64_t total = busy_ticks + idle_ticks;
+    return total ? double(busy_ticks) / total : 0.0;
+  }
+};
+
+// A worker's WorkerStats, which the worker updates under 'seq' so that
+// getWorkerStats() can copy them consistently while it runs.
+struct WorkerStatsSlot {
+  SeqLock     seq;
+  WorkerStats stats;
+
+  // Records a task added at 'queued_at' that ran from 'start' to
+  // 'end', the worker having been idle since 'idle_since'. Only the
+  // worker may call it.
+  void record(TicksClock::Ticks queued_at, TicksClock::Ticks idle_since,
+              TicksClock::Ticks start, TicksClock::Ticks end) {
+    seq.writeBegin();
+    stats.queue_delay.record(start - queued_at);
+    stats.run_time.record(end - start);
+    stats.idle_time.record(start - idle_since);
+    stats.busy_ticks += end - start;
+    stats.idle_ticks += start - idle_since;
+    seq.writeEnd();
+  }
+
+  // Copies the stats into 'copy'. Any thread may call it.
+  void read(WorkerStats* copy) const {
+    unsigned s;
+    do {
+      s = seq.readBegin();
+      *copy = stats;
+    } while (seq.readRetry(s));
+  }
+};
+
 // Abstract base class for experimenting with thread-pool strategies.
 class ThreadPool {
 public:
+  // Priority classes of a task, most urgent first.
+  enum Priority { PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW,
+                  NUM_PRIORITIES };
+
   // Cleans up any pending callbacks that weren't executed. Pending
   // callbacks may have been added after stop() was called if a running
   // worker issued new addTask()s.
@@ -18,6 +77,25 @@ public:
   // Requests the execution of 'task' on an undetermined worker thread.
   virtual void addTask(Callback<void>* task) = 0;
 
+  // Requests the execution of 'task' in the 'priority' class. If
+  // 'deadline' (in TicksClock ticks; 0 for none) passes while the task
+  // is still queued, the pool may demote or shed it. Pools without
+  // priority lanes ignore both and run it as a plain addTask().
+  virtual void addPriorityTask(Callback<void>* task,
+                               Priority priority,
+                               TicksClock::Ticks deadline = 0) {
+    addTask(task);
+  }
+
+  // Requests the execution of the 'n' callbacks in 'tasks'. Pools
+  // override this to queue the whole batch with one synchronization
+  // step and to wake up no more workers than the batch needs.
+  virtual void addTasks(Callback<void>** tasks, int n) {
+    for (int i = 0; i < n; i++) {
+      addTask(tasks[i]);
+    }
+  }
+
   // Waits for all the workers to finish processing the ongoing tasks
   // and stop then stop the pool. This call may be issued from within
   // a worker thread itself.
@@ -27,6 +105,14 @@ public:
 
   // Returns the current size of the dispatch queue (pending tasks).
   virtual int count() const = 0;
+
+  // Copies the stats of each worker into 'stats', indexed by worker
+  // id. The workers aren't stopped for it, so the copy may miss the
+  // tasks finishing meanwhile. Pools that aren't instrumented leave
+  // 'stats' empty.
+  virtual void getWorkerStats(vector<WorkerStats>* stats) const {
+    stats->clear();
+  }
 };
 
 } // namespace base
@@ -1,11 +1,17 @@
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <sched.h>
 #include <sstream>
+#include <time.h>
 #include <unistd.h>
+#include <vector>
 
 #include "callback.hpp"
+#include "parallel.hpp"
 #include "thread_pool_normal.hpp"
 #include "thread_pool_fast.hpp"
+#include "thread_pool_stealing.hpp"
 #include "timer.hpp"
 
 namespace {
@@ -15,11 +21,14 @@ using std::endl;
 using std::istringstream;
 using std::left;
 using std::setw;
+using std::vector;
 
 using base::Callback;
 using base::makeCallableMany;
+using base::parallelReduce;
 using base::ThreadPoolNormal;
 using base::ThreadPoolFast;
+using base::ThreadPoolStealing;
 using base::Timer;
 
 const int NUM_THREADS = 24;
@@ -131,13 +140,145 @@ void SlowConsumer() {
   std::cout << std::endl;
 }
 
+// Records when the task started running.
+struct Handoff {
+  Handoff() : done(0) { }
+
+  void run() {
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    __sync_synchronize();
+    done = 1;
+  }
+
+  struct timespec started;
+  volatile int    done;
+};
+
+double microsBetween(const struct timespec& from, const struct timespec& to) {
+  return (to.tv_sec - from.tv_sec) * 1e6 + (to.tv_nsec - from.tv_nsec) / 1e3;
+}
+
+// Measures the time between addTask() and the task starting on a
+// worker, one task at a time. The pool is left idle for a while
+// before each handoff, so a worker may be spinning (short idle times)
+// or parked (long ones) when the task arrives.
+template<typename PoolType>
+void HandoffLatency() {
+  const int NUM_HANDOFFS = 2000;
+  const int NUM_IDLES = 3;
+  const int idle_us[NUM_IDLES] = { 0, 50, 1000 };
+
+  std::cout << "Handoff p50/p99 (us) idle 0/50/1000us:	";
+
+  for (int j = 0; j < NUM_IDLES; j++) {
+    PoolType* pool = new PoolType(4);
+    Handoff* handoff = new Handoff;
+    Callback<void>* task = makeCallableMany(&Handoff::run, handoff);
+
+    vector<double> latencies;
+    for (int i = 0; i < NUM_HANDOFFS; i++) {
+      if (idle_us[j] > 0) {
+        usleep(idle_us[j]);
+      }
+      handoff->done = 0;
+      struct timespec added;
+      clock_gettime(CLOCK_MONOTONIC, &added);
+      pool->addTask(task);
+      while (! handoff->done) {
+        sched_yield();
+      }
+      latencies.push_back(microsBetween(added, handoff->started));
+    }
+    pool->stop();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << std::setprecision(3)
+              << latencies[NUM_HANDOFFS / 2] << "/"
+              << latencies[NUM_HANDOFFS * 99 / 100] << "  ";
+
+    delete task;
+    delete handoff;
+    delete pool;
+  }
+
+  std::cout << std::endl;
+}
+
+// Sums an array chunk by chunk.
+struct ArraySum {
+  explicit ArraySum(size_t n) : values(n) {
+    for (size_t i = 0; i < n; i++) {
+      values[i] = i * 0.5;
+    }
+  }
+
+  double sum(size_t begin, size_t end) {
+    double res = 0.0;
+    for (size_t i = begin; i < end; i++) {
+      res += values[i];
+    }
+    return res;
+  }
+
+  double add(double a, double b) { return a + b; }
+
+  vector<double> values;
+};
+
+// Times parallelReduce() over a large array: first with no pool (the
+// caller alone), then with growing pools.
+template<typename PoolType>
+void ParallelSum() {
+  const size_t NUM_ELEMS = 1 << 24;
+  const size_t GRAIN = 1 << 14;
+  const int NUM_ROUNDS = 10;
+
+  std::cout << "Parallel Sum (no pool, 4.." << NUM_THREADS << "):\t";
+
+  ArraySum* array = new ArraySum(NUM_ELEMS);
+  Callback<double, size_t, size_t>* sum =
+    makeCallableMany(&ArraySum::sum, array);
+  Callback<double, double, double>* add =
+    makeCallableMany(&ArraySum::add, array);
+
+  int num_threads = 0;
+  while (num_threads <= NUM_THREADS) {
+    PoolType* pool = num_threads > 0 ? new PoolType(num_threads) : NULL;
+
+    Timer timer;
+    timer.start();
+
+    double total = 0.0;
+    for (int i = 0; i < NUM_ROUNDS; i++) {
+      total += parallelReduce(pool, 0, NUM_ELEMS, GRAIN, 0.0, sum, add);
+    }
+
+    timer.end();
+    std::cout << std::setw(8) << std::left << timer.elapsed() << " ";
+
+    if (pool != NULL) {
+      pool->stop();
+      delete pool;
+    }
+
+    num_threads += 4;
+  }
+
+  delete sum;
+  delete add;
+  delete array;
+
+  std::cout << std::endl;
+}
+
 }  // unnamed namespace
 
 void usage(int argc, char* argv[]) {
-  std::cout << "Usage: " << argv[0] << " [1 | 2]" << std::endl;
+  std::cout << "Usage: " << argv[0] << " [1 | 2 | 3]" << std::endl;
   std::cout << "  1 is normal thread pool" << std::endl;
   std::cout << "  2 is fast thread pool" << std::endl;
-  std::cout << "  defaul is to run both " << std::endl;
+  std::cout << "  3 is work-stealing thread pool" << std::endl;
+  std::cout << "  default is to run all three" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
@@ -149,7 +290,7 @@ int main(int argc, char* argv[]) {
     istringstream is(argv[1]);
     int i = 0;
     is >> i;
-    if (i>0 && i<=4) {
+    if (i>0 && i<=3) {
       num[i-1] = true;
     } else {
       usage(argc, argv);
@@ -167,6 +308,9 @@ int main(int argc, char* argv[]) {
   if (all || num[1]) {
     FastConsumer<ThreadPoolFast>();
   }
+  if (all || num[2]) {
+    FastConsumer<ThreadPoolStealing>();
+  }
 
   // force queue building
   if (all || num[0]) {
@@ -175,6 +319,31 @@ int main(int argc, char* argv[]) {
   if (all || num[1]) {
     SlowConsumer<ThreadPoolFast>();
   }
+  if (all || num[2]) {
+    SlowConsumer<ThreadPoolStealing>();
+  }
+
+  // one task at a time, from an idle pool
+  if (all || num[0]) {
+    HandoffLatency<ThreadPoolNormal>();
+  }
+  if (all || num[1]) {
+    HandoffLatency<ThreadPoolFast>();
+  }
+  if (all || num[2]) {
+    HandoffLatency<ThreadPoolStealing>();
+  }
+
+  // one big reduction, split over the workers and the caller
+  if (all || num[0]) {
+    ParallelSum<ThreadPoolNormal>();
+  }
+  if (all || num[1]) {
+    ParallelSum<ThreadPoolFast>();
+  }
+  if (all || num[2]) {
+    ParallelSum<ThreadPoolStealing>();
+  }
 
   return 0;
 }
@@ -1,9 +1,14 @@
+#include <algorithm>
 #include <cstdlib>
+#include <errno.h>
+#include <pthread.h>
 #include <sys/time.h>  // gettimeofday
 
 #include "callback.hpp"
+#include "futex.hpp"
 #include "logging.hpp"
 #include "thread.hpp"
+#include "thread_local.hpp"
 
 #include "thread_pool_fast.hpp"
 
@@ -11,14 +16,36 @@ namespace base {
 
 using base::Callback;
 using base::makeCallableOnce;
+using base::ThreadLocal;
+using std::find;
 
 static __thread bool last_worker_ = false;
 
-ThreadLocal<int> ThreadPoolFast::worker_num_;
+// Worker id of the calling thread. Elastic pools start and retire
+// threads all the time; ThreadLocal recycles the slots of the ones
+// that exited.
+static ThreadLocal<int> worker_num_;
 
 //
 // Internal Worker Class
 //
+// A worker waiting for a task first spins for a while and only then
+// parks on a futex. Handing a task to a spinning worker is just a
+// store; only a parked worker costs the submitter a futex wake (and
+// the worker a context switch).
+//
+// The spin budget adapts: it doubles whenever spinning caught the
+// next task, and halves whenever the worker had to park anyway. A
+// busy worker, whose tasks come back to back, spins; an idle one
+// quickly goes back to parking right away.
+//
+// In an elastic pool, parking is bounded by the pool's idle timeout,
+// after which the worker asks to retire.
+//
+// Each worker records its queue delays, run times and idle gaps in the
+// WorkerStats of its id. Only that worker writes there, under the
+// id's SeqLock, so getWorkerStats() copies consistent stats.
+//
 
 class ThreadPoolFast::Worker {
 public:
@@ -26,42 +53,89 @@ public:
   ~Worker();
 
   void workerLoop(int instance);
-  void assignTask(Callback<void>* task);
+  // Hands 'task', added to the pool at 'queued_at', to this worker.
+  void assignTask(Callback<void>* task, TicksClock::Ticks queued_at);
 
 private:
+  // Values of state_
+  enum { NO_TASK = 0, HAS_TASK = 1, PARKED = 2 };
+
+  static const int kMinSpins = 16;
+  static const int kMaxSpins = 1 << 14;
+
   ThreadPoolFast* my_pool_;        // not owned here
 
-  Mutex           m_;
-  ConditionVar    cv_has_task_;
-  bool            has_task_;
-  Callback<void>* task_;
+  volatile int    state_;          // futex word
+  Callback<void>* task_;           // valid when state_ is HAS_TASK
+  TicksClock::Ticks queued_at_;    // ditto
+  int             spins_;          // current spin budget
+
+  // Returns true once a task was assigned to this worker, or false if
+  // the pool's idle timeout expired first.
+  bool waitForTask();
 
 };
 
 ThreadPoolFast::Worker::Worker(ThreadPoolFast* pool)
   : my_pool_(pool),
-    has_task_(false),
-    task_(NULL) {
+    state_(NO_TASK),
+    task_(NULL),
+    queued_at_(0),
+    spins_(kMinSpins) {
 }
 
 ThreadPoolFast::Worker::~Worker() {
 }
 
+bool ThreadPoolFast::Worker::waitForTask() {
+  for (int i = 0; i < spins_; i++) {
+    if (state_ == HAS_TASK) {
+      if (spins_ < kMaxSpins) {
+        spins_ <<= 1;
+      }
+      return true;
+    }
+    cpuRelax();
+  }
+
+  if (spins_ > kMinSpins) {
+    spins_ >>= 1;
+  }
+  // Announce we're parking, unless we still are from a wait that timed
+  // out. If the task arrived meanwhile, there's no need to.
+  if (__sync_val_compare_and_swap(&state_, NO_TASK, PARKED) == HAS_TASK) {
+    return true;
+  }
+  const struct timespec* timeout =
+    my_pool_->is_elastic_ ? &my_pool_->idle_timeout_ : NULL;
+  while (state_ == PARKED) {
+    if (futexWait(&state_, PARKED, timeout) == -1 &&
+        errno == ETIMEDOUT &&
+        state_ == PARKED) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void ThreadPoolFast::Worker::workerLoop(int instance) {
   worker_num_.setVal(instance);
+  WorkerStatsSlot* stats = my_pool_->worker_stats_[instance];
+  TicksClock::Ticks idle_since = TicksClock::getTicks();
 
   while (true) {
 
     // Wait until I know my task. Because a task is assigned to this
     // worker, we assume it left the free worker's pool.
-    {
-      ScopedLock l(&m_);
-
-      while (!has_task_) {
-        cv_has_task_.wait(&m_);
+    if (! waitForTask()) {
+      if (my_pool_->retireWorker(this, instance)) {
+        delete this;
+        break;
       }
-      has_task_ = false;
+      continue;
     }
+    __sync_synchronize();  // read task_ only after seeing HAS_TASK
+    state_ = NO_TASK;
 
     // A NULL task is considered a request to stop this worker.
     if (task_ == NULL) {
@@ -73,67 +147,204 @@ void ThreadPoolFast::Worker::workerLoop(int instance) {
     // i.e. stop(), the latter will notify this thread is the last
     // worker, after waiting for all other worker threads to join.
 
+    const TicksClock::Ticks start = TicksClock::getTicks();
     (*task_)();  // would self-delete if once-run task
 
+    // The pool may be gone already; leave its stats alone.
     if (last_worker_) {
       delete this;
       break;
     }
 
+    const TicksClock::Ticks end = TicksClock::getTicks();
+    stats->record(queued_at_, idle_since, start, end);
+    idle_since = end;
+
     // Return the worker to the free worker's pool
     my_pool_->queueWorker(this);
   }
 }
 
-void ThreadPoolFast::Worker::assignTask(Callback<void>* task) {
-  ScopedLock l(&m_);
-
+void ThreadPoolFast::Worker::assignTask(Callback<void>* task,
+                                        TicksClock::Ticks queued_at) {
   task_ = task;
-  has_task_ = true;
-  cv_has_task_.signal();
+  queued_at_ = queued_at;
+
+  // The exchange is a full barrier: task_ is visible before the state
+  // says so. Only a parked worker needs the syscall.
+  if (__sync_lock_test_and_set(&state_, HAS_TASK) == PARKED) {
+    futexWake(&state_, 1);
+  }
 }
 
 //
 //  ThreadPoolFast Definitions
 //
 
-ThreadPoolFast::ThreadPoolFast(int num_workers) {
-  for (int i = 0; i < num_workers; i++) {
-    Worker* worker = new Worker(this);
-    Callback<void>* body = makeCallableOnce(&Worker::workerLoop, worker, i);
-    workers_tids_.push_back(makeThread(body));
-    queueWorker(worker);
+const int ThreadPoolFast::kLaneWeights[NUM_PRIORITIES] = { 8, 4, 1 };
+
+ThreadPoolFast::ThreadPoolFast(int num_workers,
+                               const CpuPlacement& placement)
+  : queued_(0),
+    pending_stops_(0),
+    shed_(0),
+    num_workers_(0),
+    stopping_(false),
+    elastic_(num_workers, num_workers),
+    is_elastic_(false),
+    placement_(placement),
+    target_delay_ticks_(0),
+    last_grow_(0) {
+  startWorkers();
+}
+
+ThreadPoolFast::ThreadPoolFast(const Elastic& elastic,
+                               const CpuPlacement& placement)
+  : queued_(0),
+    pending_stops_(0),
+    shed_(0),
+    num_workers_(0),
+    stopping_(false),
+    elastic_(elastic),
+    is_elastic_(true),
+    placement_(placement),
+    target_delay_ticks_(static_cast<TicksClock::Ticks>(
+                          elastic.target_delay * TicksClock::ticksPerSecond())),
+    last_grow_(0) {
+  idle_timeout_.tv_sec = static_cast<time_t>(elastic.idle_timeout);
+  idle_timeout_.tv_nsec =
+    static_cast<long>((elastic.idle_timeout - idle_timeout_.tv_sec) * 1e9);
+  startWorkers();
+}
+
+void ThreadPoolFast::startWorkers() {
+  for (int i = 0; i < NUM_PRIORITIES; i++) {
+    credits_[i] = kLaneWeights[i];
+  }
+  workers_tids_.resize(elastic_.max_workers);
+  ids_used_.resize(elastic_.max_workers, false);
+  for (int i = 0; i < elastic_.max_workers; i++) {
+    worker_stats_.push_back(new WorkerStatsSlot);
+  }
+
+  ScopedLock l(&m_dispatch_);
+  for (int i = 0; i < elastic_.min_workers; i++) {
+    addWorker();
   }
 }
 
+void ThreadPoolFast::addWorker() {
+  int id = 0;
+  while (ids_used_[id]) {
+    id++;
+  }
+  ids_used_[id] = true;
+  num_workers_++;
+
+  Worker* worker = new Worker(this);
+  Callback<void>* body = makeCallableOnce(&Worker::workerLoop, worker, id);
+  workers_tids_[id] = makeThread(body, placement_.cpuFor(id));
+  dispatch(worker);
+}
+
+void ThreadPoolFast::maybeGrow() {
+  if (! is_elastic_ || stopping_ || queued_ == 0 ||
+      num_workers_ >= elastic_.max_workers) {
+    return;
+  }
+
+  // Hysteresis: give the last worker added a chance to catch up.
+  const TicksClock::Ticks now = TicksClock::getTicks();
+  if (now - last_grow_ < target_delay_ticks_) {
+    return;
+  }
+
+  TicksClock::Ticks oldest = now;
+  for (int i = 0; i < NUM_PRIORITIES; i++) {
+    if (! lanes_[i].empty() && lanes_[i].front().queued_at < oldest) {
+      oldest = lanes_[i].front().queued_at;
+    }
+  }
+  if (now - oldest < target_delay_ticks_) {
+    return;
+  }
+
+  last_grow_ = now;
+  addWorker();
+}
+
+bool ThreadPoolFast::retireWorker(Worker* worker, int id) {
+  ScopedLock l(&m_dispatch_);
+
+  if (stopping_ || num_workers_ <= elastic_.min_workers) {
+    return false;
+  }
+
+  // If the worker left the idle list, a task is on its way to it.
+  WorkerList::iterator it = find(workers_.begin(), workers_.end(), worker);
+  if (it == workers_.end()) {
+    return false;
+  }
+  workers_.erase(it);
+  ids_used_[id] = false;
+  num_workers_--;
+
+  // Nobody is going to join this thread; its id may go to a new one.
+  pthread_detach(pthread_self());
+  return true;
+}
+
 ThreadPoolFast::~ThreadPoolFast() {
   m_dispatch_.lock();
-  while (! dispatch_queue_.empty()) {
-    Callback<void>* task = dispatch_queue_.front();
-    dispatch_queue_.pop();
-    if (task && task->once()) {
-      delete task;
+  for (int i = 0; i < NUM_PRIORITIES; i++) {
+    while (! lanes_[i].empty()) {
+      Callback<void>* task = lanes_[i].front().task;
+      lanes_[i].pop();
+      if (task && task->once()) {
+        delete task;
+      }
     }
   }
+  queued_ = 0;
   m_dispatch_.unlock();
+
+  for (size_t i = 0; i < worker_stats_.size(); i++) {
+    delete worker_stats_[i];
+  }
 }
 
 void ThreadPoolFast::stop() {
-  // Issue a stop request callback for each worker thread. If the
+  // Issue a stop request for each worker thread. Idle workers get it
+  // right away. Otherwise it is handed out only after all the lanes
+  // drained, so every task queued before stop() still runs. If the
   // stop() is being issued from one of the workers itself, one of the
-  // stop callbacks won't be consummed. The destructor would dispose
-  // of it.
+  // stop requests won't be consummed.
+  m_dispatch_.lock();
+  stopping_ = true;
+  TIDs tids;
   for (size_t i = 0; i < workers_tids_.size(); i++) {
-    addTask(NULL);
+    if (ids_used_[i]) {
+      tids.push_back(workers_tids_[i]);
+    }
+  }
+  for (size_t i = 0; i < tids.size(); i++) {
+    if (! workers_.empty()) {
+      Worker* worker = workers_.front();
+      workers_.pop_front();
+      worker->assignTask(NULL, 0);
+    } else {
+      pending_stops_++;
+    }
   }
+  m_dispatch_.unlock();
 
   bool exit_last_worker = false;
-  const size_t num_workers = workers_tids_.size();
+  const size_t num_workers = tids.size();
   for (size_t i = 0; i < num_workers; ++i) {
-    if (pthread_self() == workers_tids_[i]) {
+    if (pthread_self() == tids[i]) {
       exit_last_worker = true;
     } else {
-      pthread_join(workers_tids_[i], NULL);
+      pthread_join(tids[i], NULL);
     }
   }
 
@@ -142,35 +353,133 @@ void ThreadPoolFast::stop() {
   }
 }
 
+int ThreadPoolFast::pickLane() {
+  while (true) {
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+      if (! lanes_[i].empty() && credits_[i] > 0) {
+        credits_[i]--;
+        return i;
+      }
+    }
+
+    // Every non-empty lane used up its share of the round. Start a
+    // new one.
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+      credits_[i] = kLaneWeights[i];
+    }
+  }
+}
+
+bool ThreadPoolFast::nextTask(Entry* entry) {
+  while (queued_ > 0) {
+    const int lane = pickLane();
+    *entry = lanes_[lane].front();
+    lanes_[lane].pop();
+    queued_--;
+
+    if (entry->deadline != 0 && TicksClock::getTicks() > entry->deadline) {
+      if (lane != PRIORITY_LOW) {
+        entry->deadline = 0;
+        lanes_[PRIORITY_LOW].push(*entry);
+        queued_++;
+      } else {
+        shed_++;
+        if (entry->task && entry->task->once()) {
+          delete entry->task;
+        }
+      }
+      continue;
+    }
+    return true;
+  }
+
+  if (pending_stops_ > 0) {
+    pending_stops_--;
+    entry->task = NULL;
+    entry->queued_at = 0;
+    return true;
+  }
+  return false;
+}
+
 void ThreadPoolFast::queueWorker(Worker* worker) {
   ScopedLock l(&m_dispatch_);
+  dispatch(worker);
+  maybeGrow();
+}
 
+void ThreadPoolFast::dispatch(Worker* worker) {
   // If there are tasks waiting, pick the worker right away; don't
   // bother putting it back in the pool.
-  if (! dispatch_queue_.empty()) {
-    worker->assignTask(dispatch_queue_.front());
-    dispatch_queue_.pop();
+  Entry entry;
+  if (nextTask(&entry)) {
+    worker->assignTask(entry.task, entry.queued_at);
   } else {
     workers_.push_front(worker);
   }
 }
 
 void ThreadPoolFast::addTask(Callback<void>* task) {
+  addPriorityTask(task, PRIORITY_NORMAL);
+}
+
+void ThreadPoolFast::addPriorityTask(Callback<void>* task,
+                                     Priority priority,
+                                     TicksClock::Ticks deadline) {
   ScopedLock l(&m_dispatch_);
 
   if (! workers_.empty()) {
     Worker* worker = workers_.front();
     workers_.pop_front();
-    worker->assignTask(task);
+    worker->assignTask(task, TicksClock::getTicks());
     return;
   }
 
-  dispatch_queue_.push(task);
+  Entry entry = { task, deadline, TicksClock::getTicks() };
+  lanes_[priority].push(entry);
+  queued_++;
+  maybeGrow();
+}
+
+void ThreadPoolFast::addTasks(Callback<void>** tasks, int n) {
+  ScopedLock l(&m_dispatch_);
+
+  // Hand tasks to idle workers first; queue whatever is left.
+  const TicksClock::Ticks now = TicksClock::getTicks();
+  int i = 0;
+  for (; i < n && ! workers_.empty(); i++) {
+    Worker* worker = workers_.front();
+    workers_.pop_front();
+    worker->assignTask(tasks[i], now);
+  }
+  for (; i < n; i++) {
+    Entry entry = { tasks[i], 0, now };
+    lanes_[PRIORITY_NORMAL].push(entry);
+    queued_++;
+  }
+  maybeGrow();
 }
 
 int ThreadPoolFast::count() const {
   ScopedLock l(&m_dispatch_);
-  return dispatch_queue_.size();
+  return queued_;
+}
+
+int ThreadPoolFast::shed() const {
+  ScopedLock l(&m_dispatch_);
+  return shed_;
+}
+
+int ThreadPoolFast::numWorkers() const {
+  ScopedLock l(&m_dispatch_);
+  return num_workers_;
+}
+
+void ThreadPoolFast::getWorkerStats(vector<WorkerStats>* stats) const {
+  stats->resize(worker_stats_.size());
+  for (size_t i = 0; i < worker_stats_.size(); i++) {
+    worker_stats_[i]->read(&(*stats)[i]);
+  }
 }
 
 /*static*/
@@ -6,9 +6,10 @@
 #include <vector>
 
 #include "callback.hpp"
+#include "cpu_placement.hpp"
 #include "lock.hpp"
 #include "thread_pool.hpp"
-#include "thread_local.hpp"
+#include "ticks_clock.hpp"
 
 namespace base {
 
@@ -16,17 +17,67 @@ using std::list;
 using std::queue;
 using std::vector;
 
+// ThreadPoolFast keeps one FIFO lane per priority class. Idle workers
+// pick from the lanes in weighted round-robin: per round, a lane gets
+// up to its weight in tasks (8 HIGH, 4 NORMAL, 1 LOW), so urgent work
+// goes first but a busy HIGH lane can't starve the others.
+//
+// A task with a deadline that is still queued when the deadline
+// passes is demoted to the LOW lane if it was HIGH or NORMAL, and
+// shed if it was already LOW: it is not run, and deleted if it is a
+// once-callback. Tasks without a deadline always run.
+//
+// An elastic pool sizes itself between 'min_workers' and
+// 'max_workers'. Whenever a task is queued or a worker frees up, if
+// the oldest queued task has waited longer than 'target_delay', one
+// worker is added -- at most one per 'target_delay', so a burst
+// doesn't spawn the whole range at once. A worker idle for
+// 'idle_timeout' retires, down to 'min_workers'. Worker ids are reused
+// lowest first and always stay below 'max_workers', so per-worker
+// tables (e.g. RequestStats) can be sized by it.
+//
 class ThreadPoolFast : public ThreadPool {
 public:
-
-  // ThreadPool interface
-  explicit ThreadPoolFast(int num_workers);
+  // Bounds and tuning of an elastic pool. Times are in seconds.
+  struct Elastic {
+    Elastic(int min, int max)
+      : min_workers(min), max_workers(max),
+        target_delay(0.005), idle_timeout(2.0) { }
+
+    int    min_workers;
+    int    max_workers;
+    double target_delay;  // queueing delay that triggers growth
+    double idle_timeout;  // idle time before a worker retires
+  };
+
+  // ThreadPool interface. Worker 'i' runs on
+  // 'placement.cpuFor(i)'.
+  explicit ThreadPoolFast(int num_workers,
+                          const CpuPlacement& placement = CpuPlacement());
+
+  // Builds an elastic pool, starting with 'elastic.min_workers'.
+  explicit ThreadPoolFast(const Elastic& elastic,
+                          const CpuPlacement& placement = CpuPlacement());
   virtual ~ThreadPoolFast();
 
   virtual void addTask(Callback<void>* task);
+  virtual void addPriorityTask(Callback<void>* task,
+                               Priority priority,
+                               TicksClock::Ticks deadline = 0);
+  virtual void addTasks(Callback<void>** tasks, int n);
   virtual void stop();
   virtual int count() const;
 
+  // Returns how many tasks were shed for missing their deadline.
+  int shed() const;
+
+  // Returns the number of running workers.
+  int numWorkers() const;
+
+  // Stats of workers that retired are kept; a new worker reusing the
+  // id adds to them. Each worker's stats are a consistent snapshot.
+  virtual void getWorkerStats(vector<WorkerStats>* stats) const;
+
   // Returns the worker ID the call is being issued from. The call
   // must be issued from a worker thread.
   static int ME();
@@ -35,20 +86,74 @@ public:
 private:
   class Worker;
 
-  typedef queue<Callback<void>*> DispatchQueue;
+  struct Entry {
+    Callback<void>*   task;
+    TicksClock::Ticks deadline;    // 0 for none
+    TicksClock::Ticks queued_at;
+  };
+
+  typedef queue<Entry>           Lane;
   typedef list<Worker*>          WorkerList;
   typedef vector<pthread_t>      TIDs;
 
-  mutable Mutex                  m_dispatch_;
-  ConditionVar                   cv_not_empty_;
-  DispatchQueue                  dispatch_queue_;
-  WorkerList                     workers_;
-  TIDs                           workers_tids_;
+  static const int               kLaneWeights[NUM_PRIORITIES];
 
-  static ThreadLocal<int>        worker_num_;
+  // All dispatching state is protected by m_dispatch_. Workers are
+  // only idle when no task is queued.
+  mutable Mutex                  m_dispatch_;
+  Lane                           lanes_[NUM_PRIORITIES];
+  int                            credits_[NUM_PRIORITIES];
+  int                            queued_;        // tasks in all lanes
+  int                            pending_stops_; // stops not handed out
+  int                            shed_;
+  WorkerList                     workers_;      // idle ones
+  TIDs                           workers_tids_; // indexed by worker id
+  vector<bool>                   ids_used_;
+  vector<WorkerStatsSlot*>       worker_stats_; // indexed by worker id
+  int                            num_workers_;  // running
+  bool                           stopping_;
+
+  // Elastic sizing. Fixed size pools have min_workers == max_workers.
+  const Elastic                  elastic_;
+  const bool                     is_elastic_;
+  const CpuPlacement             placement_;
+  TicksClock::Ticks              target_delay_ticks_;
+  TicksClock::Ticks              last_grow_;
+  struct timespec                idle_timeout_;
+
+  // Starts 'elastic_.min_workers' workers.
+  void startWorkers();
+
+  // Starts a worker with the lowest free id. REQUIRES: m_dispatch_
+  // held and a free id.
+  void addWorker();
+
+  // Adds a worker if the pool is elastic, below its maximum size, and
+  // the oldest queued task waited longer than the target delay.
+  // REQUIRES: m_dispatch_ held.
+  void maybeGrow();
+
+  // Removes 'worker', with id 'id', from the pool if the latter is
+  // above its minimum size and the worker is still idle. Returns
+  // false if the worker should keep waiting for tasks instead.
+  bool retireWorker(Worker* worker, int id);
 
   void queueWorker(Worker* worker);
 
+  // Hands 'worker' the next task or puts it back in the idle list.
+  // REQUIRES: m_dispatch_ held.
+  void dispatch(Worker* worker);
+
+  // Returns the lane to take the next task from, charging it one
+  // credit. REQUIRES: m_dispatch_ held and queued_ > 0.
+  int pickLane();
+
+  // Fills 'entry' with the next task to run, demoting or shedding
+  // late ones on the way. Once the lanes are drained, a pending stop
+  // request (a NULL task) is handed out. Returns false if there is
+  // nothing to run. REQUIRES: m_dispatch_ held.
+  bool nextTask(Entry* entry);
+
   // Non-copyable, non-assignable.
   ThreadPoolFast(const ThreadPoolFast&);
   ThreadPoolFast& operator=(const ThreadPoolFast&);
@@ -9,24 +9,33 @@ namespace base {
 
 static __thread bool last_worker_ = false;
 
-ThreadPoolNormal::ThreadPoolNormal(int num_workers) {
+// The pool whose worker the current thread is, if any.
+static __thread ThreadPoolNormal* current_pool_ = NULL;
+
+ThreadPoolNormal::ThreadPoolNormal(int num_workers,
+                                   int capacity,
+                                   const CpuPlacement& placement)
+  : dispatch_queue_(capacity) {
+  for (int i = 0; i < num_workers; ++i) {
+    worker_stats_.push_back(new WorkerStatsSlot);
+  }
   for (int i = 0; i < num_workers; ++i) {
     Callback<void>* body = makeCallableOnce(&ThreadPoolNormal::workerLoop,
-                                            this);
-    workers_.push_back(makeThread(body));
+                                            this, i);
+    workers_.push_back(makeThread(body, placement.cpuFor(i)));
   }
 }
 
 ThreadPoolNormal::~ThreadPoolNormal() {
-  m_dispatch_.lock();
-  while (! dispatch_queue_.empty()) {
-    Callback<void>* task = dispatch_queue_.front();
-    dispatch_queue_.pop();
-    if (task && task->once()) {
-      delete task;
+  Entry entry;
+  while (dispatch_queue_.tryPop(&entry)) {
+    if (entry.task && entry.task->once()) {
+      delete entry.task;
     }
   }
-  m_dispatch_.unlock();
+  for (size_t i = 0; i < worker_stats_.size(); ++i) {
+    delete worker_stats_[i];
+  }
 }
 
 void ThreadPoolNormal::stop() {
@@ -36,12 +45,8 @@ void ThreadPoolNormal::stop() {
   //
   // If however we are executing stop from within a worker, we
   // want that worker to return immediately after executing stop().
-  {
-    ScopedLock l(&m_dispatch_);
-    for (size_t i = 0; i < workers_.size(); ++i) {
-      dispatch_queue_.push(NULL);
-    }
-    cv_not_empty_.signalAll();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    addTask(NULL);
   }
 
   bool exit_last_worker = false;
@@ -60,26 +65,75 @@ void ThreadPoolNormal::stop() {
 }
 
 void ThreadPoolNormal::addTask(Callback<void>* task) {
-  ScopedLock l(&m_dispatch_);
-  dispatch_queue_.push(task);
-  cv_not_empty_.signal();
+  // Waiting for room counts as queueing.
+  Entry entry = { task, TicksClock::getTicks() };
+  while (! tryAddEntry(entry)) {
+    // A worker can't wait for room: if all of them did, no one would
+    // drain the queue. It runs the task itself instead. (Stop requests,
+    // NULL tasks, still wait; the other workers keep draining.)
+    if (current_pool_ == this && task != NULL) {
+      (*task)();  // would self-delete if once-run task
+      return;
+    }
+
+    EventCount::Key key = ec_not_full_.prepareWait();
+    if (tryAddEntry(entry)) {
+      ec_not_full_.cancelWait();
+      return;
+    }
+    ec_not_full_.wait(key);
+  }
 }
 
-void ThreadPoolNormal::workerLoop() {
-  Callback<void>* task = NULL;
-  while (true) {
-    {
-      ScopedLock l(&m_dispatch_);
+void ThreadPoolNormal::addTasks(Callback<void>** tasks, int n) {
+  const TicksClock::Ticks now = TicksClock::getTicks();
+  int i = 0;
+  while (i < n) {
+    Entry entry = { tasks[i], now };
+    if (! dispatch_queue_.tryPush(entry)) {
+      break;
+    }
+    i++;
+  }
+  ec_not_empty_.notifyMany(i);
 
-      while (dispatch_queue_.empty()) {
-        cv_not_empty_.wait(&m_dispatch_);
-      }
+  // The queue filled up. Wait for room for the rest, or run it here if
+  // this is a worker.
+  for (; i < n; i++) {
+    addTask(tasks[i]);
+  }
+}
 
-      task = dispatch_queue_.front();
-      dispatch_queue_.pop();
+bool ThreadPoolNormal::tryAddTask(Callback<void>* task) {
+  Entry entry = { task, TicksClock::getTicks() };
+  return tryAddEntry(entry);
+}
+
+bool ThreadPoolNormal::tryAddEntry(const Entry& entry) {
+  if (! dispatch_queue_.tryPush(entry)) {
+    return false;
+  }
+  ec_not_empty_.notify();
+  return true;
+}
+
+void ThreadPoolNormal::workerLoop(int id) {
+  current_pool_ = this;
+  WorkerStatsSlot* stats = worker_stats_[id];
+  TicksClock::Ticks idle_since = TicksClock::getTicks();
+  Entry entry;
+  while (true) {
+    while (! dispatch_queue_.tryPop(&entry)) {
+      EventCount::Key key = ec_not_empty_.prepareWait();
+      if (dispatch_queue_.tryPop(&entry)) {
+        ec_not_empty_.cancelWait();
+        break;
+      }
+      ec_not_empty_.wait(key);
     }
+    ec_not_full_.notify();
 
-    if (task == NULL) {
+    if (entry.task == NULL) {
       LOG(LogMessage::NORMAL) << "worker stopped";
       return;
     }
@@ -88,18 +142,29 @@ void ThreadPoolNormal::workerLoop() {
     // i.e. stop(), the latter will notify this thread is the last
     // worker, after waiting for all other worker threads to join.
 
-    (*task)(); // would self-delete if once-run task
+    const TicksClock::Ticks start = TicksClock::getTicks();
+    (*entry.task)(); // would self-delete if once-run task
 
+    // The pool may be gone already; leave its stats alone.
     if (last_worker_) {
       return;
     }
 
+    const TicksClock::Ticks end = TicksClock::getTicks();
+    stats->record(entry.queued_at, idle_since, start, end);
+    idle_since = end;
   }
 }
 
 int ThreadPoolNormal::count() const {
-  ScopedLock l(&m_dispatch_);
   return dispatch_queue_.size();
 }
 
+void ThreadPoolNormal::getWorkerStats(vector<WorkerStats>* stats) const {
+  stats->resize(worker_stats_.size());
+  for (size_t i = 0; i < worker_stats_.size(); ++i) {
+    worker_stats_[i]->read(&(*stats)[i]);
+  }
+}
+
 } // namespace base
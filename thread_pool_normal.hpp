@@ -1,38 +1,79 @@
 #ifndef MCP_BASE_THREAD_POOL_NORMAL_HEADER
 #define MCP_BASE_THREAD_POOL_NORMAL_HEADER
 
-#include <queue>
 #include <vector>
 
 #include "callback.hpp"
-#include "lock.hpp"
+#include "cpu_placement.hpp"
+#include "event_count.hpp"
+#include "mpmc_queue.hpp"
 #include "thread_pool.hpp"
+#include "ticks_clock.hpp"
 
 namespace base {
 
-using std::queue;
 using std::vector;
 
+// A thread pool whose workers all pick tasks from one bounded,
+// lock-free dispatch queue (see MPMCQueue). Neither adding nor picking
+// a task takes a lock. A worker that finds the queue empty sleeps on
+// an EventCount, and only then does addTask() pay for waking it up.
+//
+// When the queue is full, addTask() waits for room; tryAddTask() lets
+// the caller apply backpressure instead. A worker adding to a full
+// queue doesn't wait, since the workers are the ones who would make
+// room; it runs the task right away.
+//
+// Tasks are queued with the time they were added, and each worker
+// records its queue delays, run times and idle gaps in WorkerStats of
+// its own.
+//
 class ThreadPoolNormal : public ThreadPool {
 public:
-  // ThreadPoolNormal interface
-  explicit ThreadPoolNormal(int num_workers);
+  // Default number of pending tasks the dispatch queue holds.
+  static const int kDefaultCapacity = 1 << 14;
+
+  // ThreadPoolNormal interface. Worker 'i' runs on
+  // 'placement.cpuFor(i)'.
+  explicit ThreadPoolNormal(int num_workers,
+                            int capacity = kDefaultCapacity,
+                            const CpuPlacement& placement = CpuPlacement());
   virtual ~ThreadPoolNormal();
 
   virtual void addTask(Callback<void>* task);
+  virtual void addTasks(Callback<void>** tasks, int n);
   virtual void stop();
   virtual int count() const;
+  virtual void getWorkerStats(vector<WorkerStats>* stats) const;
+
+  // Adds 'task' and returns true, or returns false without blocking if
+  // the dispatch queue is full.
+  bool tryAddTask(Callback<void>* task);
+
+  // Returns how many pending tasks the dispatch queue can hold (the
+  // requested capacity rounded up to a power of 2).
+  int capacity() const { return dispatch_queue_.capacity(); }
 
 private:
-  typedef queue<Callback<void>*> DispatchQueue;
+  struct Entry {
+    Callback<void>*   task;
+    TicksClock::Ticks queued_at;
+  };
+
+  typedef MPMCQueue<Entry> DispatchQueue;
+
+  vector<pthread_t>        workers_;
+  vector<WorkerStatsSlot*> worker_stats_;  // indexed by worker id
 
-  vector<pthread_t>    workers_;
+  DispatchQueue            dispatch_queue_;
+  EventCount               ec_not_empty_;  // workers wait here
+  EventCount               ec_not_full_;   // addTask() waits here
 
-  mutable Mutex        m_dispatch_;
-  DispatchQueue        dispatch_queue_;
-  ConditionVar         cv_not_empty_;
+  void workerLoop(int id);
 
-  void workerLoop();
+  // Queues 'entry' and returns true, or returns false if the dispatch
+  // queue is full.
+  bool tryAddEntry(const Entry& entry);
 
   // Non-copyable, non-assignable.
   ThreadPoolNormal(const ThreadPoolNormal&);
@@ -0,0 +1,244 @@
+#include <stdlib.h>    // rand_r
+
+#include "thread.hpp"
+
+#include "thread_pool_stealing.hpp"
+
+namespace base {
+
+static __thread bool last_worker_ = false;
+
+// The pool and worker number of the calling thread, if it is a worker.
+static __thread ThreadPoolStealing* current_pool_ = NULL;
+static __thread int current_id_ = -1;
+
+ThreadPoolStealing::ThreadPoolStealing(int num_workers,
+                                       const CpuPlacement& placement)
+  : inject_size_(0),
+    epoch_(0),
+    stopping_(false),
+    num_idle_(0) {
+  // All the workers must exist before any of them starts stealing.
+  for (int i = 0; i < num_workers; i++) {
+    Worker* worker = new Worker;
+    worker->seed = i + 1;
+    workers_.push_back(worker);
+  }
+  for (int i = 0; i < num_workers; i++) {
+    Callback<void>* body = makeCallableOnce(&ThreadPoolStealing::workerLoop,
+                                            this, i);
+    workers_[i]->tid = makeThread(body, placement.cpuFor(i));
+  }
+}
+
+ThreadPoolStealing::~ThreadPoolStealing() {
+  Entry entry;
+  m_inject_.lock();
+  while (! inject_queue_.empty()) {
+    entry = inject_queue_.front();
+    inject_queue_.pop();
+    if (entry.task && entry.task->once()) {
+      delete entry.task;
+    }
+  }
+  m_inject_.unlock();
+
+  for (size_t i = 0; i < workers_.size(); i++) {
+    while (workers_[i]->deque.steal(&entry)) {
+      if (entry.task && entry.task->once()) {
+        delete entry.task;
+      }
+    }
+    delete workers_[i];
+  }
+}
+
+void ThreadPoolStealing::stop() {
+  // Workers leave once they see 'stopping_' and find no task queued
+  // anywhere. Tasks added before stop() are therefore all run.
+  {
+    ScopedLock l(&m_idle_);
+    stopping_ = true;
+    epoch_++;
+    cv_work_.signalAll();
+  }
+
+  bool exit_last_worker = false;
+  const size_t num_workers = workers_.size();
+  for (size_t i = 0; i < num_workers; ++i) {
+    if (pthread_self() == workers_[i]->tid) {
+      exit_last_worker = true;
+    } else {
+      pthread_join(workers_[i]->tid, NULL);
+    }
+  }
+
+  if (exit_last_worker) {
+    last_worker_ = true;
+  }
+}
+
+void ThreadPoolStealing::addTask(Callback<void>* task) {
+  Entry entry = { task, TicksClock::getTicks() };
+  if (current_pool_ == this) {
+    workers_[current_id_]->deque.push(entry);
+  } else {
+    ScopedLock l(&m_inject_);
+    inject_queue_.push(entry);
+    inject_size_++;
+  }
+  wakeSome(1);
+}
+
+void ThreadPoolStealing::addTasks(Callback<void>** tasks, int n) {
+  Entry entry = { NULL, TicksClock::getTicks() };
+  if (current_pool_ == this) {
+    Deque& deque = workers_[current_id_]->deque;
+    for (int i = 0; i < n; i++) {
+      entry.task = tasks[i];
+      deque.push(entry);
+    }
+  } else {
+    ScopedLock l(&m_inject_);
+    for (int i = 0; i < n; i++) {
+      entry.task = tasks[i];
+      inject_queue_.push(entry);
+    }
+    inject_size_ += n;
+  }
+  wakeSome(n);
+}
+
+int ThreadPoolStealing::count() const {
+  int res = inject_size_;
+  for (size_t i = 0; i < workers_.size(); i++) {
+    res += workers_[i]->deque.size();
+  }
+  return res;
+}
+
+void ThreadPoolStealing::getWorkerStats(vector<WorkerStats>* stats) const {
+  stats->resize(workers_.size());
+  for (size_t i = 0; i < workers_.size(); i++) {
+    workers_[i]->stats.read(&(*stats)[i]);
+  }
+}
+
+/*static*/
+int ThreadPoolStealing::ME() {
+  return current_id_;
+}
+
+void ThreadPoolStealing::workerLoop(int id) {
+  current_pool_ = this;
+  current_id_ = id;
+  Worker* me = workers_[id];
+  TicksClock::Ticks idle_since = TicksClock::getTicks();
+
+  Entry entry;
+  while (true) {
+    if (findTask(me, &entry)) {
+      // If this worker is executing the ThreadPool tear down,
+      // i.e. stop(), the latter will notify this thread is the last
+      // worker, after waiting for all other worker threads to join.
+
+      const TicksClock::Ticks start = TicksClock::getTicks();
+      (*entry.task)();  // would self-delete if once-run task
+
+      // The pool may be gone already; leave its stats alone.
+      if (last_worker_) {
+        break;
+      }
+
+      const TicksClock::Ticks end = TicksClock::getTicks();
+      me->stats.record(entry.queued_at, idle_since, start, end);
+      idle_since = end;
+      continue;
+    }
+
+    // A steal can fail because another thief won the race. Only
+    // leave once nothing is queued at all.
+    if (stopping_) {
+      if (! hasWork()) {
+        break;
+      }
+      continue;
+    }
+
+    park();
+  }
+
+  current_pool_ = NULL;
+  current_id_ = -1;
+}
+
+bool ThreadPoolStealing::findTask(Worker* me, Entry* entry) {
+  if (me->deque.take(entry)) {
+    return true;
+  }
+
+  if (inject_size_ > 0) {
+    ScopedLock l(&m_inject_);
+    if (! inject_queue_.empty()) {
+      *entry = inject_queue_.front();
+      inject_queue_.pop();
+      inject_size_--;
+      return true;
+    }
+  }
+
+  const int num_workers = workers_.size();
+  int victim = rand_r(&me->seed) % num_workers;
+  for (int i = 0; i < num_workers; i++) {
+    Worker* other = workers_[victim];
+    if (other != me && other->deque.steal(entry)) {
+      return true;
+    }
+    if (++victim == num_workers) {
+      victim = 0;
+    }
+  }
+  return false;
+}
+
+bool ThreadPoolStealing::hasWork() const {
+  if (inject_size_ > 0) {
+    return true;
+  }
+  for (size_t i = 0; i < workers_.size(); i++) {
+    if (workers_[i]->deque.size() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPoolStealing::park() {
+  ScopedLock l(&m_idle_);
+
+  // Announce we're going to sleep before the last look at the queues.
+  // A submitter queues its task before checking 'num_idle_' (see
+  // wakeSome()). The two full barriers ensure that either we see the
+  // task or the submitter sees us.
+  const long epoch = epoch_;
+  __sync_fetch_and_add(&num_idle_, 1);
+  if (! hasWork()) {
+    while (epoch_ == epoch && ! stopping_) {
+      cv_work_.wait(&m_idle_);
+    }
+  }
+  __sync_fetch_and_sub(&num_idle_, 1);
+}
+
+void ThreadPoolStealing::wakeSome(int n) {
+  __sync_synchronize();
+  if (num_idle_ > 0) {
+    ScopedLock l(&m_idle_);
+    epoch_++;
+    for (int i = 0; i < n && i < num_idle_; i++) {
+      cv_work_.signal();
+    }
+  }
+}
+
+} // namespace base
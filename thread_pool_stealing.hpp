@@ -0,0 +1,117 @@
+#ifndef MCP_BASE_THREAD_POOL_STEALING_HEADER
+#define MCP_BASE_THREAD_POOL_STEALING_HEADER
+
+#include <pthread.h>
+#include <queue>
+#include <vector>
+
+#include "callback.hpp"
+#include "cpu_placement.hpp"
+#include "lock.hpp"
+#include "thread_pool.hpp"
+#include "ticks_clock.hpp"
+#include "work_stealing_deque.hpp"
+
+namespace base {
+
+using std::queue;
+using std::vector;
+
+// A work-stealing thread pool. Each worker owns a WorkStealingDeque.
+//
+//   + tasks added from inside a worker go to that worker's deque, and
+//     the worker runs them LIFO (the most recent task is the one whose
+//     data is still in cache);
+//   + tasks added from any other thread go to a shared injection
+//     queue;
+//   + a worker with nothing to do picks from the injection queue and
+//     then tries to steal the oldest task of other workers, starting
+//     at a random victim.
+//
+// Workers that find no task anywhere sleep until a task is added. The
+// submitting thread only touches the sleeping machinery when some
+// worker is actually asleep.
+//
+// Contrary to ThreadPoolFast and ThreadPoolNormal, the order in which
+// tasks run is not FIFO.
+//
+// Deque and injection queue entries carry the time their task was
+// added, and each worker records its queue delays, run times and idle
+// gaps in WorkerStats of its own.
+//
+class ThreadPoolStealing : public ThreadPool {
+public:
+
+  // ThreadPool interface. Worker 'i' runs on
+  // 'placement.cpuFor(i)'.
+  explicit ThreadPoolStealing(int num_workers,
+                              const CpuPlacement& placement = CpuPlacement());
+  virtual ~ThreadPoolStealing();
+
+  virtual void addTask(Callback<void>* task);
+  virtual void addTasks(Callback<void>** tasks, int n);
+  virtual void stop();
+  virtual int count() const;
+  virtual void getWorkerStats(vector<WorkerStats>* stats) const;
+
+  // Returns the worker ID the call is being issued from, or -1 if the
+  // caller is not a worker of a ThreadPoolStealing.
+  static int ME();
+
+private:
+  struct Entry {
+    Callback<void>*   task;
+    TicksClock::Ticks queued_at;
+  };
+
+  typedef WorkStealingDeque<Entry> Deque;
+  typedef queue<Entry>             InjectionQueue;
+
+  struct Worker {
+    Deque           deque;
+    pthread_t       tid;
+    unsigned        seed;    // victim selection, owner only
+    WorkerStatsSlot stats;   // written by the owner only
+  };
+  typedef vector<Worker*> Workers;
+
+  Workers                 workers_;     // owned here
+
+  // Tasks added from outside the pool.
+  mutable Mutex           m_inject_;
+  InjectionQueue          inject_queue_;
+  volatile int            inject_size_; // read without m_inject_
+
+  // Sleeping workers wait on 'cv_work_' for 'epoch_' to change. Both
+  // 'epoch_' and 'stopping_' are protected by m_idle_.
+  Mutex                   m_idle_;
+  ConditionVar            cv_work_;
+  long                    epoch_;
+  volatile bool           stopping_;
+  volatile int            num_idle_;    // changed atomically
+
+  void workerLoop(int id);
+
+  // Picks a task for worker 'me': its own deque, then the injection
+  // queue, then the other workers' deques. Returns false if no task
+  // was found.
+  bool findTask(Worker* me, Entry* entry);
+
+  // Returns true if there is a task queued anywhere in the pool.
+  bool hasWork() const;
+
+  // Puts the calling worker to sleep until a task is added, if no task
+  // is queued.
+  void park();
+
+  // Wakes up as many as 'n' sleeping workers.
+  void wakeSome(int n);
+
+  // Non-copyable, non-assignable.
+  ThreadPoolStealing(const ThreadPoolStealing&);
+  ThreadPoolStealing& operator=(const ThreadPoolStealing&);
+};
+
+} // namespace base
+
+#endif // MCP_BASE_THREAD_POOL_STEALING_HEADER
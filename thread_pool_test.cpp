@@ -1,19 +1,27 @@
+#include <vector>
+
 #include "callback.hpp"
 #include "lock.hpp"
 #include "thread_pool_fast.hpp"
 #include "thread_pool_normal.hpp"
+#include "thread_pool_stealing.hpp"
 #include "test_unit.hpp"
 
 namespace {
 
 using base::Callback;
+using base::ConditionVar;
 using base::makeCallableMany;
 using base::makeCallableOnce;
 using base::Mutex;
 using base::Notification;
 using base::ScopedLock;
 using base::ThreadPool;
+using base::ThreadPoolFast;
 using base::ThreadPoolNormal;
+using base::ThreadPoolStealing;
+using base::WorkerStats;
+using std::vector;
 
 struct Counter {
   Counter() : i(0) { }
@@ -35,6 +43,130 @@ struct Stopper {
   Notification n_;
 };
 
+// Adds 'fan_out' increments to the pool it runs on.
+struct Spawner {
+  Spawner(ThreadPool* p, Callback<void>* child, int fan_out)
+    : p_(p), child_(child), fan_out_(fan_out) {}
+  void spawn() { for (int i = 0; i < fan_out_; i++) p_->addTask(child_); }
+
+  ThreadPool* p_;
+  Callback<void>* child_;
+  int fan_out_;
+};
+
+struct WorkerIds {
+  WorkerIds() : bad(0) { }
+  void check(int num_workers) {
+    int me = ThreadPoolStealing::ME();
+    if (me < 0 || me >= num_workers) {
+      __sync_fetch_and_add(&bad, 1);
+    }
+  }
+
+  int bad;
+};
+
+// Records the order in which tasks ran.
+struct Recorder {
+  void record(int id) { ScopedLock l(&m); order.push_back(id); }
+
+  Mutex m;
+  vector<int> order;
+};
+
+// Keeps a worker busy until released.
+struct Blocker {
+  void block() { started.notify(); release.wait(); }
+
+  Notification started;
+  Notification release;
+};
+
+// Records the worker ids tasks ran on.
+struct IdRecorder {
+  IdRecorder() : max_id(-1), min_id(1 << 30) { }
+  void record() {
+    usleep(2000 /*2ms*/);
+    int me = ThreadPoolFast::ME();
+    ScopedLock l(&m);
+    if (me > max_id) max_id = me;
+    if (me < min_id) min_id = me;
+  }
+
+  Mutex m;
+  int max_id;
+  int min_id;
+};
+
+// Records the worker id of each task; tasks hold their workers until
+// 'n' of them arrived, so they all run on different workers.
+struct IdGathering {
+  explicit IdGathering(int num) : n(num), arrived(0), seen(num, 0) { }
+  void arrive() {
+    int me = ThreadPoolFast::ME();
+    ScopedLock l(&m);
+    if (me >= 0 && me < n) seen[me]++;
+    arrived++;
+    cv.signalAll();
+    while (arrived < n) cv.wait(&m);
+  }
+
+  Mutex        m;
+  ConditionVar cv;
+  const int    n;
+  int          arrived;
+  vector<int>  seen;   // tasks per worker id
+};
+
+// Runs 'num_batches' batches of 'batch_size' increments through a
+// 'PoolType' pool and returns the final count.
+template<typename PoolType>
+int runBatches(int num_workers, int num_batches, int batch_size) {
+  Counter counter;
+  ThreadPool* pool = new PoolType(num_workers);
+  Callback<void>* task = makeCallableMany(&Counter::Incr, &counter);
+
+  vector<Callback<void>*> batch(batch_size, task);
+  for (int i = 0; i < num_batches; i++) {
+    pool->addTasks(&batch[0], batch_size);
+  }
+
+  pool->stop();
+  delete pool;
+  delete task;
+  return counter.Get();
+}
+
+// Sums up the workers' 'stats'. A worker whose busy time and run
+// times disagree, or that was busier than it had time for, counts as
+// 'inconsistent'.
+void sumStats(const vector<WorkerStats>& stats,
+              uint64_t* run, uint64_t* queued, int* inconsistent) {
+  *run = 0;
+  *queued = 0;
+  *inconsistent = 0;
+  for (size_t i = 0; i < stats.size(); i++) {
+    *run += stats[i].run_time.count();
+    *queued += stats[i].queue_delay.count();
+    if (stats[i].busy_ticks != stats[i].run_time.sum() ||
+        stats[i].utilization() > 1.0) {
+      (*inconsistent)++;
+    }
+  }
+}
+
+// Runs 100 tasks on 'pool', stops it, and collects its stats.
+void runHundredTasks(ThreadPool* pool, vector<WorkerStats>* stats) {
+  Counter counter;
+  Callback<void>* task = makeCallableMany(&Counter::Incr, &counter);
+  for (int i = 0; i < 100; i++) {
+    pool->addTask(task);
+  }
+  pool->stop();
+  pool->getWorkerStats(stats);
+  delete task;
+}
+
 //
 // Test Cases
 //
@@ -99,6 +231,408 @@ TEST(Basics, Concurrency) {
   delete task;
 }
 
+TEST(Basics, TryAddTaskWhenFull) {
+  Counter counter;
+  ThreadPoolNormal* pool = new ThreadPoolNormal(1, 3 /* rounded to 4 */);
+  EXPECT_EQ(pool->capacity(), 4);
+
+  // Hold the only worker so the tasks queue up.
+  Notification started;
+  Notification release;
+  Callback<void>* started_cb = makeCallableOnce(&Notification::notify,
+                                                &started);
+  Callback<void>* hold = makeCallableOnce(&Notification::wait, &release);
+  pool->addTask(started_cb);
+  pool->addTask(hold);
+  started.wait();
+  while (pool->count() > 0) {
+    usleep(1000);
+  }
+
+  Callback<void>* task = makeCallableMany(&Counter::Incr, &counter);
+  int added = 0;
+  while (added < 10 && pool->tryAddTask(task)) {
+    added++;
+  }
+  EXPECT_EQ(added, 4);
+  EXPECT_EQ(pool->count(), 4);
+
+  // Past the backpressure, addTask() itself waits for room.
+  release.notify();
+  for (int i = 0; i < 10; i++) {
+    pool->addTask(task);
+  }
+
+  pool->stop();
+  EXPECT_EQ(counter.Get(), 14);
+  delete pool;
+  delete task;
+}
+
+TEST(Basics, WorkersAddToFullQueue) {
+  // Every worker keeps adding to a queue that is always full. Had they
+  // waited for room, no one would have drained it.
+  Counter counter;
+  ThreadPool* pool = new ThreadPoolNormal(2, 2);
+  const int num_roots = 4;
+  const int fan_out = 100;
+  Callback<void>* child = makeCallableMany(&Counter::Incr, &counter);
+  Spawner spawner(pool, child, fan_out);
+  Callback<void>* root = makeCallableMany(&Spawner::spawn, &spawner);
+  for (int i = 0; i < num_roots; i++) {
+    pool->addTask(root);
+  }
+
+  // Tasks the workers add after stop() may not run; wait for them all
+  // first.
+  while (counter.Get() < num_roots * fan_out) {
+    usleep(1000);
+  }
+  pool->stop();
+  EXPECT_EQ(counter.Get(), num_roots * fan_out);
+  delete pool;
+  delete root;
+  delete child;
+}
+
+TEST(Batch, AllPools) {
+  EXPECT_EQ(runBatches<ThreadPoolNormal>(3, 20, 50), 1000);
+  EXPECT_EQ(runBatches<ThreadPoolFast>(3, 20, 50), 1000);
+  EXPECT_EQ(runBatches<ThreadPoolStealing>(3, 20, 50), 1000);
+}
+
+TEST(Batch, LargerThanCapacity) {
+  Counter counter;
+  ThreadPool* pool = new ThreadPoolNormal(2, 8);
+  Callback<void>* task = makeCallableMany(&Counter::Incr, &counter);
+
+  const int batch_size = 100;
+  vector<Callback<void>*> batch(batch_size, task);
+  pool->addTasks(&batch[0], batch_size);
+
+  pool->stop();
+  EXPECT_EQ(counter.Get(), batch_size);
+  delete pool;
+  delete task;
+}
+
+TEST(Priority, HighBeforeLow) {
+  Recorder rec;
+  Blocker blocker;
+  ThreadPoolFast* pool = new ThreadPoolFast(1);
+  pool->addTask(makeCallableOnce(&Blocker::block, &blocker));
+  blocker.started.wait();
+
+  // Queued behind the blocker: LOW tasks 0-4, then HIGH tasks 10-14.
+  for (int i = 0; i < 5; i++) {
+    pool->addPriorityTask(makeCallableOnce(&Recorder::record, &rec, i),
+                          ThreadPool::PRIORITY_LOW);
+  }
+  for (int i = 10; i < 15; i++) {
+    pool->addPriorityTask(makeCallableOnce(&Recorder::record, &rec, i),
+                          ThreadPool::PRIORITY_HIGH);
+  }
+  EXPECT_EQ(pool->count(), 10);
+  blocker.release.notify();
+
+  pool->stop();
+  EXPECT_EQ(rec.order.size(), 10U);
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(rec.order[i], 10 + i);
+    EXPECT_EQ(rec.order[5 + i], i);
+  }
+  delete pool;
+}
+
+TEST(Priority, LowIsNotStarved) {
+  Recorder rec;
+  Blocker blocker;
+  ThreadPoolFast* pool = new ThreadPoolFast(1);
+  pool->addTask(makeCallableOnce(&Blocker::block, &blocker));
+  blocker.started.wait();
+
+  pool->addPriorityTask(makeCallableOnce(&Recorder::record, &rec, -1),
+                        ThreadPool::PRIORITY_LOW);
+  for (int i = 0; i < 20; i++) {
+    pool->addPriorityTask(makeCallableOnce(&Recorder::record, &rec, i),
+                          ThreadPool::PRIORITY_HIGH);
+  }
+  blocker.release.notify();
+
+  // The LOW task gets its turn after one round of HIGH ones.
+  pool->stop();
+  EXPECT_EQ(rec.order.size(), 21U);
+  EXPECT_EQ(rec.order[8], -1);
+  delete pool;
+}
+
+TEST(Priority, Deadlines) {
+  Recorder rec;
+  Blocker blocker;
+  ThreadPoolFast* pool = new ThreadPoolFast(1);
+  pool->addTask(makeCallableOnce(&Blocker::block, &blocker));
+  blocker.started.wait();
+
+  // Both deadlines are over by the time the worker is released. The
+  // HIGH task is demoted and still runs; the LOW one is shed.
+  base::TicksClock::Ticks past = base::TicksClock::getTicks();
+  pool->addPriorityTask(makeCallableOnce(&Recorder::record, &rec, 1),
+                        ThreadPool::PRIORITY_LOW, past);
+  pool->addPriorityTask(makeCallableOnce(&Recorder::record, &rec, 2),
+                        ThreadPool::PRIORITY_HIGH, past);
+  pool->addTask(makeCallableOnce(&Recorder::record, &rec, 3));
+  blocker.release.notify();
+
+  pool->stop();
+  EXPECT_EQ(rec.order.size(), 2U);
+  EXPECT_EQ(rec.order[0], 3);
+  EXPECT_EQ(rec.order[1], 2);
+  EXPECT_EQ(pool->shed(), 1);
+  delete pool;
+}
+
+TEST(Priority, StopRunsAllLanes) {
+  Counter counter;
+  Blocker blocker;
+  ThreadPoolFast* pool = new ThreadPoolFast(2);
+  Callback<void>* task = makeCallableMany(&Counter::Incr, &counter);
+  pool->addTask(makeCallableOnce(&Blocker::block, &blocker));
+  blocker.started.wait();
+
+  for (int i = 0; i < 10; i++) {
+    pool->addPriorityTask(task, ThreadPool::PRIORITY_LOW);
+    pool->addPriorityTask(task, ThreadPool::PRIORITY_NORMAL);
+    pool->addPriorityTask(task, ThreadPool::PRIORITY_HIGH);
+  }
+  blocker.release.notify();
+
+  pool->stop();
+  EXPECT_EQ(counter.Get(), 30);
+  delete pool;
+  delete task;
+}
+
+TEST(Elastic, GrowsAndShrinks) {
+  ThreadPoolFast::Elastic elastic(1, 4);
+  elastic.target_delay = 0.001;
+  elastic.idle_timeout = 0.05;
+  ThreadPoolFast* pool = new ThreadPoolFast(elastic);
+  EXPECT_EQ(pool->numWorkers(), 1);
+
+  // Keep the first worker busy; tasks queue behind it and wait longer
+  // than the target delay.
+  Blocker blocker;
+  pool->addTask(makeCallableOnce(&Blocker::block, &blocker));
+  blocker.started.wait();
+
+  IdRecorder ids;
+  Callback<void>* task = makeCallableMany(&IdRecorder::record, &ids);
+  for (int i = 0; i < 20; i++) {
+    pool->addTask(task);
+    usleep(2000 /*2ms*/);
+  }
+  EXPECT_GT(pool->numWorkers(), 1);
+  EXPECT_TRUE(pool->numWorkers() <= 4);
+  blocker.release.notify();
+
+  // Idle workers retire, down to the minimum.
+  for (int i = 0; i < 100 && pool->numWorkers() > 1; i++) {
+    usleep(20000 /*20ms*/);
+  }
+  EXPECT_EQ(pool->numWorkers(), 1);
+
+  // Ids of new workers are reused and stay under the maximum.
+  blocker.release.reset();
+  blocker.started.reset();
+  pool->addTask(makeCallableOnce(&Blocker::block, &blocker));
+  blocker.started.wait();
+  for (int i = 0; i < 20; i++) {
+    pool->addTask(task);
+    usleep(2000 /*2ms*/);
+  }
+  blocker.release.notify();
+
+  pool->stop();
+  EXPECT_TRUE(ids.min_id >= 0);
+  EXPECT_TRUE(ids.max_id < 4);
+  EXPECT_EQ(pool->count(), 0);
+  delete pool;
+  delete task;
+}
+
+TEST(Fast, ManyWorkers) {
+  // Worker ids beyond 16 are kept apart.
+  const int num_workers = 32;
+  ThreadPool* pool = new ThreadPoolFast(num_workers);
+  IdGathering ids(num_workers);
+  Callback<void>* task = makeCallableMany(&IdGathering::arrive, &ids);
+  for (int i = 0; i < num_workers; i++) {
+    pool->addTask(task);
+  }
+  pool->stop();
+
+  for (int i = 0; i < num_workers; i++) {
+    EXPECT_EQ(ids.seen[i], 1);
+  }
+  delete pool;
+  delete task;
+}
+
+TEST(Stats, FastPoolRecordsEveryTask) {
+  ThreadPool* pool = new ThreadPoolFast(2);
+  vector<WorkerStats> stats;
+  runHundredTasks(pool, &stats);
+  EXPECT_EQ(stats.size(), 2U);
+
+  uint64_t run, queued;
+  int inconsistent;
+  sumStats(stats, &run, &queued, &inconsistent);
+  EXPECT_EQ(run, 100U);
+  EXPECT_EQ(queued, 100U);
+  EXPECT_EQ(inconsistent, 0);
+  delete pool;
+}
+
+TEST(Stats, NormalPoolRecordsEveryTask) {
+  ThreadPool* pool = new ThreadPoolNormal(2);
+  vector<WorkerStats> stats;
+  runHundredTasks(pool, &stats);
+  EXPECT_EQ(stats.size(), 2U);
+
+  uint64_t run, queued;
+  int inconsistent;
+  sumStats(stats, &run, &queued, &inconsistent);
+  EXPECT_EQ(run, 100U);
+  EXPECT_EQ(queued, 100U);
+  EXPECT_EQ(inconsistent, 0);
+  delete pool;
+}
+
+TEST(Stats, StealingPoolRecordsEveryTask) {
+  ThreadPool* pool = new ThreadPoolStealing(2);
+  vector<WorkerStats> stats;
+  runHundredTasks(pool, &stats);
+  EXPECT_EQ(stats.size(), 2U);
+
+  uint64_t run, queued;
+  int inconsistent;
+  sumStats(stats, &run, &queued, &inconsistent);
+  EXPECT_EQ(run, 100U);
+  EXPECT_EQ(queued, 100U);
+  EXPECT_EQ(inconsistent, 0);
+  delete pool;
+}
+
+TEST(Stats, StealingPoolStampsDequeEntries) {
+  // Tasks a worker queues on its own deque are recorded too, whoever
+  // ends up running them.
+  Counter counter;
+  ThreadPool* pool = new ThreadPoolStealing(4);
+  Callback<void>* child = makeCallableMany(&Counter::Incr, &counter);
+  Spawner spawner(pool, child, 100);
+  Callback<void>* root = makeCallableMany(&Spawner::spawn, &spawner);
+  for (int i = 0; i < 4; i++) {
+    pool->addTask(root);
+  }
+  pool->stop();
+
+  vector<WorkerStats> stats;
+  pool->getWorkerStats(&stats);
+  EXPECT_EQ(stats.size(), 4U);
+
+  uint64_t run, queued;
+  int inconsistent;
+  sumStats(stats, &run, &queued, &inconsistent);
+  EXPECT_EQ(run, 404U);
+  EXPECT_EQ(queued, 404U);
+  EXPECT_EQ(inconsistent, 0);
+  delete pool;
+  delete root;
+  delete child;
+}
+
+TEST(Stealing, Sequential) {
+  Counter counter;
+  ThreadPool* pool = new ThreadPoolStealing(1);
+
+  const int num_repeats = 10;
+  Callback<void>* task = makeCallableMany(&Counter::Incr, &counter);
+  for (int i = 0; i < num_repeats ; i++) {
+    pool->addTask(task);
+  }
+
+  // Wait for all the tasks to finish and check counter.
+  pool->stop();
+  EXPECT_EQ(counter.Get(), num_repeats);
+  delete pool;
+  delete task;
+}
+
+TEST(Stealing, StopIssuedInsideThePool) {
+  Counter counter;
+  ThreadPool* pool = new ThreadPoolStealing(4);
+  Stopper* stopper = new Stopper(pool);
+
+  Callback<void>* task = makeCallableMany(&Counter::Incr, &counter);
+  const int num_repeats = 10;
+  for (int i = 0; i < num_repeats ; i++) {
+    pool->addTask(task);
+  }
+
+  Callback<void>* stop = makeCallableOnce(&Stopper::stop, stopper);
+  pool->addTask(stop);
+  stopper->wait();
+
+  // The stopping worker may have started before the other tasks
+  // finished, but stop() waits for them.
+  EXPECT_EQ(counter.Get(), num_repeats);
+  delete stopper;
+  delete pool;
+  delete task;
+}
+
+TEST(Stealing, TasksAddedByWorkers) {
+  Counter counter;
+  const int num_workers = 4;
+  ThreadPool* pool = new ThreadPoolStealing(num_workers);
+
+  // Each root task queues its children on its worker's own deque. The
+  // other workers have to steal them.
+  const int num_roots = 8;
+  const int fan_out = 100;
+  Callback<void>* child = makeCallableMany(&Counter::Incr, &counter);
+  Spawner spawner(pool, child, fan_out);
+  Callback<void>* root = makeCallableMany(&Spawner::spawn, &spawner);
+  for (int i = 0; i < num_roots; i++) {
+    pool->addTask(root);
+  }
+
+  pool->stop();
+  EXPECT_EQ(counter.Get(), num_roots * fan_out);
+  EXPECT_EQ(pool->count(), 0);
+  delete pool;
+  delete root;
+  delete child;
+}
+
+TEST(Stealing, WorkerIds) {
+  const int num_workers = 4;
+  WorkerIds ids;
+  ThreadPool* pool = new ThreadPoolStealing(num_workers);
+
+  Callback<void>* task = makeCallableMany(&WorkerIds::check, &ids,
+                                          num_workers);
+  for (int i = 0; i < 100; i++) {
+    pool->addTask(task);
+  }
+  pool->stop();
+
+  EXPECT_EQ(ids.bad, 0);
+  EXPECT_EQ(ThreadPoolStealing::ME(), -1);
+  delete pool;
+  delete task;
+}
+
 } // unnammed namespace
 
 int main(int argc, char* argv[]) {
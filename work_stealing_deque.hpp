@@ -0,0 +1,187 @@
+#ifndef MCP_BASE_WORK_STEALING_DEQUE_HEADER
+#define MCP_BASE_WORK_STEALING_DEQUE_HEADER
+
+namespace base {
+
+// A Chase-Lev work-stealing deque ("Dynamic Circular Work-Stealing
+// Deque", SPAA'05). One thread, the owner, pushes and takes items at
+// the bottom end, in LIFO order. Any other thread can steal items from
+// the top end, in FIFO order. The owner only synchronizes with thieves
+// when the deque is about to become empty; thieves synchronize with
+// each other with one CAS on 'top_'.
+//
+// The circular array doubles when full. Old arrays are kept until the
+// deque is destroyed because a thief may still be reading from one.
+//
+// T must be a pointer (or another type that can be copied around
+// with plain loads and stores).
+//
+// Thread safety:
+//   + push() and take() may only be called by the owner thread
+//   + steal() and size() may be called by any thread
+//
+// Usage:
+//   WorkStealingDeque<Task*> deque;
+//
+//   // owner
+//   deque.push(task);
+//   if (deque.take(&task)) ...
+//
+//   // some other thread
+//   if (deque.steal(&task)) ...
+//
+template<typename T>
+class WorkStealingDeque {
+public:
+  explicit WorkStealingDeque(int log_capacity = 8);
+  ~WorkStealingDeque();
+
+  // Adds 'item' to the bottom of the deque.
+  void push(T item);
+
+  // Removes the bottommost item into 'item' and returns true, or
+  // returns false if the deque was empty.
+  bool take(T* item);
+
+  // Removes the topmost item into 'item' and returns true. Returns
+  // false if the deque was empty or if another thread got that item
+  // first.
+  bool steal(T* item);
+
+  // Returns the number of items in the deque. The result is a
+  // snapshot and may be stale by the time it is used.
+  long size() const;
+
+private:
+  struct Array {
+    long   mask;   // capacity - 1, capacity is a power of 2
+    T*     items;
+    Array* prev;   // arrays this one replaced, owned here
+
+    explicit Array(long capacity)
+      : mask(capacity - 1), items(new T[capacity]), prev(NULL) { }
+    ~Array() { delete [] items; }
+
+    T get(long i) const { return items[i & mask]; }
+    void put(long i, T item) { items[i & mask] = item; }
+  };
+
+  // 'top_' is written by thieves and 'bottom_' by the owner. Keep
+  // them in separate cache lines.
+  volatile long   top_;
+  char            pad_[64 - sizeof(long)];
+  volatile long   bottom_;
+  Array* volatile array_;
+
+  // Returns a copy of 'a' with twice its capacity holding the items
+  // in [top, bottom).
+  Array* grow(Array* a, long bottom, long top);
+
+  // Non-copyable, non-assignable
+  WorkStealingDeque(const WorkStealingDeque&);
+  WorkStealingDeque& operator=(const WorkStealingDeque&);
+};
+
+template<typename T>
+WorkStealingDeque<T>::WorkStealingDeque(int log_capacity)
+  : top_(0), bottom_(0), array_(new Array(1L << log_capacity)) {
+}
+
+template<typename T>
+WorkStealingDeque<T>::~WorkStealingDeque() {
+  Array* a = array_;
+  while (a != NULL) {
+    Array* prev = a->prev;
+    delete a;
+    a = prev;
+  }
+}
+
+template<typename T>
+void WorkStealingDeque<T>::push(T item) {
+  long b = bottom_;
+  long t = top_;
+  Array* a = array_;
+  if (b - t > a->mask) {
+    a = grow(a, b, t);
+  }
+  a->put(b, item);
+
+  // The item must be visible before a thief can see the new bottom.
+  __sync_synchronize();
+  bottom_ = b + 1;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::take(T* item) {
+  long b = bottom_ - 1;
+  Array* a = array_;
+  bottom_ = b;
+
+  // Reserve the bottom item before looking at 'top_'. Without a full
+  // barrier, the load of 'top_' could be satisfied before the store
+  // to 'bottom_' is visible, and a thief could take the same item.
+  __sync_synchronize();
+  long t = top_;
+
+  if (t > b) {
+    // Empty
+    bottom_ = b + 1;
+    return false;
+  }
+
+  *item = a->get(b);
+  if (t == b) {
+    // Last item. Race the thieves for it.
+    bool won = __sync_bool_compare_and_swap(&top_, t, t + 1);
+    bottom_ = b + 1;
+    return won;
+  }
+  return true;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::steal(T* item) {
+  long t = top_;
+  __sync_synchronize();
+  long b = bottom_;
+  if (t >= b) {
+    return false;
+  }
+
+  // Read the item before claiming it: once 'top_' moves, the owner
+  // may overwrite the slot.
+  Array* a = array_;
+  T res = a->get(t);
+  if (! __sync_bool_compare_and_swap(&top_, t, t + 1)) {
+    return false;
+  }
+  *item = res;
+  return true;
+}
+
+template<typename T>
+long WorkStealingDeque<T>::size() const {
+  long b = bottom_;
+  long t = top_;
+  return (b > t) ? b - t : 0;
+}
+
+template<typename T>
+typename WorkStealingDeque<T>::Array*
+WorkStealingDeque<T>::grow(Array* a, long bottom, long top) {
+  Array* bigger = new Array((a->mask + 1) << 1);
+  for (long i = top; i < bottom; i++) {
+    bigger->put(i, a->get(i));
+  }
+  bigger->prev = a;
+
+  // Copies must be visible before thieves can pick the new array.
+  __sync_synchronize();
+  array_ = bigger;
+  return bigger;
+}
+
+} // namespace base
+
+#endif // MCP_BASE_WORK_STEALING_DEQUE_HEADER
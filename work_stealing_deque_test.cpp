@@ -0,0 +1,157 @@
+#include <pthread.h>
+#include <vector>
+
+#include "callback.hpp"
+#include "test_unit.hpp"
+#include "thread.hpp"
+#include "work_stealing_deque.hpp"
+
+namespace {
+
+using base::Callback;
+using base::makeCallableOnce;
+using base::makeThread;
+using base::WorkStealingDeque;
+using std::vector;
+
+typedef WorkStealingDeque<long*> Deque;
+
+// Steals from 'deque' until 'done' is set and the deque is empty,
+// marking each item it gets in 'seen'.
+struct Thief {
+  Thief(Deque* deque, vector<int>* seen, long* base, volatile bool* done)
+    : deque_(deque), seen_(seen), base_(base), done_(done), stolen(0) { }
+
+  void run() {
+    long* item;
+    while (! *done_ || deque_->size() > 0) {
+      if (deque_->steal(&item)) {
+        __sync_fetch_and_add(&(*seen_)[item - base_], 1);
+        stolen++;
+      }
+    }
+  }
+
+  Deque*         deque_;
+  vector<int>*   seen_;
+  long*          base_;
+  volatile bool* done_;
+  int            stolen;
+};
+
+//
+// Test Cases
+//
+
+TEST(Basics, OwnerIsLIFO) {
+  long items[3];
+  Deque deque;
+  long* item = NULL;
+
+  EXPECT_FALSE(deque.take(&item));
+  for (int i = 0; i < 3; i++) {
+    deque.push(&items[i]);
+  }
+  EXPECT_EQ(deque.size(), 3);
+  for (int i = 2; i >= 0; i--) {
+    EXPECT_TRUE(deque.take(&item));
+    EXPECT_EQ(item, &items[i]);
+  }
+  EXPECT_FALSE(deque.take(&item));
+  EXPECT_EQ(deque.size(), 0);
+}
+
+TEST(Basics, ThiefIsFIFO) {
+  long items[3];
+  Deque deque;
+  long* item = NULL;
+
+  EXPECT_FALSE(deque.steal(&item));
+  for (int i = 0; i < 3; i++) {
+    deque.push(&items[i]);
+  }
+  EXPECT_TRUE(deque.steal(&item));
+  EXPECT_EQ(item, &items[0]);
+  EXPECT_TRUE(deque.take(&item));
+  EXPECT_EQ(item, &items[2]);
+  EXPECT_TRUE(deque.steal(&item));
+  EXPECT_EQ(item, &items[1]);
+  EXPECT_FALSE(deque.steal(&item));
+}
+
+TEST(Basics, Grow) {
+  const int num_items = 1000;
+  long items[num_items];
+  Deque deque(2 /* 4 items */);
+  long* item = NULL;
+
+  // Wrap around the array a few times before it grows.
+  for (int i = 0; i < 10; i++) {
+    deque.push(&items[i]);
+    EXPECT_TRUE(deque.steal(&item));
+  }
+  for (int i = 0; i < num_items; i++) {
+    deque.push(&items[i]);
+  }
+  EXPECT_EQ(deque.size(), num_items);
+  bool in_order = true;
+  for (int i = 0; i < num_items; i++) {
+    in_order = in_order && deque.steal(&item) && (item == &items[i]);
+  }
+  EXPECT_TRUE(in_order);
+}
+
+TEST(Concurrency, EachItemOnce) {
+  const int num_items = 200000;
+  const int num_thieves = 3;
+  vector<long> items(num_items);
+  vector<int> seen(num_items, 0);
+  volatile bool done = false;
+  Deque deque(4);
+
+  vector<Thief*> thieves;
+  vector<pthread_t> tids;
+  for (int i = 0; i < num_thieves; i++) {
+    thieves.push_back(new Thief(&deque, &seen, &items[0], &done));
+    tids.push_back(makeThread(makeCallableOnce(&Thief::run, thieves[i])));
+  }
+
+  // The owner pushes in bursts and takes some back, racing the thieves
+  // for the last items.
+  long* item;
+  int taken = 0;
+  for (int i = 0; i < num_items; i++) {
+    deque.push(&items[i]);
+    if (i % 3 == 0 && deque.take(&item)) {
+      __sync_fetch_and_add(&seen[item - &items[0]], 1);
+      taken++;
+    }
+  }
+  done = true;
+  while (deque.take(&item)) {
+    __sync_fetch_and_add(&seen[item - &items[0]], 1);
+    taken++;
+  }
+
+  int stolen = 0;
+  for (int i = 0; i < num_thieves; i++) {
+    pthread_join(tids[i], NULL);
+    stolen += thieves[i]->stolen;
+    delete thieves[i];
+  }
+
+  int bad = 0;
+  for (int i = 0; i < num_items; i++) {
+    if (seen[i] != 1) {
+      bad++;
+    }
+  }
+  EXPECT_EQ(bad, 0);
+  EXPECT_EQ(taken + stolen, num_items);
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  return RUN_TESTS(argc, argv);
+}